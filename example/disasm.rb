@@ -14,21 +14,9 @@ puts "Ov2 sinit start: " + rom.ovt.get_entry(2)[:sinit_start].to_hex
 # puts 'Loading symbols...'
 # Unarm.load_symbols9('symbols9.x')
 
-f = File.open('rat-disasm.txt', 'w')
+puts 'Disassembling arm9, arm7 and overlays...'
 
-puts 'Disassembling arm9...'
-
-# Here we treat every word in the binary as if it's an arm instruction; this is of course not reality
-rom.arm9.each_ins {|ins| f.puts "#{ins.addr.to_hex}: #{ins.str}" }
-
-f.puts
-
-rom.each_overlay do |ov, id|
-  puts "Disassembling overlay#{id}"
-  ov.each_ins {|ins| f.puts "#{ins.addr.to_hex}: #{ins.str}" }
-  f.puts
-end
-
-f.close
+# Here we treat every word in each binary as if it's an arm instruction; this is of course not reality
+rom.export_disassembly('rat-disasm.txt')
 
 puts "Done! Took #{Time.now - start_time} seconds."
@@ -0,0 +1,98 @@
+#include "accesstrace.hpp"
+
+#include <algorithm>
+
+#include "hash.hpp"
+
+namespace nitro {
+
+void AccessTrace::start() {
+	m_pages.clear();
+	m_inputs.clear();
+	m_writes.clear();
+	m_writeData.clear();
+	m_complete = true;
+	m_active = true;
+}
+
+void AccessTrace::finish() {
+	m_active = false;
+
+	std::vector<u32> pageAddresses;
+	pageAddresses.reserve(m_pages.size());
+	for (const auto& [address, page] : m_pages)
+		pageAddresses.push_back(address);
+	std::sort(pageAddresses.begin(), pageAddresses.end());
+
+	for (u32 pageAddress : pageAddresses) {
+		const Page& page = m_pages.at(pageAddress);
+		if (page.input)
+			m_inputs.push_back({ pageAddress, page.hash });
+		if (page.written.none())
+			continue;
+
+		const u8* data = m_image.translate(pageAddress, MemoryImage::PAGE_SIZE);
+		for (u32 offset = 0; offset < MemoryImage::PAGE_SIZE; offset++) {
+			if (!page.written[offset])
+				continue;
+			u32 address = pageAddress + offset;
+			// Runs continuing across a page boundary are merged
+			if (m_writes.empty() || m_writes.back().address + m_writes.back().size != address)
+				m_writes.push_back({ address, 0, u32(m_writeData.size()) });
+			m_writes.back().size++;
+			m_writeData.push_back(data[offset]);
+		}
+	}
+}
+
+template<typename Fn>
+void AccessTrace::forEachPage(u32 address, u32 size, Fn&& fn) {
+	u64 end = u64(address) + size;
+	for (u64 pos = address; pos < end;) {
+		u32 pageAddress = u32(pos & ~u64(MemoryImage::PAGE_SIZE - 1));
+		u64 pageEnd = std::min(end, u64(pageAddress) + MemoryImage::PAGE_SIZE);
+
+		auto it = m_pages.find(pageAddress);
+		if (it == m_pages.end()) {
+			const u8* data = m_image.translate(pageAddress, MemoryImage::PAGE_SIZE);
+			if (!data) {
+				m_complete = false;
+				pos = pageEnd;
+				continue;
+			}
+			it = m_pages.emplace(pageAddress, Page{ hash::xxh64(data, MemoryImage::PAGE_SIZE), false, {} }).first;
+		}
+
+		fn(it->second, u32(pos - pageAddress), u32(pageEnd - pos));
+		pos = pageEnd;
+	}
+}
+
+void AccessTrace::read(u32 address, u32 size) {
+	if (!m_active)
+		return;
+	forEachPage(address, size, [](Page& page, u32 offset, u32 count) {
+		for (u32 i = offset; i < offset + count && !page.input; i++)
+			page.input = !page.written[i];
+	});
+}
+
+void AccessTrace::write(u32 address, u32 size) {
+	if (!m_active)
+		return;
+	forEachPage(address, size, [](Page& page, u32 offset, u32 count) {
+		for (u32 i = offset; i < offset + count; i++)
+			page.written.set(i);
+	});
+}
+
+bool AccessTrace::pagesMatch(MemoryImage& image, const u32* addresses, const u64* hashes, u32 count) {
+	for (u32 i = 0; i < count; i++) {
+		const u8* data = image.translate(addresses[i], MemoryImage::PAGE_SIZE);
+		if (!data || hash::xxh64(data, MemoryImage::PAGE_SIZE) != hashes[i])
+			return false;
+	}
+	return true;
+}
+
+} // nitro
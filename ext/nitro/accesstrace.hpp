@@ -0,0 +1,90 @@
+#pragma once
+
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+
+#include "memoryimage.hpp"
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief Record of the memory an emulated call depends on and what it leaves behind, at page granularity.
+ * Each page of a MemoryImage is hashed the first time the call touches it, before the access, so the hashes
+ * describe the memory the call started from. A page only counts as an input if the call reads or executes bytes
+ * of it that it didn't write itself, which keeps pushes and pops of the stack out of the inputs.
+ */
+class AccessTrace {
+public:
+	struct PageInput {
+		u32 address;
+		u64 hash;
+	};
+
+	struct Write {
+		u32 address;
+		u32 size;
+		u32 dataOffset; // into getWriteData()
+	};
+
+	explicit AccessTrace(MemoryImage& image) noexcept : m_image(image) {}
+
+	AccessTrace(const AccessTrace&) = delete;
+	AccessTrace& operator=(const AccessTrace&) = delete;
+
+	/**
+	 * @brief Forget everything recorded and start recording accesses.
+	 */
+	void start();
+
+	/**
+	 * @brief Stop recording and gather the inputs and the final contents of the written bytes.
+	 */
+	void finish();
+
+	void fetch(u32 address, u32 size) { if (m_active) read(address, size); }
+	void read(u32 address, u32 size);
+	void write(u32 address, u32 size);
+
+	/**
+	 * @brief Whether every access was within the image, i.e. whether the inputs and writes describe the call fully.
+	 */
+	[[nodiscard]] bool isComplete() const { return m_complete; }
+
+	[[nodiscard]] const std::vector<PageInput>& getInputs() const { return m_inputs; }
+	[[nodiscard]] const std::vector<Write>& getWrites() const { return m_writes; }
+	[[nodiscard]] const std::vector<u8>& getWriteData() const { return m_writeData; }
+
+	/**
+	 * @brief Check whether pages of an image still hash to what was recorded.
+	 *
+	 * @param image The image to check.
+	 * @param addresses The addresses of the pages.
+	 * @param hashes The expected hash of each page.
+	 * @param count The number of pages.
+	 *
+	 * @return Whether every page is in the image and unchanged.
+	 */
+	static bool pagesMatch(MemoryImage& image, const u32* addresses, const u64* hashes, u32 count);
+
+private:
+	struct Page {
+		u64 hash;
+		bool input;
+		std::bitset<MemoryImage::PAGE_SIZE> written;
+	};
+
+	template<typename Fn>
+	void forEachPage(u32 address, u32 size, Fn&& fn);
+
+	MemoryImage& m_image;
+	std::unordered_map<u32, Page> m_pages;
+	std::vector<PageInput> m_inputs;
+	std::vector<Write> m_writes;
+	std::vector<u8> m_writeData;
+	bool m_active = false;
+	bool m_complete = true;
+};
+
+} // nitro
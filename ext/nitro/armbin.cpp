@@ -33,48 +33,39 @@ bool ArmBin::load(const fs::path& path, u32 entryAddr, u32 ramAddr, u32 autoLoad
 	if (!file.is_open())
 		return false;
 
-	m_bytes.resize(fileSize);
-	file.read(reinterpret_cast<char*>(m_bytes.data()), std::streamsize(fileSize));
+	m_ownedBytes.resize(fileSize);
+	file.read(reinterpret_cast<char*>(m_ownedBytes.data()), std::streamsize(fileSize));
 	file.close();
 
-	u8* bytesData = m_bytes.data();
-
-	// FIND MODULE PARAMS ================================
-
-	m_moduleParamsOffset = *reinterpret_cast<u32*>(&bytesData[autoLoadHookOffset - m_ramAddr - 4]) - m_ramAddr;
-
-	ModuleParams* moduleParams = getModuleParams();
-
-	// DECOMPRESS ================================
-
-	if (moduleParams->compStaticEnd) {
+	// The compressed image ends with the size it grows by, so find it before sizing the buffer
+	ARMBinaryInfo info = { 0, entryAddr, ramAddr, static_cast<u32>(fileSize) };
+	u32 loadedSize = getLoadedSize(m_ownedBytes.data(), info, autoLoadHookOffset);
+	if (loadedSize == 0)
+		return false;
 
-		u32 decompSize = static_cast<u32>(fileSize) + *reinterpret_cast<u32*>(&bytesData[moduleParams->compStaticEnd - m_ramAddr - 4]);
+	m_ownedBytes.resize(loadedSize);
+	m_data = m_ownedBytes.data();
+	m_size = loadedSize;
 
-		m_bytes.resize(decompSize);
-		bytesData = m_bytes.data();
-		moduleParams = getModuleParams();
+	return loadImage();
+}
 
-		try {
-			blz::uncompressInplace(&bytesData[moduleParams->compStaticEnd - m_ramAddr]);
-		}
-		catch (const std::exception& e) {
-			std::ostringstream oss;
-			oss << "Failed to decompress the binary: " << e.what();
-			return false;
-		}
+bool ArmBin::load(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset, bool isArm9) {
 
-		moduleParams->compStaticEnd = 0;
-	}
+	if (romPtr == nullptr || info.size < 4)
+		return false;
 
-	refreshAutoloadData();
+	u32 loadedSize = getLoadedSize(romPtr, info, autoLoadHookOffset);
+	if (loadedSize == 0)
+		return false;
 
-	return true;
+	m_ownedBytes.resize(loadedSize);
+	return load(romPtr, info, autoLoadHookOffset, isArm9, m_ownedBytes.data(), loadedSize);
 }
 
-bool ArmBin::load(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset, bool isArm9) {
+bool ArmBin::load(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset, bool isArm9, u8* dest, u32 destSize) {
 
-	if (romPtr == nullptr || info.size < 4)
+	if (romPtr == nullptr || dest == nullptr || info.size < 4 || info.size > destSize)
 		return false;
 
 	m_ramAddr = info.ramAddress;
@@ -82,26 +73,53 @@ bool ArmBin::load(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookO
 	m_autoLoadHookOffset = autoLoadHookOffset;
 	m_isArm9 = isArm9;
 
-	romPtr += info.romOffset;
+	std::memcpy(dest, romPtr + info.romOffset, info.size);
+	m_data = dest;
+	m_size = destSize;
 
-	m_bytes.assign(romPtr, romPtr + info.size);
+	return loadImage();
+}
 
-	u8* bytesData = m_bytes.data();
+u32 ArmBin::getLoadedSize(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset) {
 
-	m_moduleParamsOffset = *reinterpret_cast<u32*>(&bytesData[autoLoadHookOffset - m_ramAddr - 4]) - m_ramAddr;
+	const u8* bin = romPtr + info.romOffset;
 
-	ModuleParams* moduleParams = getModuleParams();
+	u32 hookOffset = autoLoadHookOffset - info.ramAddress;
+	if (hookOffset < 4 || hookOffset > info.size)
+		return 0;
 
-	if (moduleParams->compStaticEnd) {
+	u32 moduleParamsOffset = *reinterpret_cast<const u32*>(&bin[hookOffset - 4]) - info.ramAddress;
+	if (moduleParamsOffset + sizeof(ModuleParams) > info.size)
+		return 0;
+
+	const ModuleParams* moduleParams = reinterpret_cast<const ModuleParams*>(&bin[moduleParamsOffset]);
+	if (!moduleParams->compStaticEnd)
+		return info.size;
+
+	u32 compStaticEnd = moduleParams->compStaticEnd - info.ramAddress;
+	if (compStaticEnd < 4 || compStaticEnd > info.size)
+		return 0;
+
+	return info.size + *reinterpret_cast<const u32*>(&bin[compStaticEnd - 4]);
+}
+
+// Expects m_data to start with the binary as stored, and m_size to fit it decompressed
+bool ArmBin::loadImage() {
+
+	// FIND MODULE PARAMS ================================
+
+	m_moduleParamsOffset = *reinterpret_cast<u32*>(&m_data[m_autoLoadHookOffset - m_ramAddr - 4]) - m_ramAddr;
+
+	ModuleParams* moduleParams = getModuleParams();
 
-		u32 decompSize = static_cast<u32>(info.size) + *reinterpret_cast<u32*>(&bytesData[moduleParams->compStaticEnd - m_ramAddr - 4]);
+	// DECOMPRESS ================================
 
-		m_bytes.resize(decompSize);
-		bytesData = m_bytes.data();
-		moduleParams = getModuleParams();
+	if (moduleParams->compStaticEnd) {
 
 		try {
-			blz::uncompressInplace(&bytesData[moduleParams->compStaticEnd - m_ramAddr]);
+			u32 compressedSize = moduleParams->compStaticEnd - m_ramAddr;
+			if (!blz::uncompressInplace(&m_data[compressedSize], compressedSize))
+				return false;
 		}
 		catch (const std::exception& e) {
 			std::ostringstream oss;
@@ -130,7 +148,7 @@ bool ArmBin::readBytes(u32 address, void* out, u32 size) const {
 	if (address >= m_ramAddr && address < autoloadStart) {
 		if (address + size > autoloadStart)
 			failDueToSizeExceed();
-		std::memcpy(out, &m_bytes[address - m_ramAddr], size);
+		std::memcpy(out, &m_data[address - m_ramAddr], size);
 		return true;
 	}
 
@@ -139,7 +157,7 @@ bool ArmBin::readBytes(u32 address, void* out, u32 size) const {
 		if (address >= autoload.address && address < autoloadEnd) {
 			if (address + size > autoloadEnd)
 				failDueToSizeExceed();
-			std::memcpy(out, &m_bytes[autoload.dataOffset + (address - autoload.address)], size);
+			std::memcpy(out, &m_data[autoload.dataOffset + (address - autoload.address)], size);
 			return true;
 		}
 	}
@@ -162,7 +180,8 @@ bool ArmBin::writeBytes(u32 address, const void* data, u32 size) {
 	if (address >= m_ramAddr && address < autoloadStart) {
 		if (address + size > autoloadStart)
 			failDueToSizeExceed();
-		std::memcpy(&m_bytes[address - m_ramAddr], data, size);
+		std::memcpy(&m_data[address - m_ramAddr], data, size);
+		m_revision++;
 		return true;
 	}
 
@@ -171,7 +190,8 @@ bool ArmBin::writeBytes(u32 address, const void* data, u32 size) {
 		if (address >= autoload.address && address < autoloadEnd) {
 			if (address + size > autoloadEnd)
 				failDueToSizeExceed();
-			std::memcpy(&m_bytes[autoload.dataOffset + (address - autoload.address)], data, size);
+			std::memcpy(&m_data[autoload.dataOffset + (address - autoload.address)], data, size);
+			m_revision++;
 			return true;
 		}
 	}
@@ -185,13 +205,29 @@ const void* ArmBin::getPtrToData(u32 address) const {
 
 	u32 autoloadStart = getModuleParams()->autoloadStart;
 	if (address >= m_ramAddr && address < autoloadStart) {
-		return &m_bytes[address - m_ramAddr];
+		return &m_data[address - m_ramAddr];
 	}
 
 	for (const AutoLoadEntry& autoload : m_autoloadList) {
 		u32 autoloadEnd = autoload.address + autoload.size;
 		if (address >= autoload.address && address < autoloadEnd) {
-			return &m_bytes[autoload.dataOffset + (address - autoload.address)];
+			return &m_data[autoload.dataOffset + (address - autoload.address)];
+		}
+	}
+	return nullptr;
+}
+
+const void* ArmBin::getPtrToRange(u32 address, u32 size) const {
+
+	u64 end = u64(address) + size;
+	u32 autoloadStart = getModuleParams()->autoloadStart;
+	if (address >= m_ramAddr && end <= autoloadStart) {
+		return &m_data[address - m_ramAddr];
+	}
+
+	for (const AutoLoadEntry& autoload : m_autoloadList) {
+		if (address >= autoload.address && end <= u64(autoload.address) + autoload.size) {
+			return &m_data[autoload.dataOffset + (address - autoload.address)];
 		}
 	}
 	return nullptr;
@@ -199,7 +235,7 @@ const void* ArmBin::getPtrToData(u32 address) const {
 
 void ArmBin::refreshAutoloadData() {
 
-	u8* bytesData = m_bytes.data();
+	u8* bytesData = m_data;
 	ModuleParams* moduleParams = getModuleParams();
 
 	m_autoloadList.clear();
@@ -227,11 +263,11 @@ void ArmBin::refreshAutoloadData() {
 
 
 ArmBin::ModuleParams* ArmBin::getModuleParams() {
-	return reinterpret_cast<ModuleParams*>(&((m_bytes.data())[m_moduleParamsOffset]));
+	return reinterpret_cast<ModuleParams*>(&((m_data)[m_moduleParamsOffset]));
 }
 
 const ArmBin::ModuleParams* ArmBin::getModuleParams() const {
-	return reinterpret_cast<const ModuleParams*>(&((m_bytes.data())[m_moduleParamsOffset]));
+	return reinterpret_cast<const ModuleParams*>(&((m_data)[m_moduleParamsOffset]));
 }
 
 bool ArmBin::sanityCheckAddress(u32 addr) const {
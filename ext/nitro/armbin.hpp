@@ -40,16 +40,48 @@ public:
 
 	ArmBin() = default;
 
+	// m_data may point into m_ownedBytes, which a copy or move would leave pointing into the source
+	ArmBin(const ArmBin&) = delete;
+	ArmBin& operator=(const ArmBin&) = delete;
+	ArmBin(ArmBin&&) = delete;
+	ArmBin& operator=(ArmBin&&) = delete;
+
 	bool load(const std::filesystem::path& path, u32 entryAddr, u32 ramAddr, u32 autoLoadHookOffset, bool isArm9);
 	bool load(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset, bool isArm9);
 
+	/**
+	 * @brief Load the binary from a ROM into a buffer owned by the caller, decompressing it in place.
+	 * 
+	 * @param romPtr Pointer to the start of the ROM.
+	 * @param info Location of the binary in the ROM.
+	 * @param autoLoadHookOffset Offset of the autoload hook, used to find the module params.
+	 * @param isArm9 Whether this is the ARM9 binary.
+	 * @param dest Buffer that will hold the binary, which must outlive it.
+	 * @param destSize Size of dest, at least getLoadedSize().
+	 * 
+	 * @return Whether the binary was loaded.
+	 */
+	bool load(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset, bool isArm9, u8* dest, u32 destSize);
+
+	/**
+	 * @brief Get the size of a binary in a ROM once decompressed.
+	 * 
+	 * @param romPtr Pointer to the start of the ROM.
+	 * @param info Location of the binary in the ROM.
+	 * @param autoLoadHookOffset Offset of the autoload hook, used to find the module params.
+	 * 
+	 * @return The decompressed size, or 0 if the module params could not be found.
+	 */
+	static u32 getLoadedSize(const u8* romPtr, const ARMBinaryInfo& info, u32 autoLoadHookOffset);
+
 	bool readBytes(u32 address, void* out, u32 size) const override;
 	bool writeBytes(u32 address, const void* data, u32 size) override;
 
-	u32 getSize() const override { return static_cast<u32>(m_bytes.size()); }
+	u32 getSize() const override { return m_size; }
 	u32 getStartAddress() const override { return m_ramAddr; }
 
 	const void* getPtrToData(u32 address) const override;
+	const void* getPtrToRange(u32 address, u32 size) const override;
 
 	void refreshAutoloadData();
 
@@ -60,20 +92,24 @@ public:
 
 	[[nodiscard]] constexpr u32 getEntryPointAddress() const { return m_entryAddr; }
 
-	[[nodiscard]] constexpr std::vector<u8>& data() { return m_bytes; }
-	[[nodiscard]] constexpr const std::vector<u8>& data() const { return m_bytes; }
+	[[nodiscard]] constexpr u8* data() { return m_data; }
+	[[nodiscard]] constexpr const u8* data() const { return m_data; }
 
 	[[nodiscard]] constexpr std::vector<AutoLoadEntry>& getAutoloadList() { return m_autoloadList; }
 	[[nodiscard]] constexpr const std::vector<AutoLoadEntry>& getAutoloadList() const { return m_autoloadList; }
 
 private:
+	bool loadImage();
+
 	u32 m_ramAddr; //The offset of this binary in memory
 	u32 m_entryAddr; //The address of the entry point
 	u32 m_autoLoadHookOffset;
 	u32 m_moduleParamsOffset;
 	u32 m_isArm9;
 
-	std::vector<u8> m_bytes;
+	u8* m_data = nullptr; // either m_ownedBytes or a buffer owned by the ROM
+	u32 m_size = 0;
+	std::vector<u8> m_ownedBytes;
 	std::vector<AutoLoadEntry> m_autoloadList;
 
 };
@@ -1,6 +1,9 @@
 #include "blz.hpp"
 
-#include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
 static const char* s_srcShortageStr = "Source shortage.";
@@ -35,62 +38,213 @@ static int CompressBackward_sub1(const u8* a1, int a2, const u8* a3, int a4, int
 	return v7;
 }
 
-/**
- * @brief Compress module data.
- *
- * @param src Pointer to input data begin.
- * @param size Size of the input data.
- * @param dst Pointer to output data begin.
+// Longest match and furthest back a match can reach, given how tokens store them
+static constexpr u32 MaxMatchLength = 18;
+static constexpr u32 MaxMatchDistance = 4098;
+
+static constexpr u32 FooterSize = 8;
+
+/*
+ * The token stream is built in the order the decoder reads it, i.e. from the end of the compressed data down; it is
+ * only reversed into place once the split between the uncompressed head and the compressed part is chosen.
+ */
+namespace {
+
+	// The state after a token: how much data is left to encode below it, and how many stream bytes come before it
+	struct Boundary {
+		u32 plain;
+		u32 stream;
+	};
+
+	// A flag byte and the (up to) 8 tokens following it
+	struct Group {
+		u32 plain;  // top of the data the group encodes
+		u32 stream; // position of its flag byte
+	};
+
+	struct Stream {
+		std::vector<u8> bytes;
+		std::vector<Boundary> boundaries;
+		std::vector<Group> groups;
+	};
+
+}
+
+// Compressed size (without padding) if the data is split at a boundary: the head is stored as is, the tokens above it
+// are kept. Decompressing in place is safe exactly when no boundary above the split has a smaller cost, which the
+// boundary of least cost satisfies
+static u32 splitCost(const Boundary& b) {
+	return b.plain + b.stream;
+}
+
+/*
+ * Greedily encodes data[0, top) backward onto the stream, as the stream above would have continued. The match search
+ * only looks at data above the position being encoded and up to MaxMatchLength below it, so tokens whose data lies
+ * MaxMatchLength above a change are the same whether or not the change was there.
  *
- * @return The number of compressed bytes. (in_size - out_size)
+ * Fails once the compressed size can no longer be at most maxSize (0 for no limit).
  */
-static size_t CompressBackward(const void* src, size_t size, void* dst) {
-	const u8* src_ = reinterpret_cast<const u8*>(src);
-	u8* dst_ = reinterpret_cast<u8*>(dst);
-
-	size_t v13 = size;
-	size_t v12 = size;
-	while (v13 > 0) {
-		if (v12 <= 0)
-			return -1;
-		int v11 = 0;
-		int v10 = static_cast<int>(--v12);
-		for (int i = 0; i <= 7; ++i) {
-			v11 *= 2;
-			if (v13 > 0) {
-				const u8* v9 = &src_[v13];
-				int v8 = static_cast<int>(size - v13);
-				int v2 = static_cast<int>(v13);
-				if (v13 > 18)
-					v2 = 18;
-				int v6 = v2;
-				const u8* v7 = &v9[-v2];
-				int v1 = v8;
-				if (v8 > 4098)
-					v1 = 4098;
-				int v5;
-				int v4 = CompressBackward_sub1(v7, v6, v9, v1, v5);
-				if (v4 <= 2) {
-					if (v12 <= 0)
-						return -1;
-					dst_[--v12] = src_[--v13];
-				
-				} else {
-					if (v12 <= 1)
-						return -1;
-					v13 -= v4;
-					v5 -= 2;
-					u16 v3 = v5 & 0xFFF | (((u16)v4 - 3) << 12);
-					--v12;
-					dst_[v12--] = v3 >> 8;
-					dst_[v12] = static_cast<u8>(v3);
-					v11 |= 1;
-				}
+static bool encodeBackward(const u8* data, u32 size, u32 top, Stream& stream, size_t maxSize) {
+	u32 best = UINT32_MAX;
+	for (const Boundary& b : stream.boundaries)
+		best = std::min(best, splitCost(b));
+
+	u32 o = top;
+	while (o > 0) {
+		// Splitting further down can't cost less than the stream written so far
+		if (maxSize != 0 && std::min<size_t>(best, stream.bytes.size()) + FooterSize > maxSize)
+			return false;
+
+		stream.groups.push_back(Group{ o, u32(stream.bytes.size()) });
+		size_t flagPos = stream.bytes.size();
+		stream.bytes.push_back(0);
+
+		u8 flags = 0;
+		for (int i = 0; i < 8; ++i) {
+			flags <<= 1;
+			if (o == 0)
+				continue;
+
+			const u8* cur = &data[o];
+			int maxLength = int(std::min(o, MaxMatchLength));
+			int window = int(std::min(size - o, MaxMatchDistance));
+			int pos = 0;
+			int length = CompressBackward_sub1(cur - maxLength, maxLength, cur, window, pos);
+			if (length <= 2) {
+				stream.bytes.push_back(data[--o]);
+			} else {
+				o -= length;
+				u16 token = u16((pos - 2) & 0xFFF) | u16((length - 3) << 12);
+				stream.bytes.push_back(u8(token >> 8));
+				stream.bytes.push_back(u8(token));
+				flags |= 1;
 			}
+
+			Boundary b{ o, u32(stream.bytes.size()) };
+			stream.boundaries.push_back(b);
+			best = std::min(best, splitCost(b));
 		}
-		dst_[v10] = v11;
+		stream.bytes[flagPos] = flags;
+	}
+	return true;
+}
+
+/*
+ * Reads the groups of a compressed stream back, as far as they can be trusted to still encode data whose bytes from
+ * keepAbove up haven't changed. The last group is never kept: it may have been cut short by the split.
+ */
+static bool readBackward(const std::vector<u8>& compressed, u32 size, u32 keepAbove, Stream& stream) {
+	if (compressed.size() < FooterSize)
+		return false;
+
+	const u8* footer = compressed.data() + compressed.size() - FooterSize;
+	u32 offsetIn = footer[0] | (footer[1] << 8) | (footer[2] << 16) | (u32(footer[3]) << 24);
+	u32 offsetOut = footer[4] | (footer[5] << 8) | (footer[6] << 16) | (u32(footer[7]) << 24);
+	u32 fileSize = u32(compressed.size());
+	u32 top = offsetIn & 0xFFFFFF;
+	u32 headerSize = offsetIn >> 24;
+	if (u64(fileSize) + offsetOut != size || top > fileSize || headerSize < FooterSize || headerSize > top)
+		return false;
+
+	const u8* base = compressed.data();
+	u32 r = fileSize - headerSize;
+	u32 head = fileSize - top;
+	u32 o = size;
+
+	Stream parsed;
+	while (r > head) {
+		parsed.groups.push_back(Group{ o, u32(parsed.bytes.size()) });
+		u8 flags = base[--r];
+		parsed.bytes.push_back(flags);
+
+		for (int i = 0; i < 8 && r > head; ++i, flags <<= 1) {
+			if (flags & 0x80) {
+				if (r - head < 2)
+					return false;
+				u8 hi = base[--r];
+				u8 lo = base[--r];
+				parsed.bytes.push_back(hi);
+				parsed.bytes.push_back(lo);
+				u32 length = (hi >> 4) + 3;
+				if (length > o)
+					return false;
+				o -= length;
+			} else {
+				parsed.bytes.push_back(base[--r]);
+				if (o == 0)
+					return false;
+				--o;
+			}
+			parsed.boundaries.push_back(Boundary{ o, u32(parsed.bytes.size()) });
+		}
+	}
+	if (o != head)
+		return false;
+
+	// Keep every group but the last whose data lies wholly above keepAbove
+	size_t kept = 0;
+	while (kept + 1 < parsed.groups.size() && parsed.groups[kept + 1].plain >= keepAbove)
+		++kept;
+	if (kept == 0)
+		return true;
+
+	u32 cutStream = parsed.groups[kept].stream;
+	stream.bytes.assign(parsed.bytes.begin(), parsed.bytes.begin() + cutStream);
+	stream.groups.assign(parsed.groups.begin(), parsed.groups.begin() + kept);
+	for (const Boundary& b : parsed.boundaries) {
+		if (b.stream > cutStream)
+			break;
+		stream.boundaries.push_back(b);
+	}
+	return true;
+}
+
+// Lays out the head, the stream above the split, padding and the footer; empty if that isn't smaller than the data
+static std::vector<u8> finish(const u8* data, u32 size, const Stream& stream) {
+	if (stream.boundaries.empty())
+		return {};
+
+	const Boundary* split = &stream.boundaries.front();
+	for (const Boundary& b : stream.boundaries) {
+		if (splitCost(b) <= splitCost(*split))
+			split = &b;
+	}
+
+	u32 head = split->plain;
+	u32 length = split->stream;
+	u32 padding = (4 - (head + length) % 4) % 4;
+	u32 fileSize = head + length + padding + FooterSize;
+	if (fileSize >= size)
+		return {};
+
+	std::vector<u8> out(fileSize);
+	std::copy(data, data + head, out.begin());
+	for (u32 i = 0; i < length; ++i)
+		out[head + length - 1 - i] = stream.bytes[i];
+
+	// The tokens of the last group below the split are gone, so their flags must read as nothing more to come
+	auto group = std::upper_bound(stream.groups.begin(), stream.groups.end(), length,
+		[](u32 pos, const Group& g) { return pos <= g.stream; });
+	if (group != stream.groups.begin()) {
+		--group;
+		auto first = std::upper_bound(stream.boundaries.begin(), stream.boundaries.end(), group->stream,
+			[](u32 pos, const Boundary& b) { return pos < b.stream; });
+		auto last = std::upper_bound(stream.boundaries.begin(), stream.boundaries.end(), length,
+			[](u32 pos, const Boundary& b) { return pos < b.stream; });
+		u32 tokens = u32(last - first);
+		out[head + length - 1 - group->stream] &= u8(0xFF << (8 - tokens));
+	}
+
+	std::fill(out.begin() + head + length, out.begin() + head + length + padding, 0xFF);
+
+	u32 offsetIn = (length + padding + FooterSize) | ((padding + FooterSize) << 24);
+	u32 offsetOut = size - fileSize;
+	u8* footer = out.data() + fileSize - FooterSize;
+	for (int i = 0; i < 4; ++i) {
+		footer[i] = u8(offsetIn >> (8 * i));
+		footer[4 + i] = u8(offsetOut >> (8 * i));
 	}
-	return v12;
+	return out;
 }
 
 /**
@@ -98,13 +252,21 @@ static size_t CompressBackward(const void* src, size_t size, void* dst) {
  *
  * @param bottom Pointer to input data end.
  */
-static bool UncompressBackward(void* bottom) {
-	u32 offsetOut = *(reinterpret_cast<u32*>(bottom) - 1);
-	u32 offsetIn = *(reinterpret_cast<u32*>(bottom) - 2);
+// Every 17 bytes of stream (a flag and 8 references) make at most 8 * 18 bytes, so data grows at most ninefold
+static constexpr u32 MAX_EXPANSION = 9;
+
+static bool UncompressBackward(u8* bottom, size_t srcSize) {
+	if (!blz::isValidFooter(bottom - srcSize, srcSize))
+		return false;
+
+	u32 offsetOut, offsetIn;
+	std::memcpy(&offsetOut, bottom - 4, 4);
+	std::memcpy(&offsetIn, bottom - 8, 4);
 	u32 offsetInBtm = offsetIn >> 24;
 	u32 offsetInTop = offsetIn & 0xFFFFFF;
 
-	u8* pOut = reinterpret_cast<u8*>(bottom) + offsetOut;
+	u8* pEnd = bottom + offsetOut;
+	u8* pOut = pEnd;
 	u8* pInBtm = reinterpret_cast<u8*>(bottom) - offsetInBtm;
 	u8* pInTop = reinterpret_cast<u8*>(bottom) - offsetInTop;
 
@@ -113,13 +275,13 @@ static bool UncompressBackward(void* bottom) {
 
 		for (int i = 0; i < 8; ++i) {
 
-			if (pInBtm < pInTop) {
+			if (pInBtm <= pInTop) {
 				std::cout << __LINE__ << ": " << s_srcShortageStr << std::endl;
 				return false;
 				// throw std::runtime_error(s_srcShortageStr);
 			}
 
-			if (pOut < pInTop) {
+			if (pOut <= pInTop) {
 				std::cout << __LINE__ << ": " << s_destOverrunStr << std::endl;
 				return false;
 				// throw std::runtime_error(s_destOverrunStr);
@@ -130,7 +292,7 @@ static bool UncompressBackward(void* bottom) {
 			
 			} else {
 
-				if (pInBtm - 2 < pInTop) {
+				if (pInBtm - pInTop < 2) {
 					std::cout << __LINE__ << ": " << s_destOverrunStr << std::endl;
 					return false;
 					// throw std::runtime_error(s_destOverrunStr);
@@ -140,9 +302,14 @@ static bool UncompressBackward(void* bottom) {
 				u32 offset = (((length & 0xF) << 8) | (*--pInBtm)) + 3;
 				length = (length >> 4) + 3;
 
+				if (offset > size_t(pEnd - pOut)) {
+					std::cout << __LINE__ << ": " << s_srcShortageStr << std::endl;
+					return false;
+				}
+
 				u8* pTmp = pOut + offset;
 
-				if (pOut - length < pInTop) {
+				if (length > size_t(pOut - pInTop)) {
 					std::cout << __LINE__ << ": " << s_destOverrunStr << std::endl;
 					return false;
 					// throw std::runtime_error(s_destOverrunStr);
@@ -164,39 +331,74 @@ static bool UncompressBackward(void* bottom) {
 namespace blz {
 
 	std::vector<u8> compress(const std::vector<u8>& data) {
-		size_t dataSize = data.size();
-		std::vector<u8> dest(dataSize);
+		u32 size = u32(data.size());
+		Stream stream;
+		encodeBackward(data.data(), size, size, stream, 0);
+		return finish(data.data(), size, stream);
+	}
 
-		size_t destSize = CompressBackward(data.data(), dataSize, dest.data());
-		if (destSize == -1)
-			throw std::runtime_error("Compression failed.");
+	bool recompress(std::vector<u8>& out, const std::vector<u8>& oldCompressed, const std::vector<u8>& oldData,
+		const std::vector<u8>& data, size_t dirtyStart, size_t dirtyEnd, size_t maxSize) {
+		u32 size = u32(data.size());
+		dirtyEnd = std::min<size_t>(dirtyEnd, size);
 
-		dest.resize(destSize);
-		return dest;
-	}
+		// Only the bytes that actually changed count, when the old data is there to tell
+		if (oldData.size() == data.size()) {
+			while (dirtyEnd > dirtyStart && oldData[dirtyEnd - 1] == data[dirtyEnd - 1])
+				--dirtyEnd;
+		}
 
-	std::vector<u8> uncompress(const std::vector<u8>& data) {
-		size_t dataSize = data.size();
-		u32 destSize = static_cast<u32>(dataSize) + *reinterpret_cast<const u32*>(&data[dataSize - 4]);
+		Stream stream;
+		if (!oldCompressed.empty() && !readBackward(oldCompressed, size, u32(dirtyEnd) + MaxMatchLength, stream))
+			stream = Stream{};
 
-		std::vector<u8> dest(destSize);
-		std::copy(data.begin(), data.end(), dest.begin());
+		u32 top = stream.boundaries.empty() ? size : stream.boundaries.back().plain;
+		out.clear();
+		if (!encodeBackward(data.data(), size, top, stream, maxSize))
+			return false;
 
-		UncompressBackward(dest.data() + dataSize);
+		out = finish(data.data(), size, stream);
+		return maxSize == 0 || (out.empty() ? data.size() : out.size()) <= maxSize;
+	}
+
+	bool isValidFooter(const u8* data, size_t size) {
+		if (size < 8)
+			return false;
+		u32 bounds, extra;
+		std::memcpy(&bounds, &data[size - 8], 4);
+		std::memcpy(&extra, &data[size - 4], 4);
+		u32 headerSize = bounds >> 24;
+		u32 compressedSize = bounds & 0xFFFFFF;
+		return headerSize >= 8 && headerSize <= 11 && compressedSize >= headerSize && compressedSize <= size
+			&& u64(extra) <= u64(compressedSize - headerSize) * (MAX_EXPANSION - 1);
+	}
 
+	u32 getExtraSize(const u8* data, size_t size) {
+		if (!isValidFooter(data, size))
+			return 0;
+		u32 extra;
+		std::memcpy(&extra, &data[size - 4], 4);
+		return extra;
+	}
+
+	std::vector<u8> uncompress(const std::vector<u8>& data) {
+		std::vector<u8> dest = data;
+		if (!uncompressInplace(dest))
+			dest.clear();
 		return dest;
 	}
 
 	bool uncompressInplace(std::vector<u8>& data) {
 		size_t dataSize = data.size();
-		u32 destSize = static_cast<u32>(dataSize) + *reinterpret_cast<u32*>(&data[dataSize - 4]);
-		data.resize(destSize);
+		if (!isValidFooter(data.data(), dataSize))
+			return false;
+		data.resize(dataSize + getExtraSize(data.data(), dataSize));
 
-		return UncompressBackward(data.data() + dataSize);
+		return UncompressBackward(data.data() + dataSize, dataSize);
 	}
 
-	bool uncompressInplace(u8* data_end) {
-		return UncompressBackward(data_end);
+	bool uncompressInplace(u8* dataEnd, size_t compressedSize) {
+		return UncompressBackward(dataEnd, compressedSize);
 	}
 
 }
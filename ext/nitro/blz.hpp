@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
 #include "common.hpp"
@@ -12,16 +13,57 @@ namespace blz {
 	 * 
 	 * @param data The data to compress.
 	 * 
-	 * @return The compressed data.
+	 * @return The compressed data, footer included, or an empty vector if it wouldn't be smaller than the data.
 	 */
 	std::vector<u8> compress(const std::vector<u8>& data);
 
+	/**
+	 * @brief Compress module data again after a patch, reusing what is still valid of its previous compressed data.
+	 * 
+	 * Tokens are encoded from the end of the data down, and only look at the data above them and a few bytes below,
+	 * so those above the patch are kept as they were and only the data below them is encoded again. The result is
+	 * the same as compress would give.
+	 * 
+	 * @param out The vector to write the compressed data to; left empty if it wouldn't be smaller than the data.
+	 * @param oldCompressed The compressed data before the patch, or an empty vector to compress in full.
+	 * @param oldData The data before the patch, to narrow the dirty range with, or an empty vector.
+	 * @param data The patched data, of the same size as before.
+	 * @param dirtyStart The start of the patched range.
+	 * @param dirtyEnd The end of the patched range.
+	 * @param maxSize The size the result must fit in, or 0 for no limit; encoding stops as soon as it can't.
+	 * 
+	 * @return Whether the result fits in maxSize (or the data, stored uncompressed, does).
+	 */
+	bool recompress(std::vector<u8>& out, const std::vector<u8>& oldCompressed, const std::vector<u8>& oldData,
+		const std::vector<u8>& data, size_t dirtyStart, size_t dirtyEnd, size_t maxSize = 0);
+
+	/**
+	 * @brief Check that data ends with a footer that could have been written by compress: the compressed part lies
+	 * within the data, and the size it grows by is no more than the format can expand it to.
+	 * 
+	 * @param data The data to check.
+	 * @param size The size of the data.
+	 * 
+	 * @return Whether the footer is consistent with the data.
+	 */
+	bool isValidFooter(const u8* data, size_t size);
+
+	/**
+	 * @brief Get how much compressed data grows by when uncompressed.
+	 * 
+	 * @param data The compressed data.
+	 * @param size The size of the compressed data.
+	 * 
+	 * @return The size read from the footer, or 0 if the footer is not valid.
+	 */
+	u32 getExtraSize(const u8* data, size_t size);
+
 	/**
 	 * @brief Uncompress module data.
 	 * 
 	 * @param data The data to uncompress.
 	 * 
-	 * @return The decompressed data.
+	 * @return The decompressed data, or an empty vector if it is malformed.
 	 */
 	std::vector<u8> uncompress(const std::vector<u8>& data);
 
@@ -29,15 +71,20 @@ namespace blz {
 	 * @brief Uncompress module data in-place.
 	 * 
 	 * @param data The data to uncompress.
+	 * 
+	 * @return Whether the data was uncompressed without reading or writing out of bounds.
 	 */
 	bool uncompressInplace(std::vector<u8>& data);
 
 	/**
-	 * @brief Uncompress module data in-place.
+	 * @brief Uncompress module data in-place, in a buffer that extends past its end by the size in its footer.
+	 * 
+	 * @param dataEnd The pointer to the end of the data to uncompress.
+	 * @param compressedSize The size of the data before dataEnd, i.e. how far back the compressed part may start.
 	 * 
-	 * @param data_end The pointer to the end of the data to uncompress.
+	 * @return Whether the data was uncompressed without reading or writing out of bounds.
 	 */
-	bool uncompressInplace(u8* data_end);
+	bool uncompressInplace(u8* dataEnd, size_t compressedSize);
 }
 
 } // nitro
@@ -2,6 +2,15 @@
 #include "armbin.hpp"
 #include "overlaybin.hpp"
 #include "headerbin.hpp"
+#include "manifest.hpp"
+#include "mappedfile.hpp"
+#include "memoryimage.hpp"
+#include "accesstrace.hpp"
+#include "narc.hpp"
+#include "table.hpp"
+#include "scan.hpp"
+#include "blz.hpp"
+#include "hash.hpp"
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
 	#define NITRO_API __declspec(dllexport)
@@ -15,6 +24,14 @@ using namespace nitro;
 
 extern "C" {
 
+	NITRO_API bool nitro_hashFile(const char* filePath, u64* outHash) {
+		MappedFile file;
+		if (!file.open(fs::path(filePath)))
+			return false;
+		*outHash = hash::xxh64(file.data(), file.size());
+		return true;
+	}
+
 	NITRO_API NitroRom* nitroRom_alloc() {
 		return new(std::nothrow) NitroRom;
 	}
@@ -23,12 +40,12 @@ extern "C" {
 		delete rom;
 	}
 
-	NITRO_API bool nitroRom_load(NitroRom* rom, const char* filePath) {
+	NITRO_API bool nitroRom_load(NitroRom* rom, const char* filePath, bool copy) {
 		
 		if (rom->loaded())
 			return false;
 
-		return rom->load(fs::path(filePath)) == NitroRom::LoadResult::Success;
+		return rom->load(fs::path(filePath), copy) == NitroRom::LoadResult::Success;
 	}
 
 	NITRO_API size_t nitroRom_getSize(const NitroRom* rom) {
@@ -47,26 +64,18 @@ extern "C" {
 		return rom->getFileSize(id);
 	}
 
+	// The binaries below are owned by the ROM and must not be released
+
 	NITRO_API ArmBin* nitroRom_loadArm9(NitroRom* rom) {
-		ArmBin* arm = new(std::nothrow) ArmBin;
-		if (!arm) return arm;
-		arm->load(rom->data().data(), rom->getHeader().arm9, rom->getHeader().arm9AutoLoadListHookOffset, true);
-		return arm;
+		return rom->getArm9();
 	}
 
 	NITRO_API ArmBin* nitroRom_loadArm7(NitroRom* rom) {
-		ArmBin* arm = new(std::nothrow) ArmBin;
-		arm->load(rom->data().data(), rom->getHeader().arm7, rom->getHeader().arm7AutoLoadListHookOffset, false);
-		return arm;
+		return rom->getArm7();
 	}
 
 	NITRO_API OverlayBin* nitroRom_loadOverlay(NitroRom* rom, u32 id) {
-		OverlayBin* ov = new(std::nothrow) OverlayBin;
-		if (!ov) return ov;
-		const OvtEntry& ovte = rom->getOvtEntry(id);
-		if (!ov->load(static_cast<const u8*>(rom->getFile(ovte.fileID)), ovte))
-			return nullptr;
-		return ov;
+		return rom->getOverlay(id);
 	}
 
 	NITRO_API const OvtEntry* nitroRom_getArm9OvT(const NitroRom* rom) {
@@ -77,6 +86,274 @@ extern "C" {
 		return rom->getOverlayCount();
 	}
 
+	NITRO_API u32 nitroRom_getFileCount(const NitroRom* rom) {
+		return rom->getFileCount();
+	}
+
+	NITRO_API s32 nitroRom_findFile(NitroRom* rom, const char* path) {
+		const FileNameTable* names = rom->getFileNames();
+		return names ? names->findFile(path) : -1;
+	}
+
+	NITRO_API const char* nitroRom_getFilePath(NitroRom* rom, u32 id) {
+		const FileNameTable* names = rom->getFileNames();
+		return names ? names->getPath(id).c_str() : "";
+	}
+
+	NITRO_API RomManifest* nitroRom_buildManifest(const NitroRom* rom, u32 threadCount) {
+		RomManifest* manifest = new(std::nothrow) RomManifest;
+		if (!manifest) return manifest;
+		if (!manifest->build(*rom, threadCount)) {
+			delete manifest;
+			return nullptr;
+		}
+		return manifest;
+	}
+
+
+	NITRO_API void romManifest_release(RomManifest* manifest) {
+		delete manifest;
+	}
+
+	NITRO_API u64 romManifest_getRomKey(const RomManifest* manifest) {
+		return manifest->getRomKey();
+	}
+
+	NITRO_API const RomManifest::Entry* romManifest_getHeader(const RomManifest* manifest) {
+		return &manifest->getHeader();
+	}
+
+	NITRO_API const RomManifest::Entry* romManifest_getArm9(const RomManifest* manifest) {
+		return &manifest->getArm9();
+	}
+
+	NITRO_API const RomManifest::Entry* romManifest_getArm7(const RomManifest* manifest) {
+		return &manifest->getArm7();
+	}
+
+	NITRO_API const RomManifest::Entry* romManifest_getOverlays(const RomManifest* manifest) {
+		return manifest->getOverlays().data();
+	}
+
+	NITRO_API u32 romManifest_getOverlayCount(const RomManifest* manifest) {
+		return u32(manifest->getOverlays().size());
+	}
+
+	NITRO_API const RomManifest::Entry* romManifest_getFiles(const RomManifest* manifest) {
+		return manifest->getFiles().data();
+	}
+
+	NITRO_API u32 romManifest_getFileCount(const RomManifest* manifest) {
+		return u32(manifest->getFiles().size());
+	}
+
+	NITRO_API const RomManifest::Checksums* romManifest_getChecksums(const RomManifest* manifest) {
+		return &manifest->getChecksums();
+	}
+
+	NITRO_API bool romManifest_checksumsValid(const RomManifest* manifest) {
+		return manifest->checksumsValid();
+	}
+
+
+	NITRO_API MemoryImage* memoryImage_build(NitroRom* rom) {
+		ArmBin* arm9 = rom->getArm9();
+		if (!arm9)
+			return nullptr;
+		MemoryImage* image = new(std::nothrow) MemoryImage;
+		if (!image) return image;
+		if (!image->build(*arm9)) {
+			delete image;
+			return nullptr;
+		}
+		return image;
+	}
+
+	NITRO_API void memoryImage_release(MemoryImage* image) {
+		delete image;
+	}
+
+	NITRO_API bool memoryImage_placeOverlay(MemoryImage* image, NitroRom* rom, u32 id) {
+		if (id >= rom->getOverlayCount())
+			return false;
+		OverlayBin* ov = rom->getOverlay(id);
+		return ov && image->placeOverlay(*ov, rom->getOvtEntry(id));
+	}
+
+	NITRO_API u32 memoryImage_getRegionCount(const MemoryImage* image) {
+		return u32(image->getRegions().size());
+	}
+
+	NITRO_API const MemoryImage::Region* memoryImage_getRegion(const MemoryImage* image, u32 index) {
+		return index < image->getRegions().size() ? &image->getRegions()[index] : nullptr;
+	}
+
+	NITRO_API bool memoryImage_pagesMatch(MemoryImage* image, const u32* addresses, const u64* hashes, u32 count) {
+		return AccessTrace::pagesMatch(*image, addresses, hashes, count);
+	}
+
+
+	NITRO_API AccessTrace* accessTrace_alloc(MemoryImage* image) {
+		return new(std::nothrow) AccessTrace(*image);
+	}
+
+	NITRO_API void accessTrace_release(AccessTrace* trace) {
+		delete trace;
+	}
+
+	NITRO_API void accessTrace_start(AccessTrace* trace) {
+		trace->start();
+	}
+
+	NITRO_API void accessTrace_finish(AccessTrace* trace) {
+		trace->finish();
+	}
+
+	// Matches Unicorn's uc_cb_hookcode_t, for UC_HOOK_BLOCK with the trace as user data
+	NITRO_API void accessTrace_blockHook(void* /*uc*/, u64 address, u32 size, void* trace) {
+		static_cast<AccessTrace*>(trace)->fetch(u32(address), size);
+	}
+
+	// Matches Unicorn's uc_cb_hookmem_t, for UC_HOOK_MEM_READ and UC_HOOK_MEM_WRITE with the trace as user data
+	NITRO_API void accessTrace_memHook(void* /*uc*/, int type, u64 address, int size, s64 /*value*/, void* trace) {
+		constexpr int UC_MEM_WRITE = 17;
+		if (type == UC_MEM_WRITE)
+			static_cast<AccessTrace*>(trace)->write(u32(address), u32(size));
+		else
+			static_cast<AccessTrace*>(trace)->read(u32(address), u32(size));
+	}
+
+	NITRO_API bool accessTrace_isComplete(const AccessTrace* trace) {
+		return trace->isComplete();
+	}
+
+	NITRO_API u32 accessTrace_getInputCount(const AccessTrace* trace) {
+		return u32(trace->getInputs().size());
+	}
+
+	NITRO_API const AccessTrace::PageInput* accessTrace_getInputs(const AccessTrace* trace) {
+		return trace->getInputs().data();
+	}
+
+	NITRO_API u32 accessTrace_getWriteCount(const AccessTrace* trace) {
+		return u32(trace->getWrites().size());
+	}
+
+	NITRO_API const AccessTrace::Write* accessTrace_getWrites(const AccessTrace* trace) {
+		return trace->getWrites().data();
+	}
+
+	NITRO_API const u8* accessTrace_getWriteData(const AccessTrace* trace) {
+		return trace->getWriteData().data();
+	}
+
+
+	NITRO_API Narc* narc_alloc() {
+		return new(std::nothrow) Narc;
+	}
+
+	NITRO_API void narc_release(Narc* narc) {
+		delete narc;
+	}
+
+	NITRO_API bool narc_load(Narc* narc, const u8* data, size_t size) {
+		return narc->load(data, size);
+	}
+
+	NITRO_API u32 narc_getFileCount(const Narc* narc) {
+		return narc->getFileCount();
+	}
+
+	NITRO_API const u8* narc_getFile(const Narc* narc, u32 id, u32* outSize) {
+		Narc::FileView file = narc->getFile(id);
+		*outSize = file.size;
+		return file.data;
+	}
+
+	NITRO_API const u8* narc_getUncompressedFile(Narc* narc, u32 id, u32* outSize) {
+		Narc::FileView file = narc->getUncompressedFile(id);
+		*outSize = file.size;
+		return file.data;
+	}
+
+	NITRO_API s32 narc_findFile(const Narc* narc, const char* path) {
+		return narc->findFile(path);
+	}
+
+	NITRO_API const char* narc_getFilePath(const Narc* narc, u32 id) {
+		return narc->getPath(id).c_str();
+	}
+
+	NITRO_API std::string* table_format(const u8* data, size_t size, const u8* fieldTypes, u32 fieldCount, u32 count,
+		u32 flags, u32 perLine) {
+		auto* text = new(std::nothrow) std::string;
+		if (text && !table::format(*text, data, size, fieldTypes, fieldCount, count, flags, perLine)) {
+			delete text;
+			return nullptr;
+		}
+		return text;
+	}
+
+	NITRO_API size_t table_getStride(const u8* fieldTypes, u32 fieldCount, bool packed) {
+		return table::getStride(fieldTypes, fieldCount, packed);
+	}
+
+	NITRO_API const char* text_getData(const std::string* text) {
+		return text->data();
+	}
+
+	NITRO_API size_t text_getSize(const std::string* text) {
+		return text->size();
+	}
+
+	NITRO_API void text_release(std::string* text) {
+		delete text;
+	}
+
+	NITRO_API std::vector<scan::Hit>* scan_findWords(const scan::Source* sources, u32 sourceCount,
+		const scan::Range* ranges, u32 rangeCount, u32 threadCount) {
+		return new(std::nothrow) std::vector<scan::Hit>(scan::findWords(sources, sourceCount, ranges, rangeCount, threadCount));
+	}
+
+	NITRO_API size_t scanResult_getCount(const std::vector<scan::Hit>* result) {
+		return result->size();
+	}
+
+	NITRO_API const scan::Hit* scanResult_getHits(const std::vector<scan::Hit>* result) {
+		return result->data();
+	}
+
+	NITRO_API void scanResult_release(std::vector<scan::Hit>* result) {
+		delete result;
+	}
+
+	NITRO_API std::vector<u8>* blz_compress(const u8* data, size_t size) {
+		return new(std::nothrow) std::vector<u8>(blz::compress(std::vector<u8>(data, data + size)));
+	}
+
+	NITRO_API std::vector<u8>* blz_recompress(const u8* oldCompressed, size_t oldCompressedSize, const u8* oldData,
+		size_t oldDataSize, const u8* data, size_t size, size_t dirtyStart, size_t dirtyEnd, size_t maxSize, bool* outFits) {
+		auto* out = new(std::nothrow) std::vector<u8>;
+		if (out) {
+			*outFits = blz::recompress(*out, std::vector<u8>(oldCompressed, oldCompressed + oldCompressedSize),
+				std::vector<u8>(oldData, oldData + oldDataSize), std::vector<u8>(data, data + size),
+				dirtyStart, dirtyEnd, maxSize);
+		}
+		return out;
+	}
+
+	NITRO_API const u8* bytes_getData(const std::vector<u8>* bytes) {
+		return bytes->data();
+	}
+
+	NITRO_API size_t bytes_getSize(const std::vector<u8>* bytes) {
+		return bytes->size();
+	}
+
+	NITRO_API void bytes_release(std::vector<u8>* bytes) {
+		delete bytes;
+	}
+
 
 	NITRO_API HeaderBin* headerBin_alloc() {
 		return new(std::nothrow) HeaderBin;
@@ -175,10 +452,18 @@ extern "C" {
 		return bin->getSize();
 	}
 
+	NITRO_API u32 codeBin_getRevision(const ICodeBin* bin) {
+		return bin->getRevision();
+	}
+
 	NITRO_API const void* codeBin_getSectPtr(const ICodeBin* bin, u32 address, size_t sect_size) {
 		return (bin->getStartAddress() + bin->getSize() < address + sect_size) ? nullptr : bin->getPtrToData(address);
 	}
 
+	NITRO_API const void* codeBin_getRangePtr(const ICodeBin* bin, u32 address, u32 size) {
+		return bin->getPtrToRange(address, size);
+	}
+
 
 	NITRO_API ArmBin* armBin_alloc() {
 		return new(std::nothrow) ArmBin;
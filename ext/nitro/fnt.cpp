@@ -0,0 +1,106 @@
+#include "fnt.hpp"
+
+namespace nitro {
+
+namespace {
+
+struct DirEntry {
+	u32 entryStart;
+	u16 entryFileID;
+	u16 parentID; // the number of directories for the root
+};
+
+constexpr u16 ROOT_DIR_ID = 0xF000;
+constexpr u32 MAX_DIR_COUNT = 0x1000;
+
+u16 readU16(const u8* p) { return u16(p[0] | (p[1] << 8)); }
+u32 readU32(const u8* p) { return u32(p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24)); }
+
+DirEntry readDir(const u8* data, u32 index) {
+	const u8* p = &data[index * 8];
+	return { readU32(p), readU16(p + 4), readU16(p + 6) };
+}
+
+} // anonymous
+
+bool FileNameTable::parse(const u8* data, u32 size, u32 fileCount) {
+	m_ids.clear();
+	m_paths.assign(fileCount, {});
+
+	if (size < 8)
+		return false;
+
+	u32 dirCount = readDir(data, 0).parentID;
+	if (dirCount == 0 || dirCount > MAX_DIR_COUNT || dirCount * 8 > size)
+		return false;
+
+	// Directories are walked from the root so each one is only reached through its parent, which also rules out cycles
+	std::vector<std::string> dirPaths(dirCount);
+	std::vector<bool> visited(dirCount);
+	std::vector<u32> pending = { 0 };
+	visited[0] = true;
+
+	while (!pending.empty()) {
+		u32 dirIndex = pending.back();
+		pending.pop_back();
+
+		DirEntry dir = readDir(data, dirIndex);
+		u32 fileID = dir.entryFileID;
+		u32 pos = dir.entryStart;
+
+		for (;;) {
+			if (pos >= size)
+				return false;
+			u8 typeLen = data[pos++];
+			if (typeLen == 0)
+				break;
+
+			u32 nameLength = typeLen & 0x7F;
+			bool isDir = typeLen & 0x80;
+			if (nameLength == 0 || pos + nameLength + (isDir ? 2 : 0) > size)
+				return false;
+
+			std::string path = dirPaths[dirIndex];
+			if (!path.empty())
+				path += '/';
+			path.append(reinterpret_cast<const char*>(&data[pos]), nameLength);
+			pos += nameLength;
+
+			if (isDir) {
+				u32 subIndex = u32(readU16(&data[pos]) - ROOT_DIR_ID);
+				pos += 2;
+				if (subIndex == 0 || subIndex >= dirCount || visited[subIndex])
+					return false;
+				visited[subIndex] = true;
+				dirPaths[subIndex] = std::move(path);
+				pending.push_back(subIndex);
+			} else {
+				if (fileID >= fileCount)
+					return false;
+				m_paths[fileID++] = std::move(path);
+			}
+		}
+	}
+
+	m_ids.reserve(fileCount);
+	for (u32 id = 0; id < fileCount; id++) {
+		if (!m_paths[id].empty())
+			m_ids.emplace(m_paths[id], id);
+	}
+
+	return true;
+}
+
+s32 FileNameTable::findFile(std::string_view path) const {
+	if (path.starts_with('/'))
+		path.remove_prefix(1);
+	auto it = m_ids.find(path);
+	return it == m_ids.end() ? -1 : s32(it->second);
+}
+
+const std::string& FileNameTable::getPath(u32 id) const {
+	static const std::string none;
+	return id < m_paths.size() ? m_paths[id] : none;
+}
+
+} // nitro
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief Paths of the files named by a file name table, the FNT of a ROM or the BTNF chunk of a NARC.
+ * Files the table leaves out (e.g. the overlays of a ROM, or every file of an unnamed NARC) have no path.
+ */
+class FileNameTable {
+public:
+	FileNameTable() = default;
+
+	// The index holds views into the paths, which a copy or move would leave pointing into the source
+	FileNameTable(const FileNameTable&) = delete;
+	FileNameTable& operator=(const FileNameTable&) = delete;
+	FileNameTable(FileNameTable&&) = delete;
+	FileNameTable& operator=(FileNameTable&&) = delete;
+
+	/**
+	 * @brief Walk a file name table and index every path in it.
+	 *
+	 * @param data The table, starting with its main directory table.
+	 * @param size The size of the table.
+	 * @param fileCount The number of files the table may refer to.
+	 *
+	 * @return Whether the table is well-formed.
+	 */
+	bool parse(const u8* data, u32 size, u32 fileCount);
+
+	/**
+	 * @brief Look up a file by path, with directories separated by '/'.
+	 *
+	 * @param path The path of the file, relative to the root (a leading '/' is ignored).
+	 *
+	 * @return The ID of the file, or -1 if there is none at that path.
+	 */
+	[[nodiscard]] s32 findFile(std::string_view path) const;
+
+	/**
+	 * @brief Get the path of a file.
+	 *
+	 * @param id The ID of the file.
+	 *
+	 * @return The path of the file, empty if the table doesn't name it.
+	 */
+	[[nodiscard]] const std::string& getPath(u32 id) const;
+
+private:
+	std::vector<std::string> m_paths; // by file ID
+	std::unordered_map<std::string_view, u32> m_ids; // views into m_paths
+};
+
+} // nitro
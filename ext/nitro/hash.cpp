@@ -0,0 +1,120 @@
+#include "hash.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace nitro {
+
+namespace hash {
+
+	static constexpr u64 Prime64_1 = 0x9E3779B185EBCA87ULL;
+	static constexpr u64 Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr u64 Prime64_3 = 0x165667B19E3779F9ULL;
+	static constexpr u64 Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+	static constexpr u64 Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+	static inline u64 rotl64(u64 x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	static inline u64 read64(const u8* p) {
+		u64 v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline u32 read32(const u8* p) {
+		u32 v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline u64 round64(u64 acc, u64 input) {
+		acc += input * Prime64_2;
+		acc = rotl64(acc, 31);
+		return acc * Prime64_1;
+	}
+
+	static inline u64 mergeRound64(u64 acc, u64 val) {
+		acc ^= round64(0, val);
+		return acc * Prime64_1 + Prime64_4;
+	}
+
+	u64 xxh64(const void* data, size_t size, u64 seed) {
+		const u8* p = static_cast<const u8*>(data);
+		const u8* const end = p + size;
+		u64 h;
+
+		if (size >= 32) {
+			const u8* const limit = end - 32;
+			u64 v1 = seed + Prime64_1 + Prime64_2;
+			u64 v2 = seed + Prime64_2;
+			u64 v3 = seed;
+			u64 v4 = seed - Prime64_1;
+
+			do {
+				v1 = round64(v1, read64(p));
+				v2 = round64(v2, read64(p + 8));
+				v3 = round64(v3, read64(p + 16));
+				v4 = round64(v4, read64(p + 24));
+				p += 32;
+			} while (p <= limit);
+
+			h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+			h = mergeRound64(h, v1);
+			h = mergeRound64(h, v2);
+			h = mergeRound64(h, v3);
+			h = mergeRound64(h, v4);
+		} else {
+			h = seed + Prime64_5;
+		}
+
+		h += u64(size);
+
+		while (p + 8 <= end) {
+			h ^= round64(0, read64(p));
+			h = rotl64(h, 27) * Prime64_1 + Prime64_4;
+			p += 8;
+		}
+
+		if (p + 4 <= end) {
+			h ^= u64(read32(p)) * Prime64_1;
+			h = rotl64(h, 23) * Prime64_2 + Prime64_3;
+			p += 4;
+		}
+
+		while (p < end) {
+			h ^= (*p++) * Prime64_5;
+			h = rotl64(h, 11) * Prime64_1;
+		}
+
+		h ^= h >> 33;
+		h *= Prime64_2;
+		h ^= h >> 29;
+		h *= Prime64_3;
+		h ^= h >> 32;
+
+		return h;
+	}
+
+	static constexpr std::array<u16, 256> Crc16Table = [] {
+		std::array<u16, 256> table{};
+		for (u32 i = 0; i < 256; i++) {
+			u16 crc = u16(i);
+			for (u32 j = 0; j < 8; j++)
+				crc = (crc & 1) ? u16((crc >> 1) ^ 0xA001) : u16(crc >> 1);
+			table[i] = crc;
+		}
+		return table;
+	}();
+
+	u16 crc16(const void* data, size_t size, u16 crc) {
+		const u8* p = static_cast<const u8*>(data);
+		for (size_t i = 0; i < size; i++)
+			crc = u16((crc >> 8) ^ Crc16Table[(crc ^ p[i]) & 0xFF]);
+		return crc;
+	}
+
+}
+
+} // nitro
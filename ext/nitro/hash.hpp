@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+#include "common.hpp"
+
+namespace nitro {
+
+namespace hash {
+	/**
+	 * @brief Compute the 64-bit XXH64 hash of a block of data.
+	 * 
+	 * @param data The data to hash.
+	 * @param size The size of the data in bytes.
+	 * @param seed The seed of the hash.
+	 * 
+	 * @return The hash of the data.
+	 */
+	u64 xxh64(const void* data, size_t size, u64 seed = 0);
+
+	/**
+	 * @brief Compute the CRC16 (polynomial 0xA001) used by the header, secure area and banner checksums.
+	 * 
+	 * @param data The data to checksum.
+	 * @param size The size of the data in bytes.
+	 * @param crc The initial value of the checksum.
+	 * 
+	 * @return The checksum of the data.
+	 */
+	u16 crc16(const void* data, size_t size, u16 crc = 0xFFFF);
+}
+
+} // nitro
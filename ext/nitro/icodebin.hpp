@@ -11,6 +11,8 @@ public:
 	virtual u32 getSize() const = 0;
 	virtual u32 getStartAddress() const = 0;
 	virtual const void* getPtrToData(u32 address) const = 0;
+	// Only succeeds if the whole range lies in one contiguous section, otherwise nullptr
+	virtual const void* getPtrToRange(u32 address, u32 size) const = 0;
 
 	template<typename T>
 	T read(u32 address) const {
@@ -23,6 +25,12 @@ public:
 	void write(u32 address, T value) {
 		writeBytes(address, &value, sizeof(T));
 	}
+
+	// Bumped by every successful write, so cached views of the data know when to refresh
+	[[nodiscard]] u32 getRevision() const { return m_revision; }
+
+protected:
+	u32 m_revision = 0;
 };
 
 } // nitro
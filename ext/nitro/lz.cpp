@@ -0,0 +1,102 @@
+#include "lz.hpp"
+
+namespace nitro {
+
+namespace lz {
+
+	static constexpr u8 TYPE_LZ10 = 0x10;
+	static constexpr u8 TYPE_LZ11 = 0x11;
+
+	// The most a stream can expand to: LZ10 references are 2 bytes for up to 18, LZ11 ones 4 bytes for up to 0x10110
+	static constexpr u64 LZ10_MAX_PER_2_BYTES = 18;
+	static constexpr u64 LZ11_MAX_PER_4_BYTES = 0x10110;
+
+	// The size after the type byte, or the word after it if that is zero; returns the offset of the stream, or 0 if
+	// the header is malformed or claims more than the rest of the data could expand to
+	static u32 readHeader(const u8* src, u32 srcSize, u32& size) {
+		if (srcSize < 4 || (src[0] != TYPE_LZ10 && src[0] != TYPE_LZ11))
+			return 0;
+		u32 offset = 4;
+		size = src[1] | (src[2] << 8) | (src[3] << 16);
+		if (size == 0) {
+			if (srcSize < 8)
+				return 0;
+			size = src[4] | (src[5] << 8) | (src[6] << 16) | (u32(src[7]) << 24);
+			offset = 8;
+		}
+		u64 streamSize = srcSize - offset;
+		u64 maxSize = src[0] == TYPE_LZ10 ? (streamSize / 2 + 1) * LZ10_MAX_PER_2_BYTES
+			: (streamSize / 4 + 1) * LZ11_MAX_PER_4_BYTES;
+		return size <= maxSize ? offset : 0;
+	}
+
+	u32 getUncompressedSize(const u8* src, u32 srcSize) {
+		u32 size = 0;
+		return readHeader(src, srcSize, size) ? size : 0;
+	}
+
+	bool uncompress(const u8* src, u32 srcSize, u8* dst, u32 dstSize) {
+		u32 size = 0;
+		u32 in = readHeader(src, srcSize, size);
+		if (in == 0 || size > dstSize)
+			return false;
+
+		bool extended = src[0] == TYPE_LZ11;
+		u32 out = 0;
+
+		while (out < size) {
+			if (in >= srcSize)
+				return false;
+			u8 flags = src[in++];
+
+			for (int i = 0; i < 8 && out < size; i++, flags <<= 1) {
+				if (!(flags & 0x80)) {
+					if (in >= srcSize)
+						return false;
+					dst[out++] = src[in++];
+					continue;
+				}
+
+				if (in + 2 > srcSize)
+					return false;
+
+				u32 length, disp;
+				u8 b0 = src[in];
+
+				if (!extended) {
+					length = (b0 >> 4) + 3;
+					disp = (((b0 & 0xF) << 8) | src[in + 1]) + 1;
+					in += 2;
+				} else if ((b0 >> 4) == 0) {
+					if (in + 3 > srcSize)
+						return false;
+					length = (((b0 & 0xF) << 4) | (src[in + 1] >> 4)) + 0x11;
+					disp = (((src[in + 1] & 0xF) << 8) | src[in + 2]) + 1;
+					in += 3;
+				} else if ((b0 >> 4) == 1) {
+					if (in + 4 > srcSize)
+						return false;
+					length = (((b0 & 0xF) << 12) | (src[in + 1] << 4) | (src[in + 2] >> 4)) + 0x111;
+					disp = (((src[in + 2] & 0xF) << 8) | src[in + 3]) + 1;
+					in += 4;
+				} else {
+					length = (b0 >> 4) + 1;
+					disp = (((b0 & 0xF) << 8) | src[in + 1]) + 1;
+					in += 2;
+				}
+
+				if (disp > out || length > size - out)
+					return false;
+
+				// Copied a byte at a time, as the copy may overlap what it is writing
+				for (u32 j = 0; j < length; j++, out++)
+					dst[out] = dst[out - disp];
+			}
+		}
+
+		return true;
+	}
+
+}
+
+} // nitro
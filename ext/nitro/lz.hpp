@@ -0,0 +1,35 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief The LZ77 variants of the BIOS decompression routines (LZ10) and their successor (LZ11), the usual formats of
+ * compressed files in the filesystem of a ROM. Unlike BLZ these are decoded forwards, from a header at the start.
+ */
+namespace lz {
+	/**
+	 * @brief Read the header of LZ10/LZ11 data.
+	 *
+	 * @param src The compressed data.
+	 * @param srcSize The size of the compressed data.
+	 *
+	 * @return The size of the data once uncompressed, or 0 if it doesn't start with an LZ10/LZ11 header.
+	 */
+	u32 getUncompressedSize(const u8* src, u32 srcSize);
+
+	/**
+	 * @brief Uncompress LZ10/LZ11 data.
+	 *
+	 * @param src The compressed data.
+	 * @param srcSize The size of the compressed data.
+	 * @param dst The buffer to uncompress into, of the size given by getUncompressedSize.
+	 * @param dstSize The size of the buffer.
+	 *
+	 * @return Whether the data was uncompressed in full without reading or writing out of bounds.
+	 */
+	bool uncompress(const u8* src, u32 srcSize, u8* dst, u32 dstSize);
+}
+
+} // nitro
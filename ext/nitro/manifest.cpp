@@ -0,0 +1,97 @@
+#include "manifest.hpp"
+
+#include <cstddef>
+
+#include "rom.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+
+namespace nitro {
+
+static constexpr u32 HeaderChecksumSize = 0x15E;
+static constexpr u32 LogoOffset = 0xC0;
+static constexpr u32 SecureAreaStart = 0x4000;
+static constexpr u32 SecureAreaEnd = 0x8000;
+static constexpr u32 BannerCrcStart = 0x20;
+static constexpr u32 BannerCrcEnd = 0x840; // crc16V1 covers the icon and the 6 titles
+
+bool RomManifest::build(const NitroRom& rom, u32 threadCount) {
+	if (!rom.loaded() || rom.size() < sizeof(HeaderBin))
+		return false;
+
+	const u8* bytes = rom.data();
+	const size_t romSize = rom.size();
+	const HeaderBin& header = rom.getHeader();
+
+	auto makeEntry = [romSize](u32 start, u32 end) -> Entry {
+		if (start > romSize) start = u32(romSize);
+		if (end > romSize || end < start) end = start;
+		return Entry{ 0, start, end - start };
+	};
+
+	const u32 fileCount = rom.getFileCount();
+	const u32 overlayCount = rom.getOverlayCount();
+
+	// The first three jobs are the header and the ARM binaries, the rest are the FAT files
+	std::vector<Entry> jobs;
+	jobs.reserve(3 + fileCount);
+	jobs.push_back(makeEntry(0, sizeof(HeaderBin)));
+	jobs.push_back(makeEntry(header.arm9.romOffset, header.arm9.romOffset + header.arm9.size));
+	jobs.push_back(makeEntry(header.arm7.romOffset, header.arm7.romOffset + header.arm7.size));
+	for (u32 i = 0; i < fileCount; i++) {
+		const NitroRom::FATEntry& fatEntry = rom.getFATEntry(i);
+		jobs.push_back(makeEntry(fatEntry.start, fatEntry.end));
+	}
+
+	parallelFor(jobs.size(), [&](size_t i) {
+		jobs[i].hash = hash::xxh64(bytes + jobs[i].romOffset, jobs[i].size);
+	}, threadCount);
+
+	m_header = jobs[0];
+	m_arm9 = jobs[1];
+	m_arm7 = jobs[2];
+	m_files.assign(jobs.begin() + 3, jobs.end());
+
+	m_overlays.clear();
+	m_overlays.reserve(overlayCount);
+	for (u32 i = 0; i < overlayCount; i++) {
+		u32 fileID = rom.getOvtEntry(i).fileID;
+		m_overlays.push_back(fileID < fileCount ? m_files[fileID] : Entry{});
+	}
+
+	std::vector<u64> keys;
+	keys.reserve(jobs.size() + m_overlays.size());
+	for (const Entry& entry : jobs)
+		keys.push_back(entry.hash);
+	for (const Entry& entry : m_overlays)
+		keys.push_back(entry.hash);
+	m_romKey = hash::xxh64(keys.data(), keys.size() * sizeof(u64));
+
+	m_checksums.headerStored = header.headerChecksum;
+	m_checksums.headerComputed = hash::crc16(bytes, HeaderChecksumSize);
+
+	m_checksums.logoStored = header.nintendoLogoCheckSum;
+	m_checksums.logoComputed = hash::crc16(bytes + LogoOffset, sizeof(header.nintendoLogo));
+
+	m_checksums.secureAreaStored = header.secureAreaChecksum;
+	m_checksums.secureAreaComputed = romSize >= SecureAreaEnd
+		? hash::crc16(bytes + SecureAreaStart, SecureAreaEnd - SecureAreaStart) : 0;
+
+	if (header.bannerOffset != 0 && size_t(header.bannerOffset) + BannerCrcEnd <= romSize) {
+		m_checksums.bannerStored = rom.getBanner().crc16V1;
+		m_checksums.bannerComputed = hash::crc16(bytes + header.bannerOffset + BannerCrcStart, BannerCrcEnd - BannerCrcStart);
+	} else {
+		m_checksums.bannerStored = m_checksums.bannerComputed = 0;
+	}
+
+	return true;
+}
+
+bool RomManifest::checksumsValid() const {
+	// The secure area checksum is computed over the encrypted secure area, so decrypted dumps never match it
+	return m_checksums.headerStored == m_checksums.headerComputed
+		&& m_checksums.logoStored == m_checksums.logoComputed
+		&& m_checksums.bannerStored == m_checksums.bannerComputed;
+}
+
+} // nitro
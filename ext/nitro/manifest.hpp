@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+namespace nitro {
+
+class NitroRom;
+
+class RomManifest {
+public:
+	struct Entry {
+		u64 hash;
+		u32 romOffset;
+		u32 size;
+	};
+
+	struct Checksums {
+		u16 headerStored;
+		u16 headerComputed;
+		u16 secureAreaStored;
+		u16 secureAreaComputed;
+		u16 logoStored;
+		u16 logoComputed;
+		u16 bannerStored;
+		u16 bannerComputed;
+	};
+
+	RomManifest() = default;
+
+	/**
+	 * @brief Hash every part of a ROM and compute its checksums.
+	 * 
+	 * @param rom The ROM to build the manifest of.
+	 * @param threadCount The maximum number of threads to hash with, or 0 for the hardware concurrency.
+	 * 
+	 * @return Whether the manifest could be built.
+	 */
+	bool build(const NitroRom& rom, u32 threadCount = 0);
+
+	[[nodiscard]] bool checksumsValid() const;
+
+	[[nodiscard]] constexpr u64 getRomKey() const { return m_romKey; }
+	[[nodiscard]] constexpr const Entry& getHeader() const { return m_header; }
+	[[nodiscard]] constexpr const Entry& getArm9() const { return m_arm9; }
+	[[nodiscard]] constexpr const Entry& getArm7() const { return m_arm7; }
+	[[nodiscard]] constexpr const Checksums& getChecksums() const { return m_checksums; }
+
+	[[nodiscard]] constexpr const std::vector<Entry>& getOverlays() const { return m_overlays; }
+	[[nodiscard]] constexpr const std::vector<Entry>& getFiles() const { return m_files; }
+
+private:
+	u64 m_romKey = 0; // hash of all the entry hashes
+	Entry m_header = {};
+	Entry m_arm9 = {};
+	Entry m_arm7 = {};
+	Checksums m_checksums = {};
+	std::vector<Entry> m_overlays;
+	std::vector<Entry> m_files;
+};
+
+} // nitro
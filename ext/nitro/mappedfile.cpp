@@ -0,0 +1,110 @@
+#include "mappedfile.hpp"
+
+#include <fstream>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace nitro {
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const fs::path& path, bool copy) {
+
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = copy ? INVALID_HANDLE_VALUE : CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+			mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping) {
+			void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (view) {
+				m_fileHandle = file;
+				m_mappingHandle = mapping;
+				m_data = static_cast<const u8*>(view);
+				m_size = static_cast<size_t>(fileSize.QuadPart);
+				m_mapped = true;
+				return true;
+			}
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+	}
+#else
+	int fd = copy ? -1 : ::open(path.c_str(), O_RDONLY);
+	if (fd != -1) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view != MAP_FAILED) {
+				::close(fd); // the mapping keeps its own reference to the file
+				m_data = static_cast<const u8*>(view);
+				m_size = size_t(st.st_size);
+				m_mapped = true;
+				return true;
+			}
+		}
+		::close(fd);
+	}
+#endif
+
+	// READ FILE ================================
+
+	std::error_code ec;
+	uintmax_t fileSize = fs::file_size(path, ec);
+	if (ec || fileSize == 0)
+		return false;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	m_fallback.resize(fileSize);
+	if (!file.read(reinterpret_cast<char*>(m_fallback.data()), std::streamsize(fileSize))) {
+		m_fallback.clear();
+		return false;
+	}
+
+	m_data = m_fallback.data();
+	m_size = m_fallback.size();
+	return true;
+}
+
+void MappedFile::close() {
+
+	if (m_mapped) {
+#if defined(_WIN32)
+		UnmapViewOfFile(m_data);
+		CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+		CloseHandle(static_cast<HANDLE>(m_fileHandle));
+		m_mappingHandle = nullptr;
+		m_fileHandle = nullptr;
+#else
+		munmap(const_cast<u8*>(m_data), m_size);
+#endif
+	}
+
+	m_fallback.clear();
+	m_fallback.shrink_to_fit();
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+}
+
+} // nitro
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief Read-only view of a whole file. Pages are only read in when touched, so opening a file costs the same no
+ * matter its size. Falls back to reading the file into memory where it cannot be mapped.
+ */
+class MappedFile {
+public:
+	MappedFile() noexcept = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * @brief Map a file, closing any file previously mapped.
+	 * 
+	 * @param path The path of the file.
+	 * @param copy Read the file into memory instead. A private mapping still shows later changes to pages not yet
+	 * read in, and faults on access if the file is truncated; a copy is unaffected by the file changing.
+	 * 
+	 * @return Whether the file could be opened.
+	 */
+	bool open(const std::filesystem::path& path, bool copy = false);
+
+	void close();
+
+	[[nodiscard]] bool isOpen() const { return m_data != nullptr; }
+	[[nodiscard]] const u8* data() const { return m_data; }
+	[[nodiscard]] size_t size() const { return m_size; }
+
+private:
+	const u8* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_mapped = false;
+	std::vector<u8> m_fallback;
+#if defined(_WIN32)
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+#endif
+};
+
+} // nitro
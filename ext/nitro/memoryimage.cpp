@@ -0,0 +1,109 @@
+#include "memoryimage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace nitro {
+
+static constexpr u64 alignUp(u64 value, u64 alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool MemoryImage::build(const ArmBin& arm9) {
+	m_buffer.reset();
+	m_regions.clear();
+
+	const u32 ramAddr = arm9.getStartAddress();
+	const u32 binSize = arm9.getSize();
+	if (ramAddr < MAIN_RAM_ADDRESS || u64(ramAddr) + binSize > u64(MAIN_RAM_ADDRESS) + MAIN_RAM_SIZE)
+		return false;
+
+	m_regions.push_back({ ITCM_ADDRESS, ITCM_SIZE, nullptr });
+	m_regions.push_back({ MAIN_RAM_ADDRESS, MAIN_RAM_SIZE, nullptr });
+
+	auto overlapsRegion = [&](u64 start, u64 end) {
+		for (const Region& region : m_regions) {
+			if (start < u64(region.address) + region.size && end > region.address)
+				return true;
+		}
+		return false;
+	};
+
+	// Autoloads going anywhere else target DTCM, whose base is 16KB aligned
+	for (const ArmBin::AutoLoadEntry& entry : arm9.getAutoloadList()) {
+		u64 end = u64(entry.address) + entry.size + entry.bssSize;
+		if (end == entry.address || findRegion(entry.address, u32(end - entry.address)))
+			continue;
+		u64 start = entry.address & ~u64(DTCM_SIZE - 1);
+		end = std::max(alignUp(end, PAGE_SIZE), start + DTCM_SIZE);
+		if (end > 0x100000000 || overlapsRegion(start, end))
+			continue;
+		m_regions.push_back({ u32(start), u32(end - start), nullptr });
+	}
+
+	size_t totalSize = 0;
+	for (const Region& region : m_regions)
+		totalSize += region.size;
+
+	m_buffer.reset(new(std::align_val_t(PAGE_SIZE), std::nothrow) u8[totalSize]);
+	if (!m_buffer) {
+		m_regions.clear();
+		return false;
+	}
+	std::memset(m_buffer.get(), 0, totalSize);
+
+	size_t offset = 0;
+	for (Region& region : m_regions) {
+		region.data = &m_buffer[offset];
+		offset += region.size;
+	}
+
+	// The whole binary is loaded first, autoload data included, as the loader would
+	std::memcpy(translate(ramAddr, binSize), arm9.data(), binSize);
+
+	for (const ArmBin::AutoLoadEntry& entry : arm9.getAutoloadList()) {
+		if (u64(entry.dataOffset) + entry.size > binSize)
+			continue;
+		u8* dest = translate(entry.address, entry.size + entry.bssSize);
+		if (!dest)
+			continue;
+		std::memcpy(dest, &arm9.data()[entry.dataOffset], entry.size);
+		std::memset(dest + entry.size, 0, entry.bssSize);
+	}
+
+	const ArmBin::ModuleParams* moduleParams = arm9.getModuleParams();
+	if (moduleParams->staticBssEnd > moduleParams->staticBssStart) {
+		u32 bssSize = moduleParams->staticBssEnd - moduleParams->staticBssStart;
+		if (u8* bss = translate(moduleParams->staticBssStart, bssSize))
+			std::memset(bss, 0, bssSize);
+	}
+
+	return true;
+}
+
+bool MemoryImage::placeOverlay(const OverlayBin& ov, const OvtEntry& ovte) {
+	u32 codeSize = std::min(ovte.ramSize, ov.getSize());
+	u8* dest = translate(ov.getStartAddress(), codeSize + ovte.bssSize);
+	if (!dest)
+		return false;
+
+	std::memcpy(dest, ov.data(), codeSize);
+	std::memset(dest + codeSize, 0, ovte.bssSize);
+	return true;
+}
+
+u8* MemoryImage::translate(u32 address, u32 size) {
+	Region* region = findRegion(address, size);
+	return region && region->data ? &region->data[address - region->address] : nullptr;
+}
+
+MemoryImage::Region* MemoryImage::findRegion(u32 address, u32 size) {
+	for (Region& region : m_regions) {
+		if (address >= region.address && u64(address) + size <= u64(region.address) + region.size)
+			return &region;
+	}
+	return nullptr;
+}
+
+} // nitro
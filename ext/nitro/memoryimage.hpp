@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "armbin.hpp"
+#include "overlaybin.hpp"
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief ARM9 memory as it is right after the static binary has started: the binary in main RAM, its autoloads
+ * copied to ITCM, DTCM or wherever else they go, and the BSS of both zeroed. Every region is a page-aligned host
+ * buffer, so an emulator can map them directly (e.g. with uc_mem_map_ptr) rather than copying them in.
+ */
+class MemoryImage {
+public:
+	struct Region {
+		u32 address;
+		u32 size;
+		u8* data;
+	};
+
+	static constexpr u32 PAGE_SIZE = 0x1000;
+	static constexpr u32 ITCM_ADDRESS = 0x01FF8000;
+	static constexpr u32 ITCM_SIZE = 0x8000;
+	static constexpr u32 MAIN_RAM_ADDRESS = 0x02000000;
+	static constexpr u32 MAIN_RAM_SIZE = 0x400000;
+	static constexpr u32 DTCM_SIZE = 0x4000;
+
+	MemoryImage() noexcept = default;
+
+	MemoryImage(const MemoryImage&) = delete;
+	MemoryImage& operator=(const MemoryImage&) = delete;
+
+	/**
+	 * @brief Lay out the regions and place the ARM9 binary in them, discarding anything placed before.
+	 * Autoloads that don't fall in ITCM or main RAM are taken to be DTCM, which gets a region of its own.
+	 *
+	 * @param arm9 The ARM9 binary.
+	 *
+	 * @return Whether the image could be allocated and the binary fits in main RAM.
+	 */
+	bool build(const ArmBin& arm9);
+
+	/**
+	 * @brief Copy an overlay into the image and zero its BSS, replacing whatever overlapped it.
+	 *
+	 * @param ov The overlay.
+	 * @param ovte The overlay table entry of the overlay.
+	 *
+	 * @return Whether the overlay and its BSS fit in a region.
+	 */
+	bool placeOverlay(const OverlayBin& ov, const OvtEntry& ovte);
+
+	/**
+	 * @brief Get a pointer to the image's copy of an address range.
+	 *
+	 * @param address The start of the range.
+	 * @param size The size of the range.
+	 *
+	 * @return The pointer, or nullptr if the range isn't within a single region.
+	 */
+	[[nodiscard]] u8* translate(u32 address, u32 size);
+
+	[[nodiscard]] const std::vector<Region>& getRegions() const { return m_regions; }
+
+private:
+	struct AlignedDelete {
+		void operator()(u8* ptr) const { ::operator delete[](ptr, std::align_val_t(PAGE_SIZE)); }
+	};
+
+	Region* findRegion(u32 address, u32 size);
+
+	std::unique_ptr<u8[], AlignedDelete> m_buffer;
+	std::vector<Region> m_regions;
+};
+
+} // nitro
@@ -0,0 +1,153 @@
+#include "narc.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "blz.hpp"
+#include "lz.hpp"
+
+namespace nitro {
+
+namespace {
+
+struct NarcHeader {
+	char magic[4];  // "NARC"
+	u16 byteOrder;  // 0xFFFE
+	u16 version;
+	u32 fileSize;
+	u16 headerSize;
+	u16 chunkCount;
+};
+
+struct ChunkHeader {
+	char magic[4];
+	u32 size;       // including this header
+};
+
+// Members carry no marker of BLZ, so besides a consistent footer this wants the 0xFF padding compressors put
+// before it and a nonzero size to grow by, which raw data is unlikely to have by chance
+bool isBlzCompressed(const u8* data, u32 size) {
+	if (blz::getExtraSize(data, size) == 0)
+		return false;
+	u32 headerSize = data[size - 5];
+	return std::all_of(&data[size - headerSize], &data[size - 8], [](u8 b) { return b == 0xFF; });
+}
+
+} // anonymous
+
+bool Narc::load(const u8* data, size_t size) {
+	m_files.clear();
+	m_uncompressed.clear();
+
+	if (size < sizeof(NarcHeader) || size > 0xFFFFFFFF)
+		return false;
+
+	NarcHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, "NARC", 4) != 0 || header.byteOrder != 0xFFFE || header.headerSize < sizeof(header))
+		return false;
+
+	// Chunks are found by name rather than position, and the size in the header is trusted only as far as the data
+	size_t end = std::min<size_t>(size, header.fileSize);
+	const u8* fat = nullptr;
+	const u8* fnt = nullptr;
+	const u8* img = nullptr;
+	u32 fatSize = 0, fntSize = 0, imgSize = 0;
+
+	for (size_t pos = header.headerSize; pos + sizeof(ChunkHeader) <= end;) {
+		ChunkHeader chunk;
+		std::memcpy(&chunk, &data[pos], sizeof(chunk));
+		if (chunk.size < sizeof(chunk) || chunk.size > end - pos)
+			return false;
+
+		const u8* body = &data[pos + sizeof(chunk)];
+		u32 bodySize = chunk.size - u32(sizeof(chunk));
+		if (std::memcmp(chunk.magic, "BTAF", 4) == 0)
+			fat = body, fatSize = bodySize;
+		else if (std::memcmp(chunk.magic, "BTNF", 4) == 0)
+			fnt = body, fntSize = bodySize;
+		else if (std::memcmp(chunk.magic, "GMIF", 4) == 0)
+			img = body, imgSize = bodySize;
+
+		pos += chunk.size;
+	}
+
+	if (!fat || !fnt || !img || fatSize < 4)
+		return false;
+
+	u16 fileCount;
+	std::memcpy(&fileCount, fat, 2);
+	if (4 + size_t(fileCount) * 8 > fatSize)
+		return false;
+
+	m_files.reserve(fileCount);
+	for (u32 id = 0; id < fileCount; id++) {
+		u32 bounds[2];
+		std::memcpy(bounds, &fat[4 + id * 8], 8);
+		if (bounds[1] < bounds[0] || bounds[1] > imgSize) {
+			m_files.clear();
+			return false;
+		}
+		m_files.push_back({ &img[bounds[0]], bounds[1] - bounds[0] });
+	}
+
+	if (!m_names.parse(fnt, fntSize, fileCount)) {
+		m_files.clear();
+		return false;
+	}
+
+	return true;
+}
+
+Narc::FileView Narc::getFile(u32 id) const {
+	return id < m_files.size() ? m_files[id] : FileView{ nullptr, 0 };
+}
+
+Narc::FileView Narc::getUncompressedFile(u32 id) {
+	if (id >= m_files.size())
+		return { nullptr, 0 };
+
+	auto it = m_uncompressed.find(id);
+	if (it != m_uncompressed.end())
+		return { it->second.data(), u32(it->second.size()) };
+
+	FileView file = m_files[id];
+	std::vector<u8> out;
+	if (!uncompressFile(file, out))
+		return file;
+
+	// The buffer of a vector stays put when the map rehashes, so views handed out earlier remain valid
+	std::vector<u8>& cached = m_uncompressed.emplace(id, std::move(out)).first->second;
+	return { cached.data(), u32(cached.size()) };
+}
+
+bool Narc::uncompressFile(FileView file, std::vector<u8>& out) {
+	out.clear();
+
+	// Sizes are capped by what the formats can expand to, but may still be more than can be allocated
+	try {
+		if (u32 size = lz::getUncompressedSize(file.data, file.size)) {
+			out.resize(size);
+			if (lz::uncompress(file.data, file.size, out.data(), size))
+				return true;
+			out.clear();
+			return false;
+		}
+
+		if (isBlzCompressed(file.data, file.size)) {
+			out.assign(file.data, file.data + file.size);
+			if (blz::uncompressInplace(out))
+				return true;
+			out.clear();
+			return false;
+		}
+	}
+	catch (const std::bad_alloc&) {
+		out.clear();
+	}
+
+	return false;
+}
+
+} // nitro
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "fnt.hpp"
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief A NARC archive read in place: its file allocation and name tables are parsed once, and files are handed out
+ * as views into the buffer the archive was loaded from, which must outlive it. Only compressed files are copied, when
+ * they are first asked for uncompressed.
+ */
+class Narc {
+public:
+	struct FileView {
+		const u8* data;
+		u32 size;
+	};
+
+	Narc() noexcept = default;
+
+	Narc(const Narc&) = delete;
+	Narc& operator=(const Narc&) = delete;
+
+	/**
+	 * @brief Parse an archive, e.g. a file of a NitroRom or of another archive.
+	 *
+	 * @param data The archive, which is not copied.
+	 * @param size The size of the archive.
+	 *
+	 * @return Whether the archive is valid, with every file within its image chunk.
+	 */
+	bool load(const u8* data, size_t size);
+
+	[[nodiscard]] u32 getFileCount() const { return u32(m_files.size()); }
+
+	/**
+	 * @brief Get a file as stored in the archive.
+	 *
+	 * @param id The ID of the file.
+	 *
+	 * @return A view of the file, with a null pointer if there is no file with that ID.
+	 */
+	[[nodiscard]] FileView getFile(u32 id) const;
+
+	/**
+	 * @brief Get a file, uncompressed if it is LZ10, LZ11 or BLZ compressed. A compressed file is uncompressed into
+	 * memory owned by the archive the first time, and that copy is returned from then on. As the formats are only told
+	 * apart by their headers, a file that doesn't uncompress cleanly is taken to be stored as is.
+	 *
+	 * @param id The ID of the file.
+	 *
+	 * @return A view of the file, with a null pointer if there is no file with that ID.
+	 */
+	FileView getUncompressedFile(u32 id);
+
+	[[nodiscard]] s32 findFile(std::string_view path) const { return m_names.findFile(path); }
+	[[nodiscard]] const std::string& getPath(u32 id) const { return m_names.getPath(id); }
+
+	/**
+	 * @brief Uncompress a file if it is LZ10, LZ11 or BLZ compressed, telling them apart by header and footer.
+	 *
+	 * @param file The file.
+	 * @param out The buffer to uncompress into.
+	 *
+	 * @return Whether the file was compressed and uncompressed successfully; out is left empty otherwise.
+	 */
+	static bool uncompressFile(FileView file, std::vector<u8>& out);
+
+private:
+	std::vector<FileView> m_files;
+	FileNameTable m_names;
+	std::unordered_map<u32, std::vector<u8>> m_uncompressed;
+};
+
+} // nitro
@@ -23,59 +23,95 @@ bool OverlayBin::load(const fs::path& path, u32 ramAddress, bool compressed, s32
 	if (!fs::exists(path) || !file.is_open() || fileSize == 0)
 		return false;
 
-	m_bytes.resize(fileSize);
-	file.read(reinterpret_cast<char*>(m_bytes.data()), std::streamsize(fileSize));
+	m_ownedBytes.resize(fileSize);
+	file.read(reinterpret_cast<char*>(m_ownedBytes.data()), std::streamsize(fileSize));
 	file.close();
 
-	if (compressed)
-		blz::uncompressInplace(m_bytes);
+	if (compressed && !blz::uncompressInplace(m_ownedBytes))
+		return false;
+
+	m_data = m_ownedBytes.data();
+	m_size = static_cast<u32>(m_ownedBytes.size());
 
 	return true;
 }
 
-bool OverlayBin::load(const u8* ovPtr, const OvtEntry& ovte) {
+bool OverlayBin::load(const u8* ovPtr, u32 fileSize, const OvtEntry& ovte) {
+
+	u32 loadedSize = getLoadedSize(ovPtr, fileSize, ovte);
+	m_ownedBytes.resize(loadedSize);
+	return load(ovPtr, fileSize, ovte, m_ownedBytes.data(), loadedSize);
+}
+
+bool OverlayBin::load(const u8* ovPtr, u32 fileSize, const OvtEntry& ovte, u8* dest, u32 destSize) {
 
 	m_ramAddress = ovte.ramAddress;
 	m_id = ovte.overlayID;
 	m_isDirty = false;
 
 	bool compressed = ovte.flag & OVERLAY_FLAG_COMP;
+	u32 storedSize = compressed ? ovte.compressed : ovte.ramSize;
+	u32 loadedSize = getLoadedSize(ovPtr, fileSize, ovte);
 
-	m_bytes.assign(ovPtr, ovPtr + (compressed ? ovte.compressed : ovte.ramSize));
+	if (dest == nullptr || loadedSize > destSize || storedSize > loadedSize || storedSize > fileSize ||
+		(compressed && storedSize < 8))
+		return false;
 
-	if (compressed) {
-		if (!blz::uncompressInplace(m_bytes))
-			return false;
-	}
+	std::memcpy(dest, ovPtr, storedSize);
+	m_data = dest;
+	m_size = loadedSize;
+
+	if (compressed)
+		return blz::uncompressInplace(dest + storedSize, storedSize);
 
 	return true;
 }
 
+u32 OverlayBin::getLoadedSize(const u8* ovPtr, u32 fileSize, const OvtEntry& ovte) {
+
+	if (!(ovte.flag & OVERLAY_FLAG_COMP) || ovte.compressed < 8)
+		return ovte.ramSize <= MAX_SIZE ? ovte.ramSize : 0;
+
+	if (ovte.compressed > fileSize || !blz::isValidFooter(ovPtr, ovte.compressed))
+		return 0;
+
+	// The footer holds the number of bytes the overlay grows by, which should agree with ramSize
+	u64 loadedSize = u64(ovte.compressed) + blz::getExtraSize(ovPtr, ovte.compressed);
+	return loadedSize <= MAX_SIZE ? u32(loadedSize) : 0;
+}
+
 bool OverlayBin::readBytes(u32 address, void* out, u32 size) const {
 
 	u32 binAddress = address - m_ramAddress;
-	if (binAddress + size > m_bytes.size()) {
+	if (binAddress + size > m_size) {
 		std::ostringstream oss;
 		oss << "Failed to read from overlay " << m_id << ", reading " << size << " byte(s) from address 0x" <<
 			std::uppercase << std::hex << address << std::nouppercase << " exceeds range.";
 		return false;
 	}
-	std::memcpy(out, &m_bytes[binAddress], size);
+	std::memcpy(out, &m_data[binAddress], size);
 	return true;
 }
 
 bool OverlayBin::writeBytes(u32 address, const void* data, u32 size) {
 
 	u32 binAddress = address - m_ramAddress;
-	if (binAddress + size > m_bytes.size()) {
+	if (binAddress + size > m_size) {
 		std::ostringstream oss;
 		oss << "Failed to write to overlay " << m_id << ", writing " << size << " byte(s) to address 0x" <<
 			std::uppercase << std::hex << address << std::nouppercase << " exceeds range.";
 		return false;
 	}
-	std::memcpy(&m_bytes[binAddress], data, size);
+	std::memcpy(&m_data[binAddress], data, size);
 	m_isDirty = true;
+	m_revision++;
 	return true;
 }
 
+const void* OverlayBin::getPtrToRange(u32 address, u32 size) const {
+	if (address < m_ramAddress || u64(address - m_ramAddress) + size > m_size)
+		return nullptr;
+	return &m_data[address - m_ramAddress];
+}
+
 } // nitro
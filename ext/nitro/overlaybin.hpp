@@ -24,21 +24,54 @@ struct OvtEntry {
 
 class OverlayBin : public ICodeBin {
 public:
+	static constexpr u32 MAX_SIZE = 0x800000; // all of main RAM on a debug unit
+
 	OverlayBin() = default;
 
+	// m_data may point into m_ownedBytes, which a copy or move would leave pointing into the source
+	OverlayBin(const OverlayBin&) = delete;
+	OverlayBin& operator=(const OverlayBin&) = delete;
+	OverlayBin(OverlayBin&&) = delete;
+	OverlayBin& operator=(OverlayBin&&) = delete;
+
 	bool load(const std::filesystem::path& path, u32 ramAddress, bool compressed, s32 id);
-	bool load(const u8* ovPtr, const OvtEntry& ovte);
+	bool load(const u8* ovPtr, u32 fileSize, const OvtEntry& ovte);
+
+	/**
+	 * @brief Load the overlay from a ROM into a buffer owned by the caller, decompressing it in place.
+	 * 
+	 * @param ovPtr Pointer to the overlay file in the ROM.
+	 * @param fileSize Size of the overlay file.
+	 * @param ovte The overlay table entry of the overlay.
+	 * @param dest Buffer that will hold the overlay, which must outlive it.
+	 * @param destSize Size of dest, at least getLoadedSize().
+	 * 
+	 * @return Whether the overlay was loaded.
+	 */
+	bool load(const u8* ovPtr, u32 fileSize, const OvtEntry& ovte, u8* dest, u32 destSize);
+
+	/**
+	 * @brief Get the size of an overlay in a ROM once decompressed.
+	 * 
+	 * @param ovPtr Pointer to the overlay file in the ROM.
+	 * @param fileSize Size of the overlay file.
+	 * @param ovte The overlay table entry of the overlay.
+	 * 
+	 * @return The decompressed size, or 0 if the overlay is malformed or larger than MAX_SIZE.
+	 */
+	static u32 getLoadedSize(const u8* ovPtr, u32 fileSize, const OvtEntry& ovte);
 
 	bool readBytes(u32 address, void* out, u32 size) const override;
 	bool writeBytes(u32 address, const void* data, u32 size) override;
 
-	u32 getSize() const override { return static_cast<u32>(m_bytes.size()); }
+	u32 getSize() const override { return m_size; }
 	u32 getStartAddress() const override { return m_ramAddress; }
 
-	const void* getPtrToData(u32 address) const override { return &m_bytes[address - m_ramAddress]; }
+	const void* getPtrToData(u32 address) const override { return &m_data[address - m_ramAddress]; }
+	const void* getPtrToRange(u32 address, u32 size) const override;
 
-	[[nodiscard]] constexpr std::vector<u8>& data()						{ return m_bytes; };
-	[[nodiscard]] constexpr const std::vector<u8>& data() const			{ return m_bytes; };
+	[[nodiscard]] constexpr u8* data()									{ return m_data; };
+	[[nodiscard]] constexpr const u8* data() const						{ return m_data; };
 	[[nodiscard]] constexpr std::vector<u8>& backupData()				{ return m_backupData; };
 	[[nodiscard]] constexpr const std::vector<u8>& backupData() const	{ return m_backupData; };
 
@@ -48,7 +81,9 @@ public:
 	s32 getID() const { return m_id; }
 
 private:
-	std::vector<u8> m_bytes;
+	u8* m_data = nullptr; // either m_ownedBytes or a buffer owned by the ROM
+	u32 m_size = 0;
+	std::vector<u8> m_ownedBytes;
 	u32 m_ramAddress;
 	s32 m_id;
 	bool m_isDirty;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief Call a function for every index in [0, count) across a set of worker threads.
+ * 
+ * Indices are handed out one at a time, so uneven work items balance themselves.
+ * 
+ * @param count The number of work items.
+ * @param fn The function to call with each index.
+ * @param threadCount The maximum number of threads to use, or 0 for the hardware concurrency.
+ */
+template<typename Fn>
+void parallelFor(size_t count, Fn&& fn, u32 threadCount = 0) {
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = u32(std::min<size_t>(threadCount, count));
+
+	if (threadCount <= 1) {
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	std::atomic<size_t> next = 0;
+	auto worker = [&] {
+		for (size_t i = next++; i < count; i = next++)
+			fn(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (u32 i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+} // nitro
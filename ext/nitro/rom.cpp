@@ -2,60 +2,236 @@
 
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 namespace fs = std::filesystem;
 
 namespace nitro {
 
-NitroRom::LoadResult NitroRom::load(const fs::path& path) {
+static constexpr size_t ARENA_ALIGNMENT = 32;
 
-    if (!fs::exists(path) || !fs::is_regular_file(path))
+NitroRom::LoadResult NitroRom::load(const fs::path& path, bool copy) {
+
+	if (!fs::exists(path) || !fs::is_regular_file(path))
 		return LoadResult::InvalidPath;
 
-	std::ifstream romFile(path, std::ios::binary);
-	if (!romFile.is_open())
-		return LoadResult::Failure;
+	m_loaded = false;
+	m_arena.reset();
+	m_slots.clear();
+	m_arm9.reset();
+	m_arm7.reset();
+	m_overlays.clear();
+	m_fileNames.reset();
+	m_fileNamesParsed = false;
 
-	uintmax_t romSize = fs::file_size(path);
+	if (!m_file.open(path, copy))
+		return LoadResult::Failure;
 
-	if (romSize >= (1 << 30)) // 1 GiB = 2^30 bytes
+	if (m_file.size() >= (1 << 30)) { // 1 GiB = 2^30 bytes
+		m_file.close();
 		return LoadResult::SizeExceed;
+	}
+
+	if (!validateHeader()) {
+		m_file.close();
+		return LoadResult::InvalidHeader;
+	}
+
+	m_loaded = true;
+
+	return LoadResult::Success;
+}
+
+// Only touches the header, so it stays cheap however large the ROM is
+bool NitroRom::validateHeader() const {
+
+	if (m_file.size() < sizeof(HeaderBin))
+		return false;
 
-	// TODO: More safety to ensure this is a valid nds rom?
-	m_bytes.resize(romSize);
-	romFile.read(reinterpret_cast<char*>(m_bytes.data()), romSize);
+	const HeaderBin& header = getHeader();
 
-    m_loaded = true;
+	auto inRom = [&](u32 offset, u32 size) {
+		return size_t(offset) + size <= m_file.size();
+	};
 
-    return LoadResult::Success;
+	if (header.arm9.size < 4 || !inRom(header.arm9.romOffset, header.arm9.size))
+		return false;
+	if (header.arm7.size < 4 || !inRom(header.arm7.romOffset, header.arm7.size))
+		return false;
+	if (!inRom(header.fnt.romOffset, header.fnt.size) || !inRom(header.fat.romOffset, header.fat.size))
+		return false;
+	if (header.arm9OvT.size % sizeof(OvtEntry) != 0 || !inRom(header.arm9OvT.romOffset, header.arm9OvT.size))
+		return false;
+	if (header.arm7OvT.size % sizeof(OvtEntry) != 0 || !inRom(header.arm7OvT.romOffset, header.arm7OvT.size))
+		return false;
+
+	return true;
 }
 
 const HeaderBin& NitroRom::getHeader() const {
-	return reinterpret_cast<const HeaderBin&>(*m_bytes.data());
+	return reinterpret_cast<const HeaderBin&>(*m_file.data());
 }
 
 const NitroRom::Banner& NitroRom::getBanner() const {
-	return reinterpret_cast<const Banner&>(m_bytes.data()[getHeader().bannerOffset]);
+	return reinterpret_cast<const Banner&>(m_file.data()[getHeader().bannerOffset]);
 }
 
 const NitroRom::FATEntry& NitroRom::getFATEntry(u32 index) const {
-	return reinterpret_cast<const FATEntry*>(&m_bytes.data()[getHeader().fat.romOffset])[index];
+	return reinterpret_cast<const FATEntry*>(&m_file.data()[getHeader().fat.romOffset])[index];
+}
+
+bool NitroRom::isFileValid(u32 id) const {
+	if (id >= getFileCount())
+		return false;
+	const FATEntry& fatEntry = getFATEntry(id);
+	return fatEntry.start <= fatEntry.end && fatEntry.end <= m_file.size();
 }
 
 const void* NitroRom::getFile(u32 id) const {
-	return static_cast<const void*>(&m_bytes.data()[getFATEntry(id).start]);
+	if (!isFileValid(id))
+		return nullptr;
+	return static_cast<const void*>(&m_file.data()[getFATEntry(id).start]);
 }
 
 u32 NitroRom::getFileSize(u32 id) const {
+	if (!isFileValid(id))
+		return 0;
 	return getFATEntry(id).end - getFATEntry(id).start;
 }
 
+u32 NitroRom::getFileCount() const {
+	return getHeader().fat.size / sizeof(FATEntry);
+}
+
 const OvtEntry& NitroRom::getOvtEntry(u32 index) const {
-	return reinterpret_cast<const OvtEntry*>(&m_bytes.data()[getHeader().arm9OvT.romOffset])[index];
+	return reinterpret_cast<const OvtEntry*>(&m_file.data()[getHeader().arm9OvT.romOffset])[index];
 }
 
 u32 NitroRom::getOverlayCount() const {
 	return getHeader().arm9OvT.size / sizeof(OvtEntry);
 }
 
+const FileNameTable* NitroRom::getFileNames() {
+	if (!m_fileNamesParsed) {
+		m_fileNamesParsed = true;
+		const HeaderBin& header = getHeader();
+		if (!m_fileNames.emplace().parse(&m_file.data()[header.fnt.romOffset], header.fnt.size, getFileCount()))
+			m_fileNames.reset();
+	}
+	return m_fileNames ? &*m_fileNames : nullptr;
+}
+
+ArmBin* NitroRom::getArm9() {
+
+	if (m_arm9)
+		return &*m_arm9;
+
+	if (!reserveArena())
+		return nullptr;
+
+	const HeaderBin& header = getHeader();
+	const ArenaSlot& slot = m_slots[0];
+	if (!m_arm9.emplace().load(m_file.data(), header.arm9, header.arm9AutoLoadListHookOffset, true,
+		&m_arena[slot.offset], slot.size)) {
+		m_arm9.reset();
+		return nullptr;
+	}
+
+	return &*m_arm9;
+}
+
+ArmBin* NitroRom::getArm7() {
+
+	if (m_arm7)
+		return &*m_arm7;
+
+	if (!reserveArena())
+		return nullptr;
+
+	const HeaderBin& header = getHeader();
+	const ArenaSlot& slot = m_slots[1];
+	if (!m_arm7.emplace().load(m_file.data(), header.arm7, header.arm7AutoLoadListHookOffset, false,
+		&m_arena[slot.offset], slot.size)) {
+		m_arm7.reset();
+		return nullptr;
+	}
+
+	return &*m_arm7;
+}
+
+OverlayBin* NitroRom::getOverlay(u32 id) {
+
+	if (!reserveArena() || id >= m_overlays.size())
+		return nullptr;
+
+	std::optional<OverlayBin>& ov = m_overlays[id];
+	if (ov)
+		return &*ov;
+
+	const OvtEntry& ovte = getOvtEntry(id);
+	const ArenaSlot& slot = m_slots[2 + id];
+	const u8* file = static_cast<const u8*>(getFile(ovte.fileID));
+	if (!file || !ov.emplace().load(file, getFileSize(ovte.fileID), ovte, &m_arena[slot.offset], slot.size)) {
+		ov.reset();
+		return nullptr;
+	}
+
+	return &*ov;
+}
+
+// Lays out a slot for every binary from the sizes they decompress to, then allocates them all at once
+bool NitroRom::reserveArena() {
+
+	if (m_arena)
+		return true;
+
+	if (!m_loaded)
+		return false;
+
+	const HeaderBin& header = getHeader();
+	const u8* romPtr = m_file.data();
+	u32 overlayCount = getOverlayCount();
+
+	size_t arenaSize = 0;
+	m_slots.clear();
+	m_slots.reserve(2 + overlayCount);
+
+	auto addSlot = [&](u32 size) {
+		m_slots.push_back({ arenaSize, size });
+		arenaSize += (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+	};
+
+	auto inRom = [&](u32 offset, u32 size) {
+		return size_t(offset) + size <= m_file.size();
+	};
+
+	addSlot(inRom(header.arm9.romOffset, header.arm9.size) ?
+		ArmBin::getLoadedSize(romPtr, header.arm9, header.arm9AutoLoadListHookOffset) : 0);
+	addSlot(inRom(header.arm7.romOffset, header.arm7.size) ?
+		ArmBin::getLoadedSize(romPtr, header.arm7, header.arm7AutoLoadListHookOffset) : 0);
+
+	for (u32 i = 0; i < overlayCount; i++) {
+		const OvtEntry& ovte = getOvtEntry(i);
+		if (!isFileValid(ovte.fileID)) {
+			addSlot(0);
+			continue;
+		}
+		// A malformed overlay gets no space, so it fails to load on its own instead of failing the whole arena
+		const u8* file = static_cast<const u8*>(getFile(ovte.fileID));
+		u32 loadedSize = OverlayBin::getLoadedSize(file, getFileSize(ovte.fileID), ovte);
+		addSlot(loadedSize == 0 ? 0 : std::max(std::min(ovte.ramSize, OverlayBin::MAX_SIZE), loadedSize));
+	}
+
+	m_arena.reset(new(std::nothrow) u8[arenaSize]);
+	if (!m_arena) {
+		m_slots.clear();
+		return false;
+	}
+
+	// OverlayBin can't be moved, so the vector is built at its final size rather than resized
+	m_overlays = std::vector<std::optional<OverlayBin>>(overlayCount);
+
+	return true;
+}
+
 } // nitro
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+
+#include "mappedfile.hpp"
 #include "headerbin.hpp"
 #include "armbin.hpp"
 #include "overlaybin.hpp"
+#include "fnt.hpp"
 
 namespace nitro {
 
@@ -12,6 +17,7 @@ public:
         Success,
         InvalidPath,
         SizeExceed,
+        InvalidHeader,
         Failure
     };
 
@@ -50,25 +56,107 @@ public:
 
     NitroRom() noexcept = default;
 
-    LoadResult load(const std::filesystem::path& path);
+    /**
+     * @brief Open a ROM by mapping it and validating its header and tables. Nothing else is read until it is used,
+     * and the binaries are only decompressed on first access.
+     * 
+     * @param path The path of the ROM.
+     * @param copy Read the whole ROM into memory instead of mapping it, for long-lived processes that shouldn't be
+     * affected by the file being rewritten while it's open.
+     * 
+     * @return The result of opening the ROM.
+     */
+    LoadResult load(const std::filesystem::path& path, bool copy = false);
 
     bool loaded() const { return m_loaded; }
 
-    [[nodiscard]] constexpr size_t size() const { return m_bytes.size(); };
-    [[nodiscard]] constexpr const std::vector<u8>& data() const { return m_bytes; };
+    [[nodiscard]] size_t size() const { return m_file.size(); };
+    [[nodiscard]] const u8* data() const { return m_file.data(); };
 
     [[nodiscard]] const HeaderBin& getHeader() const;
     [[nodiscard]] const Banner& getBanner() const;
     [[nodiscard]] const FATEntry& getFATEntry(u32 index) const;
-    [[nodiscard]] const void* getFile(u32 id) const;
     [[nodiscard]] const OvtEntry& getOvtEntry(u32 index) const;
 
+    /**
+     * @brief Check that a file exists and that its FAT entry lies within the ROM.
+     * 
+     * @param id The ID of the file.
+     * 
+     * @return Whether the file can be read.
+     */
+    [[nodiscard]] bool isFileValid(u32 id) const;
+
+    /**
+     * @brief Get a file of the ROM's filesystem, read in place.
+     * 
+     * @param id The ID of the file.
+     * 
+     * @return The start of the file, or nullptr if it is not valid.
+     */
+    [[nodiscard]] const void* getFile(u32 id) const;
+
+    /**
+     * @brief Get the size of a file of the ROM's filesystem.
+     * 
+     * @param id The ID of the file.
+     * 
+     * @return The size of the file, or 0 if it is not valid.
+     */
     u32 getFileSize(u32 id) const;
+    u32 getFileCount() const;
     u32 getOverlayCount() const;
 
+    /**
+     * @brief Get the paths of the files in the ROM's filesystem, parsing its FNT on first use.
+     * 
+     * @return The table, owned by the ROM, or nullptr if the FNT is malformed.
+     */
+    const FileNameTable* getFileNames();
+
+    /**
+     * @brief Get the ARM9 binary, decompressing it into the ROM's arena on first use.
+     * 
+     * @return The binary, owned by the ROM, or nullptr if it could not be loaded.
+     */
+    ArmBin* getArm9();
+
+    /**
+     * @brief Get the ARM7 binary, decompressing it into the ROM's arena on first use.
+     * 
+     * @return The binary, owned by the ROM, or nullptr if it could not be loaded.
+     */
+    ArmBin* getArm7();
+
+    /**
+     * @brief Get an overlay, decompressing it into the ROM's arena on first use.
+     * 
+     * @param id The ID of the overlay.
+     * 
+     * @return The overlay, owned by the ROM, or nullptr if it could not be loaded.
+     */
+    OverlayBin* getOverlay(u32 id);
+
 private:
-    std::vector<u8> m_bytes;
+    struct ArenaSlot {
+        size_t offset;
+        u32 size;
+    };
+
+    bool reserveArena();
+    bool validateHeader() const;
+
+    MappedFile m_file;
     bool m_loaded = false;
+
+    // One allocation holds every decompressed binary: ARM9, ARM7, then each overlay
+    std::unique_ptr<u8[]> m_arena;
+    std::vector<ArenaSlot> m_slots;
+    std::optional<ArmBin> m_arm9;
+    std::optional<ArmBin> m_arm7;
+    std::vector<std::optional<OverlayBin>> m_overlays;
+    std::optional<FileNameTable> m_fileNames;
+    bool m_fileNamesParsed = false;
 };
 
 } // nitro
@@ -0,0 +1,119 @@
+#include "scan.hpp"
+
+#include <cstring>
+
+#include "parallel.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <emmintrin.h>
+	#define NITRO_SCAN_SSE2
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+	#include <arm_neon.h>
+	#define NITRO_SCAN_NEON
+#endif
+
+namespace nitro {
+
+namespace scan {
+
+	// A value is in [start, end) exactly when value - start < end - start, as unsigned numbers
+	static bool inRanges(u32 value, const Range* ranges, u32 rangeCount) {
+		for (u32 r = 0; r < rangeCount; r++) {
+			if (value - ranges[r].start < ranges[r].end - ranges[r].start)
+				return true;
+		}
+		return false;
+	}
+
+	static u32 readWord(const u8* p) {
+		u32 value;
+		std::memcpy(&value, p, sizeof(value));
+		return value; // the DS and every host this builds for are little-endian
+	}
+
+	void findWords(const Source& source, u32 sourceIndex, const Range* ranges, u32 rangeCount, std::vector<Hit>& hits) {
+		if (rangeCount == 0 || source.data == nullptr)
+			return;
+
+		u32 offset = (4 - (source.address & 3)) & 3;
+		const u32 size = source.size;
+
+		auto check = [&](u32 at) {
+			u32 value = readWord(source.data + at);
+			if (inRanges(value, ranges, rangeCount))
+				hits.push_back(Hit{ sourceIndex, source.address + at, value });
+		};
+
+#if defined(NITRO_SCAN_SSE2)
+		// Four words at a time: SSE2 only compares signed integers, so both sides are biased by 2^31 first
+		struct VectorRange {
+			__m128i start;
+			__m128i length; // biased
+		};
+		const __m128i bias = _mm_set1_epi32(s32(0x80000000));
+		std::vector<VectorRange> vectorRanges(rangeCount);
+		for (u32 r = 0; r < rangeCount; r++) {
+			vectorRanges[r].start = _mm_set1_epi32(s32(ranges[r].start));
+			vectorRanges[r].length = _mm_xor_si128(_mm_set1_epi32(s32(ranges[r].end - ranges[r].start)), bias);
+		}
+		for (; u64(offset) + 16 <= size; offset += 16) {
+			__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data + offset));
+			__m128i any = _mm_setzero_si128();
+			for (const VectorRange& range : vectorRanges) {
+				__m128i relative = _mm_xor_si128(_mm_sub_epi32(words, range.start), bias);
+				any = _mm_or_si128(any, _mm_cmplt_epi32(relative, range.length));
+			}
+			if (_mm_movemask_epi8(any) != 0) {
+				for (u32 lane = 0; lane < 16; lane += 4)
+					check(offset + lane);
+			}
+		}
+#elif defined(NITRO_SCAN_NEON)
+		struct VectorRange {
+			uint32x4_t start;
+			uint32x4_t length;
+		};
+		std::vector<VectorRange> vectorRanges(rangeCount);
+		for (u32 r = 0; r < rangeCount; r++) {
+			vectorRanges[r].start = vdupq_n_u32(ranges[r].start);
+			vectorRanges[r].length = vdupq_n_u32(ranges[r].end - ranges[r].start);
+		}
+		for (; u64(offset) + 16 <= size; offset += 16) {
+			uint32x4_t words = vreinterpretq_u32_u8(vld1q_u8(source.data + offset));
+			uint32x4_t any = vdupq_n_u32(0);
+			for (const VectorRange& range : vectorRanges)
+				any = vorrq_u32(any, vcltq_u32(vsubq_u32(words, range.start), range.length));
+			// vmaxvq_u32 is AArch64-only, so the halves are folded together to build for 32-bit ARM too
+			uint32x2_t folded = vorr_u32(vget_low_u32(any), vget_high_u32(any));
+			if (vget_lane_u64(vreinterpret_u64_u32(folded), 0) != 0) {
+				for (u32 lane = 0; lane < 16; lane += 4)
+					check(offset + lane);
+			}
+		}
+#endif
+
+		for (; u64(offset) + 4 <= size; offset += 4)
+			check(offset);
+	}
+
+	std::vector<Hit> findWords(const Source* sources, u32 sourceCount, const Range* ranges, u32 rangeCount,
+		u32 threadCount) {
+		std::vector<std::vector<Hit>> perSource(sourceCount);
+		parallelFor(sourceCount, [&](size_t i) {
+			findWords(sources[i], u32(i), ranges, rangeCount, perSource[i]);
+		}, threadCount);
+
+		size_t total = 0;
+		for (const auto& hits : perSource)
+			total += hits.size();
+
+		std::vector<Hit> hits;
+		hits.reserve(total);
+		for (const auto& sourceHits : perSource)
+			hits.insert(hits.end(), sourceHits.begin(), sourceHits.end());
+		return hits;
+	}
+
+}
+
+} // nitro
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief Searches of binaries for words whose values fall in a set of address ranges, i.e. for the pointers to some
+ * data or code.
+ */
+namespace scan {
+	/// Addresses [start, end)
+	struct Range {
+		u32 start;
+		u32 end;
+	};
+
+	/// A block of data to scan, mapped at some address (or at 0, for offsets into a file)
+	struct Source {
+		const u8* data;
+		u32 size;
+		u32 address;
+	};
+
+	struct Hit {
+		u32 source;  ///< Index of the source the word is in
+		u32 address; ///< Address of the word
+		u32 value;
+	};
+
+	/**
+	 * @brief Find the aligned words of a block of data whose values are in any of the ranges.
+	 *
+	 * @param source The data to scan; words are aligned to its address.
+	 * @param sourceIndex The index to give the hits.
+	 * @param ranges The ranges to look for.
+	 * @param rangeCount The number of ranges.
+	 * @param hits The vector to append the hits to, in address order.
+	 */
+	void findWords(const Source& source, u32 sourceIndex, const Range* ranges, u32 rangeCount, std::vector<Hit>& hits);
+
+	/**
+	 * @brief Find the aligned words of several blocks of data whose values are in any of the ranges, scanning the
+	 * blocks in parallel.
+	 *
+	 * @param sources The data to scan.
+	 * @param sourceCount The number of sources.
+	 * @param ranges The ranges to look for.
+	 * @param rangeCount The number of ranges.
+	 * @param threadCount The maximum number of threads to use, or 0 for the hardware concurrency.
+	 *
+	 * @return The hits, ordered by source then address.
+	 */
+	std::vector<Hit> findWords(const Source* sources, u32 sourceCount, const Range* ranges, u32 rangeCount,
+		u32 threadCount = 0);
+}
+
+} // nitro
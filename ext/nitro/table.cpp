@@ -0,0 +1,114 @@
+#include "table.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+
+namespace nitro {
+
+namespace table {
+
+	static constexpr u8 TYPE_SIZES[TYPE_COUNT] = { 8, 4, 2, 1, 8, 4, 2, 1 };
+
+	static size_t alignUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	size_t getStride(const u8* fieldTypes, u32 fieldCount, bool packed) {
+		size_t offset = 0;
+		size_t maxAlignment = 1;
+		for (u32 i = 0; i < fieldCount; i++) {
+			if (fieldTypes[i] >= TYPE_COUNT)
+				return 0;
+			size_t fieldSize = TYPE_SIZES[fieldTypes[i]];
+			if (!packed) {
+				offset = alignUp(offset, fieldSize);
+				maxAlignment = std::max(maxAlignment, fieldSize);
+			}
+			offset += fieldSize;
+		}
+		return packed ? offset : alignUp(offset, maxAlignment);
+	}
+
+	static u64 readField(const u8* p, u8 type) {
+		u64 value = 0;
+		for (u32 i = TYPE_SIZES[type]; i-- > 0;)
+			value = (value << 8) | p[i];
+		return value;
+	}
+
+	static void appendValue(std::string& out, u64 raw, u8 type, bool hex) {
+		u32 bits = TYPE_SIZES[type] * 8;
+		bool isSigned = type >= TYPE_S64;
+		bool negative = isSigned && (raw >> (bits - 1)) & 1;
+
+		u64 magnitude = raw;
+		if (negative) {
+			magnitude = (bits == 64) ? ~raw + 1 : (u64(1) << bits) - raw;
+			out += '-';
+		}
+
+		char buf[24];
+		if (hex)
+			out += "0x";
+		auto result = std::to_chars(buf, buf + sizeof(buf), magnitude, hex ? 16 : 10);
+		out.append(buf, result.ptr);
+
+		// Decimal literals past the range of long long would otherwise be warned about
+		if (bits == 64 && !isSigned && !hex && magnitude > u64(INT64_MAX))
+			out += "ULL";
+	}
+
+	bool format(std::string& out, const u8* data, size_t size, const u8* fieldTypes, u32 fieldCount, u32 count,
+		u32 flags, u32 perLine) {
+		bool packed = flags & FLAG_PACKED;
+		bool hex = flags & FLAG_HEX;
+
+		size_t stride = getStride(fieldTypes, fieldCount, packed);
+		if (fieldCount == 0 || stride == 0 || size / stride < count)
+			return false;
+
+		// Most values take a handful of characters; reserving for them avoids regrowing the buffer as it's written
+		out.reserve(out.size() + size_t(count) * fieldCount * (hex ? 8 : 6) + 2);
+
+		out += '{';
+		if (perLine != 0 && count != 0)
+			out += "\n    ";
+
+		for (u32 i = 0; i < count; i++) {
+			if (i != 0) {
+				if (perLine != 0 && i % perLine == 0)
+					out += ",\n    ";
+				else
+					out += ", ";
+			}
+
+			const u8* element = data + size_t(i) * stride;
+			if (fieldCount == 1) {
+				appendValue(out, readField(element, fieldTypes[0]), fieldTypes[0], hex);
+				continue;
+			}
+
+			out += '{';
+			size_t offset = 0;
+			for (u32 f = 0; f < fieldCount; f++) {
+				u8 type = fieldTypes[f];
+				if (!packed)
+					offset = alignUp(offset, TYPE_SIZES[type]);
+				if (f != 0)
+					out += ", ";
+				appendValue(out, readField(element + offset, type), type, hex);
+				offset += TYPE_SIZES[type];
+			}
+			out += '}';
+		}
+
+		if (perLine != 0 && count != 0)
+			out += '\n';
+		out += '}';
+		return true;
+	}
+
+}
+
+} // nitro
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "common.hpp"
+
+namespace nitro {
+
+/**
+ * @brief Formatting of data tables (arrays of integers or of simple structs) as C initializers, e.g. {1, 2, 3} or
+ * {{0x1, -2}, {0x3, 4}}, written straight into one string.
+ */
+namespace table {
+	/// Field types, numbered like the DTYPES of the preprocessor
+	enum FieldType : u8 {
+		TYPE_U64, TYPE_U32, TYPE_U16, TYPE_U8,
+		TYPE_S64, TYPE_S32, TYPE_S16, TYPE_S8,
+		TYPE_COUNT
+	};
+
+	enum Flags : u32 {
+		FLAG_HEX    = 1 << 0, ///< Values in hexadecimal (0x1F, -0x1F) rather than decimal
+		FLAG_PACKED = 1 << 1, ///< Struct fields follow each other without alignment padding
+	};
+
+	/**
+	 * @brief Get the size of one element, i.e. of the struct the fields make up.
+	 *
+	 * @param fieldTypes The type of each field.
+	 * @param fieldCount The number of fields; 1 for a plain integer array.
+	 * @param packed Whether the fields are unaligned.
+	 *
+	 * @return The size of one element in bytes, or 0 if a type is invalid.
+	 */
+	size_t getStride(const u8* fieldTypes, u32 fieldCount, bool packed);
+
+	/**
+	 * @brief Format a table as a C initializer.
+	 *
+	 * @param out The string to append the initializer to.
+	 * @param data The data of the table (little-endian).
+	 * @param size The size of the data in bytes.
+	 * @param fieldTypes The type of each field.
+	 * @param fieldCount The number of fields; with 1, elements are written as plain values rather than structs.
+	 * @param count The number of elements.
+	 * @param flags A combination of Flags.
+	 * @param perLine The number of elements per line, or 0 to write them all on one line.
+	 *
+	 * @return Whether the table was formatted, i.e. the types are valid and the data holds every element.
+	 */
+	bool format(std::string& out, const u8* data, size_t size, const u8* fieldTypes, u32 fieldCount, u32 count,
+		u32 flags, u32 perLine);
+}
+
+} // nitro
@@ -0,0 +1,313 @@
+use unarm::arm;
+use unarm::thumb;
+use unarm::args::*;
+use unarm::ParseFlags;
+
+use std::slice;
+
+use crate::funcs::{thumb_call_target, FunctionInfo};
+use crate::table::{decode, DecodedIns, INS_CONDITIONAL, INS_FUNCTION_END, INS_HAS_BRANCH_DEST, INS_HAS_TARGET};
+use crate::{op, ARM7_PARSE_FLAGS, ARM9_PARSE_FLAGS, REG_LR, REG_PC};
+
+const REG_COUNT: usize = 16;
+const REG_IP: usize = 12;
+
+pub const VALUE_UNREACHED: u8 = 0;
+pub const VALUE_CONST: u8 = 1;
+pub const VALUE_UNKNOWN: u8 = 2;
+
+/// What a register holds at some point of a function: nothing yet (the point wasn't reached), the same constant on
+/// every path, or anything
+#[derive(Default, Clone, Copy, PartialEq, Eq, Debug)]
+#[repr(C)]
+pub struct RegValue {
+	pub state: u8,
+	pub value: u32,
+}
+
+impl RegValue {
+	const UNREACHED: RegValue = RegValue { state: VALUE_UNREACHED, value: 0 };
+	const UNKNOWN: RegValue = RegValue { state: VALUE_UNKNOWN, value: 0 };
+
+	fn constant(value: u32) -> Self {
+		RegValue { state: VALUE_CONST, value }
+	}
+
+	fn get(&self) -> Option<u32> {
+		(self.state == VALUE_CONST).then_some(self.value)
+	}
+
+	fn meet(self, other: RegValue) -> RegValue {
+		match (self.state, other.state) {
+			(VALUE_UNREACHED, _) => other,
+			(_, VALUE_UNREACHED) => self,
+			_ if self == other => self,
+			_ => RegValue::UNKNOWN,
+		}
+	}
+}
+
+type RegState = [RegValue; REG_COUNT];
+
+fn writes_first_reg(opcode: u16) -> bool {
+	!matches!(opcode, op::CMN | op::CMP | op::TEQ | op::TST | op::B | op::BX | op::BL | op::BLXI | op::BLXR | op::NOP
+		| op::PUSHM | op::PUSHR | op::SVC | op::SWI)
+		&& !op::is_stm(opcode)
+		&& (!op::is_str(opcode) || op::is_strex(opcode))
+}
+
+struct Ins {
+	addr: u32,
+	thumb: bool,
+	decoded: DecodedIns,
+	args: [Argument; 6],
+	call: bool, // a Thumb bl/blx pair, which unarm decodes as two halves
+}
+
+fn shift(op: Shift, value: u32, amount: u32) -> u32 {
+	match op {
+		Shift::Lsl => if amount >= 32 { 0 } else { value << amount },
+		Shift::Lsr => if amount >= 32 { 0 } else { value >> amount },
+		Shift::Asr => ((value as i32) >> amount.min(31)) as u32,
+		Shift::Ror => value.rotate_right(amount % 32),
+		_ => value,
+	}
+}
+
+/// Register values before every instruction of a function, found by propagating constants along its control flow
+pub struct Dataflow {
+	addrs: Vec<u32>,
+	states: Vec<RegState>,
+}
+
+impl Dataflow {
+	fn analyze(data: &[u8], region_addr: u32, func: &FunctionInfo, flags: &ParseFlags) -> Self {
+		let read = |addr: u32, size: u32| -> Option<u32> {
+			let i = addr.checked_sub(region_addr)? as usize;
+			let b = data.get(i..i + size as usize)?;
+			Some(b.iter().rev().fold(0, |v, &byte| (v << 8) | byte as u32))
+		};
+
+		let mut instructions = Vec::new();
+		let ins_size = if func.thumb { 2 } else { 4 };
+		let mut addr = func.start;
+		while addr < func.end {
+			if addr >= func.pool_start && addr < func.pool_end {
+				addr = func.pool_end;
+				continue;
+			}
+			let Some(code) = read(addr, ins_size) else { break };
+			let (opcode, parsed, conditional, data_op, sets_flags) = if func.thumb {
+				let ins = thumb::Ins::new(code, flags);
+				(ins.op as u16, ins.parse(flags), ins.is_conditional(), ins.is_data_operation(), ins.updates_condition_flags())
+			} else {
+				let ins = arm::Ins::new(code, flags);
+				(ins.op as u16, ins.parse(flags), ins.is_conditional(), ins.is_data_operation(), ins.updates_condition_flags())
+			};
+			let call = func.thumb && read(addr + 2, 2).and_then(|second| thumb_call_target(code, second, addr)).is_some();
+			let size = if call { 4 } else { ins_size };
+			instructions.push(Ins {
+				addr,
+				thumb: func.thumb,
+				decoded: decode(opcode, &parsed.args, code, addr, func.thumb, conditional, data_op, sets_flags),
+				args: parsed.args,
+				call,
+			});
+			addr += size;
+		}
+
+		let addrs: Vec<u32> = instructions.iter().map(|ins| ins.addr).collect();
+		let mut states = vec![[RegValue::UNREACHED; REG_COUNT]; instructions.len()];
+		if instructions.is_empty() {
+			return Dataflow { addrs, states };
+		}
+
+		// Arguments and callee-saved registers are unknown on entry
+		states[0] = [RegValue::UNKNOWN; REG_COUNT];
+		let mut worklist = vec![0usize];
+		let mut queued = vec![false; instructions.len()];
+		queued[0] = true;
+
+		while let Some(i) = worklist.pop() {
+			queued[i] = false;
+			let ins = &instructions[i];
+			let out = Self::transfer(ins, &states[i], &read);
+
+			let conditional = ins.decoded.flags & INS_CONDITIONAL != 0;
+			let mut successors = [None, None];
+			if ins.decoded.opcode == op::B && ins.decoded.flags & INS_HAS_BRANCH_DEST != 0 {
+				successors[0] = addrs.binary_search(&ins.decoded.branch_dest).ok();
+				if conditional {
+					successors[1] = Some(i + 1);
+				}
+			} else if ins.decoded.flags & INS_FUNCTION_END == 0 || conditional {
+				successors[0] = Some(i + 1);
+			}
+
+			for next in successors.into_iter().flatten().filter(|&n| n < instructions.len()) {
+				let mut changed = false;
+				for (current, new) in states[next].iter_mut().zip(out.iter()) {
+					let met = current.meet(*new);
+					changed |= met != *current;
+					*current = met;
+				}
+				if changed && !queued[next] {
+					queued[next] = true;
+					worklist.push(next);
+				}
+			}
+		}
+
+		Dataflow { addrs, states }
+	}
+
+	/// The registers after an instruction, given those before it
+	fn transfer(ins: &Ins, before: &RegState, read: &dyn Fn(u32, u32) -> Option<u32>) -> RegState {
+		let mut after = *before;
+		let opcode = ins.decoded.opcode;
+		let pc = if ins.thumb { (ins.addr + 4) & !3 } else { ins.addr + 8 };
+
+		let reg_value = |reg: Register| -> RegValue {
+			match reg as usize {
+				r if r == REG_PC as usize => RegValue::constant(pc),
+				r if r < REG_COUNT => before[r],
+				_ => RegValue::UNKNOWN,
+			}
+		};
+		// The value of a flexible second operand starting at args[i]: an immediate, or a register shifted or not
+		let operand = |i: usize| -> Option<u32> {
+			match ins.args.get(i)? {
+				Argument::UImm(v) => Some(*v),
+				Argument::SImm(v) => Some(*v as u32),
+				Argument::Reg(r) if !r.deref => {
+					let value = reg_value(r.reg).get()?;
+					match ins.args.get(i + 1) {
+						Some(Argument::ShiftImm(s)) => Some(shift(s.op, value, s.imm)),
+						Some(Argument::ShiftReg(s)) => Some(shift(s.op, value, reg_value(s.reg).get()? & 0xFF)),
+						_ => Some(value),
+					}
+				}
+				_ => None,
+			}
+		};
+		let dest = match ins.args[0] {
+			Argument::Reg(r) if !r.deref && (r.reg as usize) < REG_COUNT => Some(r.reg as usize),
+			_ => None,
+		};
+		// Two-operand Thumb forms (e.g. adds r0, #1) use the destination as the first source
+		let two_operand = matches!(ins.args[2], Argument::None);
+		let (lhs, rhs) = if two_operand {
+			(dest.map_or(RegValue::UNKNOWN, |d| before[d]).get(), operand(1))
+		} else {
+			(match ins.args[1] { Argument::Reg(r) => reg_value(r.reg).get(), _ => None }, operand(2))
+		};
+
+		let result: Option<u32> = match opcode {
+			_ if op::is_mov(opcode) => operand(1),
+			op::MVN => operand(1).map(|v| !v),
+			op::ADD => lhs.zip(rhs).map(|(a, b)| a.wrapping_add(b)),
+			op::SUB => lhs.zip(rhs).map(|(a, b)| a.wrapping_sub(b)),
+			op::RSB => lhs.zip(rhs).map(|(a, b)| b.wrapping_sub(a)),
+			op::AND => lhs.zip(rhs).map(|(a, b)| a & b),
+			op::ORR => lhs.zip(rhs).map(|(a, b)| a | b),
+			op::EOR => lhs.zip(rhs).map(|(a, b)| a ^ b),
+			op::BIC => lhs.zip(rhs).map(|(a, b)| a & !b),
+			op::MUL => lhs.zip(rhs).map(|(a, b)| a.wrapping_mul(b)),
+			op::LSL | op::LSR | op::ASR | op::ROR => {
+				let kind = match opcode { op::LSL => Shift::Lsl, op::LSR => Shift::Lsr, op::ASR => Shift::Asr, _ => Shift::Ror };
+				let amount = if two_operand { operand(1) } else { operand(2) };
+				lhs.zip(amount).map(|(v, n)| shift(kind, v, n & 0xFF))
+			}
+			// Only literal pools are taken to be constant; other memory may change at runtime
+			op::LDR if ins.decoded.flags & INS_HAS_TARGET != 0 => read(ins.decoded.target_addr, 4),
+			_ => None,
+		};
+
+		let conditional = ins.decoded.flags & INS_CONDITIONAL != 0;
+		let mut set = |reg: usize, value: RegValue| {
+			if reg < REG_COUNT {
+				after[reg] = if conditional { before[reg].meet(value) } else { value };
+			}
+		};
+
+		if ins.call || matches!(opcode, op::BL | op::BLXI | op::BLXR | op::SVC | op::SWI) {
+			for reg in [0, 1, 2, 3, REG_IP, REG_LR as usize] {
+				set(reg, RegValue::UNKNOWN);
+			}
+			return after;
+		}
+
+		if let Some(d) = dest.filter(|_| writes_first_reg(opcode)) {
+			set(d, result.map_or(RegValue::UNKNOWN, RegValue::constant));
+		}
+		if matches!(opcode, op::UMULL | op::SMULL | op::UMLAL | op::SMLAL) {
+			if let Argument::Reg(r) = ins.args[1] {
+				set(r.reg as usize, RegValue::UNKNOWN);
+			}
+		}
+		if opcode == op::LDRD {
+			if let Some(d) = dest {
+				set(d + 1, RegValue::UNKNOWN);
+			}
+		}
+
+		// Registers loaded by ldm/pop, and bases written back
+		for arg in &ins.args {
+			match arg {
+				Argument::RegList(list) if op::is_ldm(opcode) || op::is_pop(opcode) => {
+					for reg in (0..REG_COUNT).filter(|r| list.regs & (1 << r) != 0) {
+						set(reg, RegValue::UNKNOWN);
+					}
+				}
+				Argument::Reg(r) if r.writeback => set(r.reg as usize, RegValue::UNKNOWN),
+				_ => {}
+			}
+		}
+		let post_indexed = ins.args.iter().any(|arg| match arg {
+			Argument::OffsetImm(o) => o.post_indexed,
+			Argument::OffsetReg(o) => o.post_indexed,
+			_ => false,
+		});
+		if post_indexed {
+			if let Some(Argument::Reg(base)) = ins.args.iter().find(|arg| matches!(arg, Argument::Reg(r) if r.deref)) {
+				set(base.reg as usize, RegValue::UNKNOWN);
+			}
+		}
+
+		after
+	}
+
+	fn index_of(&self, addr: u32) -> Option<usize> {
+		self.addrs.binary_search(&(addr & !1)).ok()
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn dataflow_analyze(data: *const u8, data_size: u32, addr: u32, func: *const FunctionInfo, arm7: bool) -> *mut Dataflow {
+	assert!(!data.is_null() && !func.is_null());
+	let data = unsafe { slice::from_raw_parts(data, data_size as usize) };
+	let flags = if arm7 { ARM7_PARSE_FLAGS } else { ARM9_PARSE_FLAGS };
+	Box::into_raw(Box::new(Dataflow::analyze(data, addr, unsafe { &*func }, &flags)))
+}
+
+/// Writes the value of each register (r0 to pc) before the instruction at addr; false if addr isn't one
+#[no_mangle]
+pub extern "C" fn dataflow_get_regs(dataflow: *const Dataflow, addr: u32, out: *mut RegValue) -> bool {
+	let dataflow = unsafe { &*dataflow };
+	match dataflow.index_of(addr) {
+		Some(index) => {
+			unsafe { slice::from_raw_parts_mut(out, REG_COUNT).copy_from_slice(&dataflow.states[index]); }
+			true
+		}
+		None => false,
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn free_dataflow(dataflow: *mut Dataflow) {
+	unsafe {
+		if !dataflow.is_null() {
+			drop(Box::from_raw(dataflow));
+		}
+	}
+}
@@ -0,0 +1,883 @@
+use std::ffi::{c_char, CStr};
+use std::rc::Rc;
+use std::slice;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::thread;
+
+/// Deeply nested names are never legitimate, so give up on them rather than overflow the stack
+const MAX_DEPTH: u32 = 256;
+
+/// Symbols handed to each worker at once
+const CHUNK_SIZE: usize = 1024;
+
+#[derive(Debug)]
+enum Node {
+	Name(String),
+	/// Names with a separate short form, kept compatible with the names the old Ruby demangler produced
+	/// (e.g. "C1" for constructors and "==" for operator==)
+	Alt { full: String, short: String },
+	Nested(Vec<Rc<Node>>),
+	Template(Rc<Node>, Vec<Rc<Node>>),
+	Qualified(Rc<Node>, String),
+	Pointer(Rc<Node>),
+	LRef(Rc<Node>),
+	RRef(Rc<Node>),
+	Function { ret: Option<Rc<Node>>, params: Vec<Rc<Node>>, quals: String },
+	Array(Rc<Node>, String),
+	PtrMem(Rc<Node>, Rc<Node>),
+	PackExpansion(Rc<Node>),
+	Special { prefix: &'static str, suffix: &'static str, inner: Rc<Node> },
+	Encoding { name: Rc<Node>, ret: Option<Rc<Node>>, params: Vec<Rc<Node>>, quals: String },
+	Local(Rc<Node>, Rc<Node>),
+	Clone(Rc<Node>, String),
+}
+
+fn join(nodes: &[Rc<Node>]) -> String {
+	nodes.iter().map(|n| render(n)).collect::<Vec<_>>().join(", ")
+}
+
+fn render_params(params: &[Rc<Node>]) -> String {
+	match params {
+		[p] if matches!(&**p, Node::Name(n) if n == "void") => String::new(),
+		_ => join(params),
+	}
+}
+
+fn render(node: &Node) -> String {
+	declare(node, String::new())
+}
+
+/// Renders a type around a declarator, C style, so pointers to functions and arrays come out as "void (*)(int)"
+fn declare(node: &Node, decl: String) -> String {
+	match node {
+		Node::Pointer(t) => wrap_declarator(t, format!("*{decl}")),
+		Node::LRef(t) => wrap_declarator(t, format!("&{decl}")),
+		Node::RRef(t) => wrap_declarator(t, format!("&&{decl}")),
+		Node::Qualified(t, quals) => match &**t {
+			Node::Function { ret, params, quals: fn_quals } => {
+				render_function(ret, params, &format!("{fn_quals}{quals}"), &decl)
+			}
+			_ => declare(t, format!("{quals}{decl}")),
+		},
+		Node::Function { ret, params, quals } => render_function(ret, params, quals, &decl),
+		Node::Array(t, dim) => {
+			let sep = if decl.is_empty() { "" } else { " " };
+			format!("{} {decl}{sep}[{dim}]", render(t))
+		}
+		Node::PtrMem(class, member) => match &**member {
+			Node::Function { .. } => declare(member, format!("({}::*{decl})", render(class))),
+			_ => format!("{} {}::*{decl}", render(member), render(class)),
+		},
+		_ => format!("{}{decl}", render_name(node, false)),
+	}
+}
+
+fn wrap_declarator(inner: &Node, decl: String) -> String {
+	match inner {
+		Node::Function { .. } | Node::Array(..) => declare(inner, format!("({decl})")),
+		_ => declare(inner, decl),
+	}
+}
+
+fn render_function(ret: &Option<Rc<Node>>, params: &[Rc<Node>], quals: &str, decl: &str) -> String {
+	let ret = ret.as_ref().map(|r| render(r)).unwrap_or_default();
+	format!("{ret} {decl}({}){quals}", render_params(params))
+}
+
+/// Renders names (and anything else that isn't a declarator), optionally in the short form used as lookup keys
+fn render_name(node: &Node, short: bool) -> String {
+	match node {
+		Node::Name(name) => name.clone(),
+		Node::Alt { full, short: s } => if short { s.clone() } else { full.clone() },
+		Node::Nested(parts) => parts.iter().map(|p| render_name(p, short)).collect::<Vec<_>>().join("::"),
+		Node::Template(name, args) => {
+			let args = join(args);
+			let space = if args.ends_with('>') { " " } else { "" };
+			format!("{}<{args}{space}>", render_name(name, short))
+		}
+		Node::PackExpansion(t) => render(t), // packs are substituted with their expanded arguments
+		Node::Special { prefix, suffix, inner } => {
+			if short && !suffix.is_empty() {
+				format!("{}{suffix}", render_name(inner, true))
+			} else {
+				format!("{prefix}{}", render_name(inner, false))
+			}
+		}
+		Node::Encoding { name, ret, params, quals } => {
+			if short {
+				return render_name(name, true);
+			}
+			let ret = ret.as_ref().map(|r| format!("{} ", render(r))).unwrap_or_default();
+			format!("{ret}{}({}){quals}", render_name(name, false), render_params(params))
+		}
+		Node::Local(encoding, entity) => {
+			// the enclosing function is written without its return type
+			let encoding = match &**encoding {
+				Node::Encoding { name, params, quals, .. } if !short => {
+					format!("{}({}){quals}", render_name(name, false), render_params(params))
+				}
+				_ => render_name(encoding, short),
+			};
+			format!("{encoding}::{}", render_name(entity, short))
+		}
+		Node::Clone(inner, suffix) => {
+			if short { render_name(inner, true) } else { format!("{} [clone {suffix}]", render_name(inner, false)) }
+		}
+		_ => render(node),
+	}
+}
+
+fn is_ctor_dtor_or_conversion(node: &Node) -> bool {
+	match node {
+		Node::Alt { full, short } => short.starts_with('C') || short.starts_with('D') || full.starts_with("operator ") && short == full,
+		Node::Nested(parts) => parts.last().is_some_and(|p| is_ctor_dtor_or_conversion(p)),
+		Node::Template(name, _) => is_ctor_dtor_or_conversion(name),
+		_ => false,
+	}
+}
+
+/// The unqualified name a constructor or destructor is named after
+fn last_source_name(node: &Node) -> Option<String> {
+	match node {
+		Node::Name(name) => Some(name.clone()),
+		Node::Alt { full, .. } => Some(full.clone()),
+		Node::Nested(parts) => parts.last().and_then(|p| last_source_name(p)),
+		Node::Template(name, _) => last_source_name(name),
+		_ => None,
+	}
+}
+
+const OPERATORS: &[(&str, &str, &str)] = &[
+	("nw", "operator new", "new"), ("na", "operator new[]", "new[]"),
+	("dl", "operator delete", "delete"), ("da", "operator delete[]", "delete[]"),
+	("eq", "operator==", "=="), ("ne", "operator!=", "!="),
+	("ps", "operator+", ""), ("ng", "operator-", ""), ("ad", "operator&", ""), ("de", "operator*", ""),
+	("co", "operator~", ""), ("pl", "operator+", ""), ("mi", "operator-", ""), ("ml", "operator*", ""),
+	("dv", "operator/", ""), ("rm", "operator%", ""), ("an", "operator&", ""), ("or", "operator|", ""),
+	("eo", "operator^", ""), ("aS", "operator=", ""), ("pL", "operator+=", ""), ("mI", "operator-=", ""),
+	("mL", "operator*=", ""), ("dV", "operator/=", ""), ("rM", "operator%=", ""), ("aN", "operator&=", ""),
+	("oR", "operator|=", ""), ("eO", "operator^=", ""), ("ls", "operator<<", ""), ("rs", "operator>>", ""),
+	("lS", "operator<<=", ""), ("rS", "operator>>=", ""), ("lt", "operator<", ""), ("gt", "operator>", ""),
+	("le", "operator<=", ""), ("ge", "operator>=", ""), ("ss", "operator<=>", ""), ("nt", "operator!", ""),
+	("aa", "operator&&", ""), ("oo", "operator||", ""), ("pp", "operator++", ""), ("mm", "operator--", ""),
+	("cm", "operator,", ""), ("pm", "operator->*", ""), ("pt", "operator->", ""), ("cl", "operator()", ""),
+	("ix", "operator[]", ""), ("qu", "operator?", ""),
+];
+
+const BUILTIN_TYPES: &[(u8, &str)] = &[
+	(b'v', "void"), (b'w', "wchar_t"), (b'b', "bool"), (b'c', "char"), (b'a', "signed char"),
+	(b'h', "unsigned char"), (b's', "short"), (b't', "unsigned short"), (b'i', "int"), (b'j', "unsigned int"),
+	(b'l', "long"), (b'm', "unsigned long"), (b'x', "long long"), (b'y', "unsigned long long"),
+	(b'n', "__int128"), (b'o', "unsigned __int128"), (b'f', "float"), (b'd', "double"), (b'e', "long double"),
+	(b'g', "__float128"), (b'z', "..."),
+];
+
+struct Parser<'a> {
+	s: &'a [u8],
+	pos: usize,
+	depth: u32,
+	type_depth: u32,
+	subs: Vec<Rc<Node>>,
+	template_args: Vec<Rc<Node>>, // arguments T_ refers to, from the last template in the encoded name
+}
+
+impl<'a> Parser<'a> {
+	fn peek(&self) -> Option<u8> {
+		self.s.get(self.pos).copied()
+	}
+
+	fn peek_at(&self, offset: usize) -> Option<u8> {
+		self.s.get(self.pos + offset).copied()
+	}
+
+	fn eat(&mut self, c: u8) -> bool {
+		if self.peek() == Some(c) {
+			self.pos += 1;
+			true
+		} else {
+			false
+		}
+	}
+
+	fn eat_str(&mut self, s: &str) -> bool {
+		if self.s[self.pos..].starts_with(s.as_bytes()) {
+			self.pos += s.len();
+			true
+		} else {
+			false
+		}
+	}
+
+	fn expect(&mut self, c: u8) -> Option<()> {
+		self.eat(c).then_some(())
+	}
+
+	fn enter(&mut self) -> Option<()> {
+		self.depth += 1;
+		(self.depth < MAX_DEPTH).then_some(())
+	}
+
+	fn leave(&mut self) {
+		self.depth -= 1;
+	}
+
+	fn number(&mut self) -> Option<i64> {
+		let negative = self.eat(b'n');
+		let start = self.pos;
+		while self.peek().is_some_and(|c| c.is_ascii_digit()) {
+			self.pos += 1;
+		}
+		if start == self.pos {
+			return None;
+		}
+		let n: i64 = std::str::from_utf8(&self.s[start..self.pos]).ok()?.parse().ok()?;
+		Some(if negative { -n } else { n })
+	}
+
+	/// <seq-id> _, where S_ is 0 and S<seq-id>_ is seq-id + 1
+	fn seq_id(&mut self) -> Option<usize> {
+		if self.eat(b'_') {
+			return Some(0);
+		}
+		let mut id = 0usize;
+		loop {
+			let c = self.peek()?;
+			self.pos += 1;
+			match c {
+				b'0'..=b'9' => id = id * 36 + (c - b'0') as usize,
+				b'A'..=b'Z' => id = id * 36 + (c - b'A') as usize + 10,
+				b'_' => return Some(id + 1),
+				_ => return None,
+			}
+		}
+	}
+
+	fn add_sub(&mut self, node: &Rc<Node>) {
+		self.subs.push(node.clone());
+	}
+
+	fn encoding(&mut self) -> Option<Rc<Node>> {
+		self.enter()?;
+		let result = self.encoding_inner();
+		self.leave();
+		result
+	}
+
+	fn encoding_inner(&mut self) -> Option<Rc<Node>> {
+		if matches!(self.peek(), Some(b'T') | Some(b'G')) {
+			return self.special_name();
+		}
+
+		let name = self.name()?;
+		if self.pos >= self.s.len() || matches!(self.peek(), Some(b'E') | Some(b'.')) {
+			return Some(name);
+		}
+
+		let (name, quals) = split_quals(name);
+
+		// template functions other than constructors, destructors and conversions encode their return type
+		let ret = if ends_in_template(&name) && !is_ctor_dtor_or_conversion(&name) {
+			Some(self.type_()?)
+		} else {
+			None
+		};
+
+		let mut params = Vec::new();
+		while self.pos < self.s.len() && !matches!(self.peek(), Some(b'E') | Some(b'.')) {
+			params.push(self.type_()?);
+		}
+		if params.is_empty() {
+			return None;
+		}
+
+		Some(Rc::new(Node::Encoding { name, ret, params, quals }))
+	}
+
+	fn special_name(&mut self) -> Option<Rc<Node>> {
+		let (prefix, suffix, is_type) = if self.eat_str("TV") {
+			("vtable for ", "::vtable", true)
+		} else if self.eat_str("TT") {
+			("VTT for ", "", true)
+		} else if self.eat_str("TI") {
+			("typeinfo for ", "", true)
+		} else if self.eat_str("TS") {
+			("typeinfo name for ", "", true)
+		} else if self.eat_str("GV") {
+			("guard variable for ", "", false)
+		} else if self.eat_str("GR") {
+			let name = self.name()?;
+			while self.peek().is_some_and(|c| c != b'_') {
+				self.pos += 1;
+			}
+			self.eat(b'_');
+			return Some(Rc::new(Node::Special { prefix: "reference temporary for ", suffix: "", inner: name }));
+		} else if self.eat_str("GTt") {
+			let inner = self.encoding()?;
+			return Some(Rc::new(Node::Special { prefix: "transaction clone for ", suffix: "", inner }));
+		} else if self.eat_str("GTn") {
+			let inner = self.encoding()?;
+			return Some(Rc::new(Node::Special { prefix: "non-transaction clone for ", suffix: "", inner }));
+		} else if self.eat_str("Th") {
+			self.number()?;
+			self.expect(b'_')?;
+			let inner = self.encoding()?;
+			return Some(Rc::new(Node::Special { prefix: "non-virtual thunk to ", suffix: "", inner }));
+		} else if self.eat_str("Tv") {
+			self.number()?;
+			self.expect(b'_')?;
+			self.number()?;
+			self.expect(b'_')?;
+			let inner = self.encoding()?;
+			return Some(Rc::new(Node::Special { prefix: "virtual thunk to ", suffix: "", inner }));
+		} else if self.eat_str("Tc") {
+			for _ in 0..2 {
+				if self.eat(b'h') {
+					self.number()?;
+					self.expect(b'_')?;
+				} else {
+					self.expect(b'v')?;
+					self.number()?;
+					self.expect(b'_')?;
+					self.number()?;
+					self.expect(b'_')?;
+				}
+			}
+			let inner = self.encoding()?;
+			return Some(Rc::new(Node::Special { prefix: "covariant return thunk to ", suffix: "", inner }));
+		} else {
+			return None;
+		};
+
+		let inner = if is_type { self.type_()? } else { self.name()? };
+		Some(Rc::new(Node::Special { prefix, suffix, inner }))
+	}
+
+	fn name(&mut self) -> Option<Rc<Node>> {
+		self.enter()?;
+		let result = self.name_inner();
+		self.leave();
+		result
+	}
+
+	fn name_inner(&mut self) -> Option<Rc<Node>> {
+		match self.peek()? {
+			b'N' => self.nested_name(),
+			b'Z' => self.local_name(),
+			b'S' if self.peek_at(1) != Some(b't') => {
+				let sub = self.substitution(false)?;
+				if self.peek() == Some(b'I') {
+					let args = self.template_args(true)?;
+					return Some(Rc::new(Node::Template(sub, args)));
+				}
+				Some(sub)
+			}
+			_ => {
+				let is_std = self.eat_str("St");
+				let mut name = self.unqualified_name(None)?;
+				if is_std {
+					name = Rc::new(Node::Nested(vec![Rc::new(Node::Name("std".into())), name]));
+				}
+				if self.peek() == Some(b'I') {
+					self.add_sub(&name);
+					let args = self.template_args(true)?;
+					name = Rc::new(Node::Template(name, args));
+				}
+				Some(name)
+			}
+		}
+	}
+
+	fn nested_name(&mut self) -> Option<Rc<Node>> {
+		self.expect(b'N')?;
+
+		let mut quals = String::new();
+		if self.eat(b'r') { quals.push_str(" restrict"); }
+		if self.eat(b'V') { quals.push_str(" volatile"); }
+		if self.eat(b'K') { quals.push_str(" const"); }
+		if self.eat(b'R') { quals.push_str(" &"); } else if self.eat(b'O') { quals.push_str(" &&"); }
+
+		let mut parts: Vec<Rc<Node>> = Vec::new();
+		while !self.eat(b'E') {
+			match self.peek()? {
+				b'S' if self.peek_at(1) == Some(b't') => {
+					self.pos += 2;
+					parts.push(Rc::new(Node::Name("std".into())));
+					continue;
+				}
+				b'S' => {
+					let sub = self.substitution(true)?;
+					parts = match &*sub {
+						Node::Nested(p) => p.clone(),
+						_ => vec![sub],
+					};
+					continue; // already a substitution, so it isn't added again
+				}
+				b'I' => {
+					let args = self.template_args(true)?;
+					let name = parts.pop()?;
+					parts.push(Rc::new(Node::Template(name, args)));
+				}
+				b'T' => parts.push(self.template_param()?),
+				_ => {
+					let class = parts.last().and_then(|p| last_source_name(p));
+					parts.push(self.unqualified_name(class)?);
+				}
+			}
+
+			// Every prefix is a substitution candidate, including a template's name ahead of its arguments. The
+			// complete name isn't a prefix; types add it themselves
+			if self.peek() != Some(b'E') {
+				let node = parts_node(&parts)?;
+				self.add_sub(&node);
+			}
+		}
+
+		let node = parts_node(&parts)?;
+		Some(if quals.is_empty() { node } else { Rc::new(Node::Qualified(node, quals)) })
+	}
+
+	fn local_name(&mut self) -> Option<Rc<Node>> {
+		self.expect(b'Z')?;
+		let encoding = self.encoding()?;
+		self.expect(b'E')?;
+		let entity = if self.eat(b's') {
+			Rc::new(Node::Name("string literal".into()))
+		} else {
+			self.name()?
+		};
+		if self.eat(b'_') {
+			if self.eat(b'_') {
+				self.number()?;
+				self.expect(b'_')?;
+			} else {
+				self.number()?;
+			}
+		}
+		Some(Rc::new(Node::Local(encoding, entity)))
+	}
+
+	fn unqualified_name(&mut self, class: Option<String>) -> Option<Rc<Node>> {
+		let c = self.peek()?;
+		match c {
+			b'0'..=b'9' => self.source_name(),
+			b'C' => {
+				self.pos += 1;
+				let inheriting = self.eat(b'I');
+				let kind = self.peek()?;
+				if !(b'1'..=b'5').contains(&kind) {
+					return None;
+				}
+				self.pos += 1;
+				if inheriting {
+					self.type_()?;
+				}
+				let class = class?;
+				Some(Rc::new(Node::Alt { full: class, short: format!("C{}", kind as char) }))
+			}
+			b'D' if matches!(self.peek_at(1), Some(b'0'..=b'5')) => {
+				let kind = self.peek_at(1)?;
+				self.pos += 2;
+				let class = class?;
+				Some(Rc::new(Node::Alt { full: format!("~{class}"), short: format!("D{}", kind as char) }))
+			}
+			b'U' if self.peek_at(1) == Some(b't') => {
+				self.pos += 2;
+				let n = if self.peek() == Some(b'_') { 1 } else { self.number()? + 2 };
+				self.expect(b'_')?;
+				Some(Rc::new(Node::Name(format!("{{unnamed type#{n}}}"))))
+			}
+			b'U' if self.peek_at(1) == Some(b'l') => {
+				self.pos += 2;
+				let mut params = Vec::new();
+				while !self.eat(b'E') {
+					params.push(self.type_()?);
+				}
+				let n = if self.peek() == Some(b'_') { 1 } else { self.number()? + 2 };
+				self.expect(b'_')?;
+				Some(Rc::new(Node::Name(format!("{{lambda({})#{n}}}", render_params(&params)))))
+			}
+			b'L' => {
+				self.pos += 1; // internal linkage
+				self.unqualified_name(class)
+			}
+			_ => self.operator_name(),
+		}
+	}
+
+	fn source_name(&mut self) -> Option<Rc<Node>> {
+		let len = self.number()? as usize;
+		let end = self.pos.checked_add(len)?;
+		let bytes = self.s.get(self.pos..end)?;
+		self.pos = end;
+		let name = std::str::from_utf8(bytes).ok()?;
+		let name = if name.starts_with("_GLOBAL__N") { "(anonymous namespace)".to_string() } else { name.to_string() };
+		let mut node = Rc::new(Node::Name(name));
+		while self.eat(b'B') {
+			let tag = self.source_name()?;
+			node = Rc::new(Node::Name(format!("{}[abi:{}]", render(&node), render(&tag))));
+		}
+		Some(node)
+	}
+
+	fn operator_name(&mut self) -> Option<Rc<Node>> {
+		let code = self.s.get(self.pos..self.pos + 2)?;
+		if code == b"cv" {
+			self.pos += 2;
+			let ty = self.type_()?;
+			let name = format!("operator {}", render(&ty));
+			return Some(Rc::new(Node::Alt { full: name.clone(), short: name }));
+		}
+		if code == b"li" {
+			self.pos += 2;
+			let suffix = self.source_name()?;
+			return Some(Rc::new(Node::Name(format!("operator\"\" {}", render(&suffix)))));
+		}
+		if code[0] == b'v' && code[1].is_ascii_digit() {
+			self.pos += 2;
+			let name = self.source_name()?;
+			return Some(Rc::new(Node::Name(format!("operator {}", render(&name)))));
+		}
+		let (_, full, short) = OPERATORS.iter().find(|(c, _, _)| c.as_bytes() == code)?;
+		self.pos += 2;
+		let short = if short.is_empty() { full } else { short };
+		Some(Rc::new(Node::Alt { full: full.to_string(), short: short.to_string() }))
+	}
+
+	/// Standard abbreviations used as the prefix of a nested name expand to the full template they stand for
+	fn substitution(&mut self, expand: bool) -> Option<Rc<Node>> {
+		self.expect(b'S')?;
+		let std_name = |name: &str| Rc::new(Node::Nested(vec![Rc::new(Node::Name("std".into())), Rc::new(Node::Name(name.into()))]));
+		let std_template = |name: &str, args: &[&str]| Rc::new(Node::Nested(vec![
+			Rc::new(Node::Name("std".into())),
+			Rc::new(Node::Template(Rc::new(Node::Name(name.into())), args.iter().map(|a| Rc::new(Node::Name(a.to_string()))).collect())),
+		]));
+		let node = match self.peek()? {
+			b'a' => std_name("allocator"),
+			b'b' => std_name("basic_string"),
+			b's' if expand => std_template("basic_string", &["char", "std::char_traits<char>", "std::allocator<char>"]),
+			b'i' if expand => std_template("basic_istream", &["char", "std::char_traits<char>"]),
+			b'o' if expand => std_template("basic_ostream", &["char", "std::char_traits<char>"]),
+			b'd' if expand => std_template("basic_iostream", &["char", "std::char_traits<char>"]),
+			b's' => std_name("string"),
+			b'i' => std_name("istream"),
+			b'o' => std_name("ostream"),
+			b'd' => std_name("iostream"),
+			_ => {
+				let id = self.seq_id()?;
+				return self.subs.get(id).cloned();
+			}
+		};
+		self.pos += 1;
+		Some(node)
+	}
+
+	fn template_param(&mut self) -> Option<Rc<Node>> {
+		self.expect(b'T')?;
+		let id = self.seq_id()?;
+		Some(self.template_args.get(id).cloned().unwrap_or_else(|| Rc::new(Node::Name(format!("T{id}")))))
+	}
+
+	fn template_args(&mut self, record: bool) -> Option<Vec<Rc<Node>>> {
+		self.expect(b'I')?;
+		let mut args = Vec::new();
+		while !self.eat(b'E') {
+			args.push(self.template_arg()?);
+		}
+		if record && self.type_depth == 0 {
+			self.template_args = args.clone();
+		}
+		Some(args)
+	}
+
+	fn template_arg(&mut self) -> Option<Rc<Node>> {
+		self.enter()?;
+		let result = match self.peek()? {
+			b'L' => self.literal(),
+			b'X' => None, // expressions aren't supported
+			b'J' => {
+				self.pos += 1;
+				let mut args = Vec::new();
+				while !self.eat(b'E') {
+					args.push(self.template_arg()?);
+				}
+				Some(Rc::new(Node::Name(join(&args))))
+			}
+			_ => self.type_(),
+		};
+		self.leave();
+		result
+	}
+
+	fn literal(&mut self) -> Option<Rc<Node>> {
+		self.expect(b'L')?;
+		if self.eat_str("_Z") {
+			let encoding = self.encoding()?;
+			self.expect(b'E')?;
+			return Some(encoding);
+		}
+		let ty = self.type_()?;
+		let negative = self.eat(b'n');
+		let start = self.pos;
+		while self.peek().is_some_and(|c| c != b'E') {
+			self.pos += 1;
+		}
+		let value = std::str::from_utf8(&self.s[start..self.pos]).ok()?.to_string();
+		self.expect(b'E')?;
+		let sign = if negative { "-" } else { "" };
+		let text = match render(&ty).as_str() {
+			"bool" => (if value == "0" { "false" } else { "true" }).to_string(),
+			"int" => format!("{sign}{value}"),
+			"unsigned int" => format!("{sign}{value}u"),
+			"long" => format!("{sign}{value}l"),
+			"unsigned long" => format!("{sign}{value}ul"),
+			"long long" => format!("{sign}{value}ll"),
+			"unsigned long long" => format!("{sign}{value}ull"),
+			other => format!("({other}){sign}{value}"),
+		};
+		Some(Rc::new(Node::Name(text)))
+	}
+
+	fn type_(&mut self) -> Option<Rc<Node>> {
+		self.enter()?;
+		self.type_depth += 1;
+		let result = self.type_inner();
+		self.type_depth -= 1;
+		self.leave();
+		result
+	}
+
+	fn type_inner(&mut self) -> Option<Rc<Node>> {
+		let c = self.peek()?;
+
+		if let Some((_, name)) = BUILTIN_TYPES.iter().find(|(b, _)| *b == c) {
+			self.pos += 1;
+			return Some(Rc::new(Node::Name(name.to_string())));
+		}
+
+		let node = match c {
+			b'r' | b'V' | b'K' => {
+				let mut quals = String::new();
+				if self.eat(b'r') { quals.push_str(" restrict"); }
+				if self.eat(b'V') { quals.push_str(" volatile"); }
+				if self.eat(b'K') { quals.push_str(" const"); }
+				let inner = self.type_()?;
+				Rc::new(Node::Qualified(inner, quals))
+			}
+			b'P' => { self.pos += 1; Rc::new(Node::Pointer(self.type_()?)) }
+			b'R' => { self.pos += 1; Rc::new(Node::LRef(self.type_()?)) }
+			b'O' => { self.pos += 1; Rc::new(Node::RRef(self.type_()?)) }
+			b'C' => { self.pos += 1; Rc::new(Node::Qualified(self.type_()?, " _Complex".into())) }
+			b'G' => { self.pos += 1; Rc::new(Node::Qualified(self.type_()?, " _Imaginary".into())) }
+			b'F' => {
+				self.pos += 1;
+				self.eat(b'Y');
+				let ret = self.type_()?;
+				let mut params = Vec::new();
+				let mut quals = String::new();
+				loop {
+					if self.eat(b'E') {
+						break;
+					}
+					if self.peek() == Some(b'R') && self.peek_at(1) == Some(b'E') {
+						self.pos += 2;
+						quals.push_str(" &");
+						break;
+					}
+					if self.peek() == Some(b'O') && self.peek_at(1) == Some(b'E') {
+						self.pos += 2;
+						quals.push_str(" &&");
+						break;
+					}
+					params.push(self.type_()?);
+				}
+				Rc::new(Node::Function { ret: Some(ret), params, quals })
+			}
+			b'A' => {
+				self.pos += 1;
+				let dim = if self.peek() == Some(b'_') {
+					String::new()
+				} else {
+					self.number()?.to_string()
+				};
+				self.expect(b'_')?;
+				Rc::new(Node::Array(self.type_()?, dim))
+			}
+			b'M' => {
+				self.pos += 1;
+				let class = self.type_()?;
+				let mut member = self.type_()?;
+				// cv-qualified member function types put the qualifiers on the function
+				if let Node::Qualified(inner, quals) = &*member {
+					if let Node::Function { ret, params, quals: fn_quals } = &**inner {
+						member = Rc::new(Node::Function { ret: ret.clone(), params: params.clone(), quals: format!("{fn_quals}{quals}") });
+					}
+				}
+				Rc::new(Node::PtrMem(class, member))
+			}
+			b'T' => {
+				let param = self.template_param()?;
+				self.add_sub(&param);
+				if self.peek() == Some(b'I') {
+					let args = self.template_args(false)?;
+					Rc::new(Node::Template(param, args))
+				} else {
+					return Some(param);
+				}
+			}
+			b'S' if self.peek_at(1) != Some(b't') => {
+				let sub = self.substitution(false)?;
+				if self.peek() == Some(b'I') {
+					let args = self.template_args(false)?;
+					Rc::new(Node::Template(sub, args))
+				} else {
+					return Some(sub);
+				}
+			}
+			b'D' => {
+				let code = self.peek_at(1)?;
+				self.pos += 2;
+				let name = match code {
+					b'n' => "decltype(nullptr)",
+					b'd' => "decimal64",
+					b'e' => "decimal128",
+					b'f' => "decimal32",
+					b'h' => "half",
+					b'i' => "char32_t",
+					b's' => "char16_t",
+					b'u' => "char8_t",
+					b'a' => "auto",
+					b'c' => "decltype(auto)",
+					b'p' => {
+						let inner = self.type_()?;
+						let node = Rc::new(Node::PackExpansion(inner));
+						self.add_sub(&node);
+						return Some(node);
+					}
+					_ => return None,
+				};
+				return Some(Rc::new(Node::Name(name.into())));
+			}
+			b'u' => {
+				self.pos += 1;
+				self.source_name()?
+			}
+			_ => self.name()?, // class or enum type
+		};
+
+		self.add_sub(&node);
+		Some(node)
+	}
+}
+
+/// Const member functions come out of the nested name as qualified names, so move the qualifiers to the function
+fn split_quals(name: Rc<Node>) -> (Rc<Node>, String) {
+	match &*name {
+		Node::Qualified(inner, quals) => (inner.clone(), quals.clone()),
+		Node::Local(encoding, entity) => match &**entity {
+			Node::Qualified(inner, quals) => (Rc::new(Node::Local(encoding.clone(), inner.clone())), quals.clone()),
+			_ => (name, String::new()),
+		},
+		_ => (name, String::new()),
+	}
+}
+
+fn parts_node(parts: &[Rc<Node>]) -> Option<Rc<Node>> {
+	match parts {
+		[] => None,
+		[single] => Some(single.clone()),
+		_ => Some(Rc::new(Node::Nested(parts.to_vec()))),
+	}
+}
+
+fn ends_in_template(node: &Node) -> bool {
+	match node {
+		Node::Template(..) => true,
+		Node::Nested(parts) => parts.last().is_some_and(|p| ends_in_template(p)),
+		_ => false,
+	}
+}
+
+/// Demangles an Itanium C++ ABI symbol into its full form (e.g. "Foo::bar(int) const") and the short form used
+/// as a lookup key (e.g. "Foo::bar"). Returns None for names that aren't mangled or can't be parsed
+pub fn demangle(sym: &str) -> Option<(String, String)> {
+	let bytes = sym.as_bytes();
+	if !bytes.starts_with(b"_Z") {
+		return None;
+	}
+
+	let mut parser = Parser { s: bytes, pos: 2, depth: 0, type_depth: 0, subs: Vec::new(), template_args: Vec::new() };
+	let mut node = parser.encoding()?;
+
+	if parser.pos < bytes.len() {
+		if bytes[parser.pos] != b'.' {
+			return None;
+		}
+		let suffix = std::str::from_utf8(&bytes[parser.pos..]).ok()?.to_string();
+		node = Rc::new(Node::Clone(node, suffix));
+	}
+
+	Some((render_name(&node, false), render_name(&node, true)))
+}
+
+/// Full and short names of a symbol, falling back to the symbol itself
+fn demangle_or_keep(sym: &str) -> (String, String) {
+	demangle(sym).unwrap_or_else(|| (sym.to_string(), sym.to_string()))
+}
+
+/// Demangles every symbol across threads. The results go into one arena of NUL-terminated strings, and
+/// out_offsets (2 per symbol) receives the offsets of each symbol's full and short names in it
+#[no_mangle]
+pub extern "C" fn demangle_symbols(names: *const *const c_char, count: u32, thread_count: u32,
+	out_offsets: *mut u32, out_size: *mut usize) -> *mut u8
+{
+	assert!(!names.is_null() && !out_offsets.is_null() && !out_size.is_null());
+	let names = unsafe { slice::from_raw_parts(names, count as usize) };
+	let names: Vec<&str> = names.iter().map(|&n| unsafe { CStr::from_ptr(n) }.to_str().unwrap_or("")).collect();
+
+	let chunk_count = names.len().div_ceil(CHUNK_SIZE);
+	let thread_count = match thread_count {
+		0 => thread::available_parallelism().map_or(1, |n| n.get()),
+		n => n as usize,
+	}.clamp(1, chunk_count.max(1));
+
+	let next_chunk = AtomicUsize::new(0);
+	let mut chunks: Vec<(usize, Vec<(String, String)>)> = thread::scope(|scope| {
+		let workers: Vec<_> = (0..thread_count).map(|_| scope.spawn(|| {
+			let mut done = Vec::new();
+			loop {
+				let chunk = next_chunk.fetch_add(1, Ordering::Relaxed);
+				if chunk >= chunk_count {
+					break;
+				}
+				let start = chunk * CHUNK_SIZE;
+				let end = (start + CHUNK_SIZE).min(names.len());
+				done.push((chunk, names[start..end].iter().map(|n| demangle_or_keep(n)).collect()));
+			}
+			done
+		})).collect();
+		workers.into_iter().flat_map(|w| w.join().unwrap()).collect()
+	});
+	chunks.sort_unstable_by_key(|(chunk, _)| *chunk);
+
+	let out_offsets = unsafe { slice::from_raw_parts_mut(out_offsets, names.len() * 2) };
+	let mut arena: Vec<u8> = Vec::new();
+	for (i, (full, short)) in chunks.into_iter().flat_map(|(_, c)| c).enumerate() {
+		out_offsets[i * 2] = arena.len() as u32;
+		arena.extend_from_slice(full.as_bytes());
+		arena.push(0);
+		out_offsets[i * 2 + 1] = arena.len() as u32;
+		arena.extend_from_slice(short.as_bytes());
+		arena.push(0);
+	}
+
+	let arena = arena.into_boxed_slice();
+	unsafe { *out_size = arena.len(); }
+	Box::into_raw(arena) as *mut u8
+}
+
+#[no_mangle]
+pub extern "C" fn free_demangle_arena(ptr: *mut u8, size: usize) {
+	if !ptr.is_null() {
+		unsafe { drop(Box::from_raw(slice::from_raw_parts_mut(ptr, size))); }
+	}
+}
@@ -0,0 +1,271 @@
+use unarm::arm;
+use unarm::thumb;
+use unarm::ParseFlags;
+
+use std::ffi::CStr;
+use std::fs::File;
+use std::io::Write;
+use std::os::raw::c_char;
+use std::slice;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use crate::{Symbol, SymbolMap, ARM7_PARSE_FLAGS, ARM9_PARSE_FLAGS};
+
+const FORMAT_TEXT: u32 = 0;
+const FORMAT_BINARY: u32 = 1;
+
+const BINARY_MAGIC: &[u8; 4] = b"NCDL";
+const BINARY_VERSION: u32 = 1;
+
+const CHUNK_INS_COUNT: usize = 0x4000;
+
+const INS_FLAG_CONDITIONAL: u16 = 1 << 0;
+const INS_FLAG_DATA_OP: u16 = 1 << 1;
+const INS_FLAG_SETS_FLAGS: u16 = 1 << 2;
+
+/// A binary to disassemble, described from the Ruby side
+#[repr(C)]
+pub struct DisasmTarget {
+	pub data: *const u8,
+	pub data_size: u32,
+	pub addr: u32,
+	pub name: *const c_char, // optional, written before the listing of this target
+	pub symbols: *const Symbol,
+	pub symbol_count: u32,
+	pub arm7: bool,
+	pub thumb: bool,
+}
+
+struct Target<'a> {
+	data: &'a [u8],
+	addr: u32,
+	name: &'a str,
+	symbols: Option<SymbolMap<'a>>,
+	flags: ParseFlags,
+	thumb: bool,
+}
+
+impl<'a> Target<'a> {
+	unsafe fn from_raw(target: &'a DisasmTarget) -> Self {
+		let data = if target.data.is_null() { &[][..] } else { slice::from_raw_parts(target.data, target.data_size as usize) };
+		let name = if target.name.is_null() { "" } else { CStr::from_ptr(target.name).to_str().unwrap_or("") };
+		let symbols = if target.symbols.is_null() || target.symbol_count == 0 {
+			None
+		} else {
+			Some(SymbolMap::new(slice::from_raw_parts(target.symbols, target.symbol_count as usize)))
+		};
+		Target {
+			data,
+			addr: target.addr,
+			name,
+			symbols,
+			flags: if target.arm7 { ARM7_PARSE_FLAGS } else { ARM9_PARSE_FLAGS },
+			thumb: target.thumb,
+		}
+	}
+
+	fn ins_size(&self) -> usize {
+		if self.thumb { 2 } else { 4 }
+	}
+
+	fn ins_count(&self) -> usize {
+		self.data.len() / self.ins_size()
+	}
+
+	fn read_code(&self, index: usize) -> u32 {
+		if self.thumb {
+			u16::from_le_bytes([self.data[index * 2], self.data[index * 2 + 1]]) as u32
+		} else {
+			let i = index * 4;
+			u32::from_le_bytes([self.data[i], self.data[i + 1], self.data[i + 2], self.data[i + 3]])
+		}
+	}
+}
+
+struct Chunk {
+	target: usize,
+	start: usize,
+	end: usize,
+}
+
+macro_rules! write_text_line {
+	($out:expr, $ins:expr, $target:expr, $addr:expr) => {{
+		let parsed = $ins.parse(&$target.flags);
+		let _ = match &$target.symbols {
+			Some(map) => {
+				let syms = unarm::Symbols { lookup: map, program_counter: $addr, pc_load_offset: 0 };
+				writeln!($out, "{:#x}: {}", $addr, parsed.display_with_symbols(Default::default(), syms))
+			}
+			None => writeln!($out, "{:#x}: {}", $addr, parsed.display(Default::default())),
+		};
+	}};
+}
+
+macro_rules! write_binary_record {
+	($out:expr, $ins:expr, $code:expr) => {{
+		let mut flags = 0u16;
+		if $ins.is_conditional() { flags |= INS_FLAG_CONDITIONAL; }
+		if $ins.is_data_operation() { flags |= INS_FLAG_DATA_OP; }
+		if $ins.updates_condition_flags() { flags |= INS_FLAG_SETS_FLAGS; }
+		$out.extend_from_slice(&($code).to_le_bytes());
+		$out.extend_from_slice(&($ins.op as u16).to_le_bytes());
+		$out.extend_from_slice(&flags.to_le_bytes());
+	}};
+}
+
+fn disasm_chunk(target: &Target, chunk: &Chunk, format: u32) -> Vec<u8> {
+	let count = chunk.end - chunk.start;
+	let mut out = Vec::with_capacity(if format == FORMAT_TEXT { count * 40 } else { count * 8 });
+
+	for i in chunk.start..chunk.end {
+		let code = target.read_code(i);
+		let addr = target.addr.wrapping_add((i * target.ins_size()) as u32);
+
+		if target.thumb {
+			let ins = thumb::Ins::new(code, &target.flags);
+			if format == FORMAT_TEXT {
+				write_text_line!(out, ins, target, addr);
+			} else {
+				write_binary_record!(out, ins, code);
+			}
+		} else {
+			let ins = arm::Ins::new(code, &target.flags);
+			if format == FORMAT_TEXT {
+				write_text_line!(out, ins, target, addr);
+			} else {
+				write_binary_record!(out, ins, code);
+			}
+		}
+	}
+
+	out
+}
+
+fn write_target_header(out: &mut Vec<u8>, target: &Target, format: u32) {
+	if format == FORMAT_TEXT {
+		if !target.name.is_empty() {
+			let _ = writeln!(out, "; {}", target.name);
+		}
+	} else {
+		out.extend_from_slice(&target.addr.to_le_bytes());
+		out.extend_from_slice(&(target.ins_count() as u32).to_le_bytes());
+		out.push(target.ins_size() as u8);
+		out.push(if target.flags.version == ARM7_PARSE_FLAGS.version { 1 } else { 0 });
+		out.extend_from_slice(&(target.name.len() as u16).to_le_bytes());
+		out.extend_from_slice(target.name.as_bytes());
+	}
+}
+
+/// Disassembles every target across `thread_count` threads (0 = all cores) and concatenates the listings in order
+fn export(targets: &[DisasmTarget], format: u32, thread_count: u32) -> Option<Vec<u8>> {
+	if format != FORMAT_TEXT && format != FORMAT_BINARY {
+		return None;
+	}
+
+	let targets: Vec<Target> = targets.iter().map(|t| unsafe { Target::from_raw(t) }).collect();
+
+	let mut chunks = Vec::new();
+	for (t, target) in targets.iter().enumerate() {
+		let count = target.ins_count();
+		let mut start = 0;
+		while start < count {
+			let end = (start + CHUNK_INS_COUNT).min(count);
+			chunks.push(Chunk { target: t, start, end });
+			start = end;
+		}
+	}
+
+	let thread_count = match thread_count {
+		0 => std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1),
+		n => n as usize,
+	}.clamp(1, chunks.len().max(1));
+
+	let next = AtomicUsize::new(0);
+	let mut results: Vec<(usize, Vec<u8>)> = std::thread::scope(|scope| {
+		let workers: Vec<_> = (0..thread_count).map(|_| {
+			scope.spawn(|| {
+				let mut done = Vec::new();
+				loop {
+					let i = next.fetch_add(1, Ordering::Relaxed);
+					if i >= chunks.len() {
+						break;
+					}
+					let chunk = &chunks[i];
+					done.push((i, disasm_chunk(&targets[chunk.target], chunk, format)));
+				}
+				done
+			})
+		}).collect();
+		workers.into_iter().flat_map(|w| w.join().unwrap()).collect()
+	});
+	results.sort_unstable_by_key(|(i, _)| *i);
+
+	let total: usize = results.iter().map(|(_, r)| r.len()).sum();
+	let mut out = Vec::with_capacity(total + 64 * targets.len() + 12);
+
+	if format == FORMAT_BINARY {
+		out.extend_from_slice(BINARY_MAGIC);
+		out.extend_from_slice(&BINARY_VERSION.to_le_bytes());
+		out.extend_from_slice(&(targets.len() as u32).to_le_bytes());
+	}
+
+	let mut results = results.into_iter().peekable();
+	for (t, target) in targets.iter().enumerate() {
+		write_target_header(&mut out, target, format);
+		while let Some((i, _)) = results.peek() {
+			if chunks[*i].target != t {
+				break;
+			}
+			out.extend_from_slice(&results.next().unwrap().1);
+		}
+		if format == FORMAT_TEXT {
+			out.push(b'\n');
+		}
+	}
+
+	Some(out)
+}
+
+unsafe fn targets_from_raw<'a>(targets: *const DisasmTarget, target_count: u32) -> &'a [DisasmTarget] {
+	if targets.is_null() || target_count == 0 {
+		&[]
+	} else {
+		slice::from_raw_parts(targets, target_count as usize)
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn disasm_export_to_file(targets: *const DisasmTarget, target_count: u32, format: u32, thread_count: u32, path: *const c_char) -> bool {
+	if path.is_null() {
+		return false;
+	}
+	let path = match unsafe { CStr::from_ptr(path) }.to_str() {
+		Ok(p) => p,
+		Err(_) => return false,
+	};
+	let Some(out) = export(unsafe { targets_from_raw(targets, target_count) }, format, thread_count) else {
+		return false;
+	};
+	File::create(path).and_then(|mut f| f.write_all(&out)).is_ok()
+}
+
+#[no_mangle]
+pub extern "C" fn disasm_export_to_buffer(targets: *const DisasmTarget, target_count: u32, format: u32, thread_count: u32, out_size: *mut usize) -> *mut u8 {
+	let Some(out) = export(unsafe { targets_from_raw(targets, target_count) }, format, thread_count) else {
+		return std::ptr::null_mut();
+	};
+	let boxed = out.into_boxed_slice();
+	if !out_size.is_null() {
+		unsafe { *out_size = boxed.len(); }
+	}
+	Box::into_raw(boxed) as *mut u8
+}
+
+#[no_mangle]
+pub extern "C" fn free_disasm_buffer(ptr: *mut u8, size: usize) {
+	unsafe {
+		if !ptr.is_null() {
+			drop(Box::from_raw(slice::from_raw_parts_mut(ptr, size)));
+		}
+	}
+}
@@ -0,0 +1,289 @@
+use unarm::ParseFlags;
+
+use std::collections::HashSet;
+use std::slice;
+
+use crate::op;
+use crate::table::{decode_arm, decode_thumb, INS_CONDITIONAL, INS_FUNCTION_END, INS_HAS_BRANCH_DEST, INS_HAS_TARGET, INS_ILLEGAL};
+use crate::{ARM7_PARSE_FLAGS, ARM9_PARSE_FLAGS};
+
+/// Same threshold as disasm_function in Ruby
+const MAX_FUNCTION_INS_COUNT: usize = 2500;
+
+pub const CLASS_UNKNOWN: u8 = 0;
+pub const CLASS_ARM_CODE: u8 = 1;
+pub const CLASS_THUMB_CODE: u8 = 2;
+pub const CLASS_LITERAL_POOL: u8 = 3;
+
+#[derive(Default, Clone, Copy, PartialEq, Eq, Debug)]
+#[repr(C)]
+pub struct FunctionInfo {
+	pub start: u32,
+	pub end: u32,        // end of the last instruction
+	pub pool_start: u32, // equal to pool_end when the function has no literal pool
+	pub pool_end: u32,
+	pub thumb: bool,
+}
+
+impl FunctionInfo {
+	/// End of everything the function owns, literal pool included
+	pub fn extent_end(&self) -> u32 {
+		self.end.max(self.pool_end)
+	}
+
+	pub fn contains(&self, addr: u32) -> bool {
+		addr >= self.start && addr < self.extent_end()
+	}
+}
+
+struct Region<'a> {
+	data: &'a [u8],
+	addr: u32,
+}
+
+impl<'a> Region<'a> {
+	fn contains(&self, addr: u32) -> bool {
+		addr >= self.addr && ((addr - self.addr) as usize) < self.data.len()
+	}
+
+	fn read16(&self, addr: u32) -> Option<u32> {
+		let i = addr.checked_sub(self.addr)? as usize;
+		let b = self.data.get(i..i + 2)?;
+		Some(u16::from_le_bytes([b[0], b[1]]) as u32)
+	}
+
+	fn read32(&self, addr: u32) -> Option<u32> {
+		let i = addr.checked_sub(self.addr)? as usize;
+		let b = self.data.get(i..i + 4)?;
+		Some(u32::from_le_bytes([b[0], b[1], b[2], b[3]]))
+	}
+}
+
+fn sign_extend(value: u32, bits: u32) -> i32 {
+	((value << (32 - bits)) as i32) >> (32 - bits)
+}
+
+/// Destination and mode of an ARM bl/blx with an immediate offset
+fn arm_call_target(code: u32, addr: u32) -> Option<(u32, bool)> {
+	let offset = sign_extend(code & 0xFFFFFF, 24) << 2;
+	let base = addr.wrapping_add(8).wrapping_add(offset as u32);
+	if code & 0xFE000000 == 0xFA000000 {
+		Some((base | ((code >> 23) & 2), true)) // blx: H bit selects the halfword
+	} else if code & 0x0F000000 == 0x0B000000 && code >> 28 != 0xF {
+		Some((base, false))
+	} else {
+		None
+	}
+}
+
+/// Destination and mode of a Thumb bl/blx prefix and suffix pair
+pub fn thumb_call_target(first: u32, second: u32, addr: u32) -> Option<(u32, bool)> {
+	if first & 0xF800 != 0xF000 {
+		return None;
+	}
+	let offset = (sign_extend(first & 0x7FF, 11) << 12) + (((second & 0x7FF) << 1) as i32);
+	let target = addr.wrapping_add(4).wrapping_add(offset as u32);
+	match second & 0xF800 {
+		0xF800 => Some((target, true)),
+		0xE800 => Some((target & !3, false)),
+		_ => None,
+	}
+}
+
+/// Sweeps one function the same way disasm_function does in Ruby, collecting the functions it calls
+fn analyze_function(region: &Region, start: u32, thumb: bool, flags: &ParseFlags, calls: &mut Vec<(u32, bool)>) -> Option<FunctionInfo> {
+	let ins_size = if thumb { 2 } else { 4 };
+	let mut pool: HashSet<u32> = HashSet::new();
+	let mut pool_start = u32::MAX;
+	let mut pool_end = 0;
+	let mut labels_max: Option<u32> = None;
+	let mut count = 0;
+	let mut addr = start;
+
+	loop {
+		if pool.contains(&addr) {
+			addr += ins_size;
+			continue;
+		}
+
+		let code = if thumb { region.read16(addr)? } else { region.read32(addr)? };
+		let ins = if thumb { decode_thumb(code, addr, flags) } else { decode_arm(code, addr, flags) };
+		if ins.flags & INS_ILLEGAL != 0 {
+			return None;
+		}
+
+		count += 1;
+		if count > MAX_FUNCTION_INS_COUNT {
+			return None;
+		}
+
+		if ins.flags & INS_HAS_TARGET != 0 && region.contains(ins.target_addr) {
+			pool.insert(ins.target_addr);
+			pool_start = pool_start.min(ins.target_addr);
+			pool_end = pool_end.max(ins.target_addr + 4);
+		}
+
+		let mut size = ins_size;
+		if thumb {
+			if let Some(second) = region.read16(addr + 2) {
+				if let Some(call) = thumb_call_target(code, second, addr) {
+					calls.push(call);
+					size = 4;
+				}
+			}
+		} else if let Some(call) = arm_call_target(code, addr) {
+			calls.push(call);
+		}
+
+		if ins.opcode == op::B && ins.flags & INS_HAS_BRANCH_DEST != 0 {
+			let max = labels_max.map_or(ins.branch_dest, |m| m.max(ins.branch_dest));
+			labels_max = Some(max);
+			if ins.flags & INS_CONDITIONAL == 0 && addr > max {
+				return Some(make_info(start, addr + size, pool_start, pool_end, thumb));
+			}
+		} else if ins.flags & INS_FUNCTION_END != 0 && labels_max.map_or(true, |m| addr > m) {
+			return Some(make_info(start, addr + size, pool_start, pool_end, thumb));
+		}
+
+		addr += size;
+	}
+}
+
+fn make_info(start: u32, end: u32, pool_start: u32, pool_end: u32, thumb: bool) -> FunctionInfo {
+	let (pool_start, pool_end) = if pool_start < pool_end { (pool_start, pool_end) } else { (end, end) };
+	FunctionInfo { start, end, pool_start, pool_end, thumb }
+}
+
+/// Every function found in a code region, sorted by start address
+pub struct FunctionMap {
+	funcs: Vec<FunctionInfo>,
+	max_extent_end: Vec<u32>, // largest extent end of funcs[..=i], to bound containment searches
+}
+
+impl FunctionMap {
+	fn build(region: &Region, seeds: &[u32], flags: &ParseFlags) -> Self {
+		let mut visited: HashSet<u32> = HashSet::new();
+		let mut worklist: Vec<(u32, bool)> = seeds.iter().rev().map(|&s| (s & !1, s & 1 != 0)).collect();
+		let mut funcs = Vec::new();
+		let mut calls = Vec::new();
+
+		while let Some((start, thumb)) = worklist.pop() {
+			if !region.contains(start) || !visited.insert(start | thumb as u32) {
+				continue;
+			}
+			calls.clear();
+			if let Some(info) = analyze_function(region, start, thumb, flags, &mut calls) {
+				funcs.push(info);
+				worklist.extend(calls.iter().copied().filter(|&(addr, thumb)| !visited.contains(&(addr | thumb as u32))));
+			}
+		}
+
+		funcs.sort_unstable_by_key(|f| (f.start, f.thumb));
+		funcs.dedup_by_key(|f| f.start);
+
+		let mut max_extent_end = Vec::with_capacity(funcs.len());
+		let mut max = 0;
+		for f in &funcs {
+			max = max.max(f.extent_end());
+			max_extent_end.push(max);
+		}
+
+		FunctionMap { funcs, max_extent_end }
+	}
+
+
+	pub fn functions(&self) -> &[FunctionInfo] {
+		&self.funcs
+	}
+
+	pub fn find(&self, start: u32) -> Option<&FunctionInfo> {
+		let start = start & !1;
+		self.funcs.binary_search_by_key(&start, |f| f.start).ok().map(|i| &self.funcs[i])
+	}
+
+	pub fn find_containing(&self, addr: u32) -> Option<&FunctionInfo> {
+		let mut i = self.funcs.partition_point(|f| f.start <= addr);
+		while i > 0 {
+			i -= 1;
+			if self.max_extent_end[i] <= addr {
+				break;
+			}
+			if self.funcs[i].contains(addr) {
+				return Some(&self.funcs[i]);
+			}
+		}
+		None
+	}
+
+	pub fn classify(&self, addr: u32) -> u8 {
+		match self.find_containing(addr) {
+			Some(f) if addr < f.end && !(addr >= f.pool_start && addr < f.pool_end) => {
+				if f.thumb { CLASS_THUMB_CODE } else { CLASS_ARM_CODE }
+			}
+			Some(_) => CLASS_LITERAL_POOL,
+			None => CLASS_UNKNOWN,
+		}
+	}
+}
+
+/// Seeds are function addresses with bit 0 set for Thumb, e.g. the entry point, symbols and static initializers
+#[no_mangle]
+pub extern "C" fn function_map_build(data: *const u8, data_size: u32, addr: u32, arm7: bool, seeds: *const u32, seed_count: u32) -> *mut FunctionMap {
+	assert!(!data.is_null());
+	let region = Region { data: unsafe { slice::from_raw_parts(data, data_size as usize) }, addr };
+	let seeds = if seeds.is_null() { &[][..] } else { unsafe { slice::from_raw_parts(seeds, seed_count as usize) } };
+	let flags = if arm7 { ARM7_PARSE_FLAGS } else { ARM9_PARSE_FLAGS };
+	Box::into_raw(Box::new(FunctionMap::build(&region, seeds, &flags)))
+}
+
+#[no_mangle]
+pub extern "C" fn function_map_count(map: *const FunctionMap) -> u32 {
+	unsafe { (&*map).funcs.len() as u32 }
+}
+
+#[no_mangle]
+pub extern "C" fn function_map_get(map: *const FunctionMap, index: u32, out: *mut FunctionInfo) -> bool {
+	match unsafe { (&*map).funcs.get(index as usize) } {
+		Some(info) => {
+			unsafe { *out = *info; }
+			true
+		}
+		None => false,
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn function_map_find(map: *const FunctionMap, start: u32, out: *mut FunctionInfo) -> bool {
+	match unsafe { (&*map).find(start) } {
+		Some(info) => {
+			unsafe { *out = *info; }
+			true
+		}
+		None => false,
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn function_map_find_containing(map: *const FunctionMap, addr: u32, out: *mut FunctionInfo) -> bool {
+	match unsafe { (&*map).find_containing(addr) } {
+		Some(info) => {
+			unsafe { *out = *info; }
+			true
+		}
+		None => false,
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn function_map_classify(map: *const FunctionMap, addr: u32) -> u8 {
+	unsafe { (&*map).classify(addr) }
+}
+
+#[no_mangle]
+pub extern "C" fn free_function_map(map: *mut FunctionMap) {
+	unsafe {
+		if !map.is_null() {
+			drop(Box::from_raw(map));
+		}
+	}
+}
@@ -6,10 +6,19 @@ use unarm::Parser;
 use unarm::ParseMode;
 use unarm::args::*;
 
+use std::collections::HashMap;
 use std::ffi::CString;
 use std::os::raw::c_char;
 use std::slice;
 
+mod export;
+mod table;
+mod funcs;
+mod demangle;
+mod suggest;
+mod search;
+mod dataflow;
+
 #[derive(Default, Clone, Copy, PartialEq, Eq, Debug)]
 #[repr(C)]
 pub struct CReg {
@@ -200,6 +209,115 @@ impl<'a> unarm::LookupSymbol for SymbolSlice<'a> {
 	}
 }
 
+/// Symbol lookup by address in constant time, for bulk disassembly
+pub struct SymbolMap<'a> {
+	map: HashMap<u32, &'a str>,
+}
+
+impl<'a> SymbolMap<'a> {
+	pub fn new(syms: &'a [Symbol]) -> Self {
+		let mut map = HashMap::with_capacity(syms.len());
+		for sym in syms {
+			if sym.name.is_null() {
+				continue;
+			}
+			if let Ok(name) = unsafe { std::ffi::CStr::from_ptr(sym.name) }.to_str() {
+				map.entry(sym.addr).or_insert(name); // first symbol wins, like SymbolSlice
+			}
+		}
+		SymbolMap { map }
+	}
+}
+
+impl<'a> unarm::LookupSymbol for SymbolMap<'a> {
+	fn lookup_symbol_name(&self, _source: u32, destination: u32) -> Option<&str> {
+		self.map.get(&destination).copied()
+	}
+}
+
+/// Opcode IDs, in the order of UnarmBind::OPCODE
+pub mod op {
+	pub const ILLEGAL: u16 = 0;
+	pub const ADC: u16 = 1;
+	pub const ADD: u16 = 2;
+	pub const AND: u16 = 3;
+	pub const ASR: u16 = 4;
+	pub const B: u16 = 5;
+	pub const BL: u16 = 6;
+	pub const BIC: u16 = 7;
+	pub const BLXI: u16 = 9;
+	pub const BLXR: u16 = 10;
+	pub const BX: u16 = 11;
+	pub const CMN: u16 = 17;
+	pub const CMP: u16 = 18;
+	pub const EOR: u16 = 22;
+	pub const LDMW: u16 = 25;
+	pub const LDMPC: u16 = 30;
+	pub const LDR: u16 = 31;
+	pub const LDRD: u16 = 34;
+	pub const LSL: u16 = 43;
+	pub const LSR: u16 = 44;
+	pub const MOV: u16 = 50;
+	pub const MOVIMM: u16 = 51;
+	pub const MOVREG: u16 = 52;
+	pub const MUL: u16 = 60;
+	pub const MVN: u16 = 61;
+	pub const NOP: u16 = 62;
+	pub const ORR: u16 = 63;
+	pub const POPM: u16 = 67;
+	pub const POPR: u16 = 68;
+	pub const PUSHM: u16 = 69;
+	pub const PUSHR: u16 = 70;
+	pub const ROR: u16 = 85;
+	pub const RSB: u16 = 87;
+	pub const SMLAL: u16 = 104;
+	pub const SMULL: u16 = 115;
+	pub const STM: u16 = 126;
+	pub const STMPW: u16 = 129;
+	pub const STR: u16 = 130;
+	pub const STREX: u16 = 134;
+	pub const STREXH: u16 = 137;
+	pub const STRT: u16 = 139;
+	pub const SUB: u16 = 140;
+	pub const SVC: u16 = 141;
+	pub const SWI: u16 = 142;
+	pub const TEQ: u16 = 151;
+	pub const TST: u16 = 152;
+	pub const UMLAL: u16 = 164;
+	pub const UMULL: u16 = 165;
+
+	pub fn is_mov(op: u16) -> bool {
+		(MOV..=MOVREG).contains(&op)
+	}
+
+	pub fn is_ldm(op: u16) -> bool {
+		(LDMW..=LDMPC).contains(&op)
+	}
+
+	pub fn is_pop(op: u16) -> bool {
+		op == POPM || op == POPR
+	}
+
+	pub fn is_stm(op: u16) -> bool {
+		(STM..=STMPW).contains(&op)
+	}
+
+	/// Every str variant, strex ones included
+	pub fn is_str(op: u16) -> bool {
+		(STR..=STRT).contains(&op)
+	}
+
+	/// strex, strexb, strexd and strexh, which write their status to the first register
+	pub fn is_strex(op: u16) -> bool {
+		(STREX..=STREXH).contains(&op)
+	}
+}
+
+pub const REG_SP: u8 = 13;
+pub const REG_LR: u8 = 14;
+pub const REG_PC: u8 = 15;
+pub const REG_NONE: u8 = 255;
+
 const ARM9_PARSE_FLAGS: ParseFlags = ParseFlags {
 	ual: true,
 	version: ArmVersion::V5Te,
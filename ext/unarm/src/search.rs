@@ -0,0 +1,290 @@
+use unarm::arm;
+use unarm::thumb;
+use unarm::args::*;
+use unarm::ParseFlags;
+
+use std::slice;
+
+use crate::funcs::FunctionMap;
+use crate::table::{decode, INS_HAS_BRANCH_DEST, INS_HAS_TARGET};
+use crate::{ARM7_PARSE_FLAGS, ARM9_PARSE_FLAGS, REG_NONE};
+
+/// Number of opcode IDs, i.e. the length of UnarmBind::OPCODE
+const OPCODE_COUNT: usize = 188;
+
+/// Registers of an instruction indexed by position, in the order they are written
+const MAX_REGS: usize = 4;
+
+pub const FIELD_IMM: u32 = 1 << 0;
+pub const FIELD_BRANCH_DEST: u32 = 1 << 1;
+pub const FIELD_TARGET: u32 = 1 << 2;
+pub const FIELD_VALUE: u32 = 1 << 3;
+pub const FIELD_ANY_REG: u32 = 1 << 4;
+
+pub const MODE_ARM: u8 = 1;
+pub const MODE_THUMB: u8 = 2;
+
+const ANY: u8 = 255;
+
+/// One indexed instruction; the fields that are absent are left at 0 and masked out by `fields`
+#[derive(Default, Clone, Copy)]
+struct Row {
+	addr: u32, // with bit 0 set for Thumb
+	opcode: u16,
+	cond: u8,
+	regs: [u8; MAX_REGS],
+	fields: u32,
+	imm: u32,
+	branch_dest: u32,
+	target_addr: u32,
+	value: u32, // the word loaded by a pc-relative ldr, when it is within the region
+}
+
+/// What to look for, built from a query by Unarm::InsPattern; ANY (255) leaves a byte field unconstrained
+#[repr(C)]
+pub struct InsPattern {
+	pub opcodes: *const u16, // any of these, or any opcode if empty
+	pub opcode_count: u32,
+	pub cond: u8,
+	pub mode: u8, // 0 for either
+	pub regs: [u8; MAX_REGS],
+	pub any_reg: u8, // a register that must appear in any position
+	pub fields: u32, // which of the values below must match
+	pub imm: u32,
+	pub branch_dest: u32,
+	pub target_addr: u32,
+	pub value: u32,
+}
+
+/// Decoded fields of every instruction in a code region, with the rows of each opcode listed together so a query
+/// only visits instructions of the opcodes it names
+pub struct InsIndex {
+	rows: Vec<Row>,
+	opcode_starts: Vec<u32>, // rows of opcode i are rows[opcode_starts[i]..opcode_starts[i + 1]]
+}
+
+fn reg_args(args: &[Argument]) -> [u8; MAX_REGS] {
+	let mut regs = [REG_NONE; MAX_REGS];
+	let found = args.iter().filter_map(|arg| match arg {
+		Argument::Reg(r) => Some(r.reg as u8),
+		Argument::OffsetReg(r) => Some(r.reg as u8),
+		Argument::ShiftReg(r) => Some(r.reg as u8),
+		_ => None,
+	});
+	for (slot, reg) in regs.iter_mut().zip(found) {
+		*slot = reg;
+	}
+	regs
+}
+
+fn imm_arg(args: &[Argument]) -> Option<u32> {
+	args.iter().find_map(|arg| match arg {
+		Argument::UImm(v) | Argument::SatImm(v) => Some(*v),
+		Argument::SImm(v) => Some(*v as u32),
+		Argument::OffsetImm(o) => Some(o.value as u32),
+		Argument::ShiftImm(s) => Some(s.imm),
+		_ => None,
+	})
+}
+
+struct Builder<'a> {
+	data: &'a [u8],
+	addr: u32,
+	flags: ParseFlags,
+	rows: Vec<Row>,
+}
+
+impl<'a> Builder<'a> {
+	fn read(&self, addr: u32, size: usize) -> Option<u32> {
+		let i = addr.checked_sub(self.addr)? as usize;
+		let b = self.data.get(i..i + size)?;
+		Some(b.iter().rev().fold(0, |v, &byte| (v << 8) | byte as u32))
+	}
+
+	fn push(&mut self, addr: u32, thumb: bool) {
+		let Some(code) = self.read(addr, if thumb { 2 } else { 4 }) else {
+			return;
+		};
+
+		let (opcode, parsed, conditional, data_op, sets_flags) = if thumb {
+			let ins = thumb::Ins::new(code, &self.flags);
+			(ins.op as u16, ins.parse(&self.flags), ins.is_conditional(), ins.is_data_operation(), ins.updates_condition_flags())
+		} else {
+			let ins = arm::Ins::new(code, &self.flags);
+			(ins.op as u16, ins.parse(&self.flags), ins.is_conditional(), ins.is_data_operation(), ins.updates_condition_flags())
+		};
+		let decoded = decode(opcode, &parsed.args, code, addr, thumb, conditional, data_op, sets_flags);
+
+		let mut row = Row {
+			addr: addr | thumb as u32,
+			opcode,
+			cond: decoded.cond,
+			regs: reg_args(&parsed.args),
+			..Default::default()
+		};
+		if let Some(imm) = imm_arg(&parsed.args) {
+			row.imm = imm;
+			row.fields |= FIELD_IMM;
+		}
+		if decoded.flags & INS_HAS_BRANCH_DEST != 0 {
+			row.branch_dest = decoded.branch_dest;
+			row.fields |= FIELD_BRANCH_DEST;
+		}
+		if decoded.flags & INS_HAS_TARGET != 0 {
+			row.target_addr = decoded.target_addr;
+			row.fields |= FIELD_TARGET;
+			if let Some(value) = self.read(decoded.target_addr, 4) {
+				row.value = value;
+				row.fields |= FIELD_VALUE;
+			}
+		}
+		self.rows.push(row);
+	}
+
+	fn push_range(&mut self, start: u32, end: u32, thumb: bool) {
+		let size = if thumb { 2 } else { 4 };
+		let mut addr = (start + size - 1) & !(size - 1);
+		while addr + size <= end {
+			self.push(addr, thumb);
+			addr += size;
+		}
+	}
+}
+
+impl InsIndex {
+	/// Indexes the code of each known function in its own mode, skipping literal pools, and whatever no function
+	/// covers as ARM; without a function map the whole region is taken to be ARM
+	fn build(data: &[u8], addr: u32, arm7: bool, functions: Option<&FunctionMap>) -> Self {
+		let mut builder = Builder {
+			data,
+			addr,
+			flags: if arm7 { ARM7_PARSE_FLAGS } else { ARM9_PARSE_FLAGS },
+			rows: Vec::with_capacity(data.len() / 4),
+		};
+		let end = addr + data.len() as u32;
+
+		let mut cursor = addr;
+		for f in functions.map(|m| m.functions()).unwrap_or(&[]) {
+			if f.extent_end() <= cursor || f.start >= end {
+				continue;
+			}
+			builder.push_range(cursor, f.start, false);
+			builder.push_range(cursor.max(f.start), f.end.min(end), f.thumb);
+			cursor = cursor.max(f.extent_end().min(end));
+		}
+		builder.push_range(cursor, end, false);
+
+		// Grouped by opcode with a counting sort, which keeps each group in address order
+		let rows = builder.rows;
+		let mut opcode_starts = vec![0u32; OPCODE_COUNT + 1];
+		for row in &rows {
+			opcode_starts[(row.opcode as usize).min(OPCODE_COUNT - 1) + 1] += 1;
+		}
+		for i in 1..=OPCODE_COUNT {
+			opcode_starts[i] += opcode_starts[i - 1];
+		}
+		let mut next = opcode_starts.clone();
+		let mut sorted = vec![Row::default(); rows.len()];
+		for row in rows {
+			let slot = &mut next[(row.opcode as usize).min(OPCODE_COUNT - 1)];
+			sorted[*slot as usize] = row;
+			*slot += 1;
+		}
+
+		InsIndex { rows: sorted, opcode_starts }
+	}
+
+	fn matches(row: &Row, pattern: &InsPattern) -> bool {
+		if pattern.cond != ANY && row.cond != pattern.cond {
+			return false;
+		}
+		match pattern.mode {
+			MODE_ARM if row.addr & 1 != 0 => return false,
+			MODE_THUMB if row.addr & 1 == 0 => return false,
+			_ => {}
+		}
+		if row.regs.iter().zip(&pattern.regs).any(|(&r, &p)| p != ANY && r != p) {
+			return false;
+		}
+		if pattern.fields & FIELD_ANY_REG != 0 && !row.regs.contains(&pattern.any_reg) {
+			return false;
+		}
+		let fields = pattern.fields & !FIELD_ANY_REG;
+		if row.fields & fields != fields {
+			return false;
+		}
+		(fields & FIELD_IMM == 0 || row.imm == pattern.imm)
+			&& (fields & FIELD_BRANCH_DEST == 0 || row.branch_dest == pattern.branch_dest)
+			&& (fields & FIELD_TARGET == 0 || row.target_addr == pattern.target_addr)
+			&& (fields & FIELD_VALUE == 0 || row.value == pattern.value)
+	}
+
+	/// Addresses (with bit 0 set for Thumb) of every instruction matching the pattern, in address order
+	fn query(&self, pattern: &InsPattern) -> Vec<u32> {
+		let opcodes = if pattern.opcodes.is_null() {
+			&[][..]
+		} else {
+			unsafe { slice::from_raw_parts(pattern.opcodes, pattern.opcode_count as usize) }
+		};
+
+		let mut found: Vec<u32> = if opcodes.is_empty() {
+			self.rows.iter().filter(|row| Self::matches(row, pattern)).map(|row| row.addr).collect()
+		} else {
+			opcodes.iter()
+				.filter(|&&op| (op as usize) < OPCODE_COUNT)
+				.flat_map(|&op| {
+					let (start, end) = (self.opcode_starts[op as usize], self.opcode_starts[op as usize + 1]);
+					self.rows[start as usize..end as usize].iter()
+				})
+				.filter(|row| Self::matches(row, pattern))
+				.map(|row| row.addr)
+				.collect()
+		};
+
+		found.sort_unstable_by_key(|&addr| addr & !1);
+		found
+	}
+}
+
+/// Functions, if given, tell ARM code from Thumb code and literal pools; see InsIndex::build
+#[no_mangle]
+pub extern "C" fn ins_index_build(data: *const u8, data_size: u32, addr: u32, arm7: bool, functions: *const FunctionMap) -> *mut InsIndex {
+	assert!(!data.is_null());
+	let data = unsafe { slice::from_raw_parts(data, data_size as usize) };
+	let functions = if functions.is_null() { None } else { Some(unsafe { &*functions }) };
+	Box::into_raw(Box::new(InsIndex::build(data, addr, arm7, functions)))
+}
+
+#[no_mangle]
+pub extern "C" fn ins_index_count(index: *const InsIndex) -> u32 {
+	unsafe { (&*index).rows.len() as u32 }
+}
+
+/// Returns the matching addresses, to be freed with free_ins_index_results, and writes how many there are
+#[no_mangle]
+pub extern "C" fn ins_index_query(index: *const InsIndex, pattern: *const InsPattern, out_count: *mut u32) -> *mut u32 {
+	let found = unsafe { (&*index).query(&*pattern) };
+	unsafe { *out_count = found.len() as u32; }
+	if found.is_empty() {
+		return std::ptr::null_mut();
+	}
+	Box::into_raw(found.into_boxed_slice()) as *mut u32
+}
+
+#[no_mangle]
+pub extern "C" fn free_ins_index_results(ptr: *mut u32, count: u32) {
+	unsafe {
+		if !ptr.is_null() {
+			drop(Box::from_raw(slice::from_raw_parts_mut(ptr, count as usize)));
+		}
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn free_ins_index(index: *mut InsIndex) {
+	unsafe {
+		if !index.is_null() {
+			drop(Box::from_raw(index));
+		}
+	}
+}
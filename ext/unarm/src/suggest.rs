@@ -0,0 +1,198 @@
+use std::collections::HashMap;
+use std::ffi::CStr;
+use std::os::raw::c_char;
+use std::slice;
+
+/// How many of the best trigram matches get rescored with Jaro-Winkler and Levenshtein
+const CANDIDATE_COUNT: usize = 64;
+
+/// Trigrams found in more than 1/STOP_GRAM_RATIO of the names (e.g. "::" runs, "std") say little about a
+/// match and would dominate lookup time, so they are skipped unless the query has nothing else
+const STOP_GRAM_RATIO: usize = 8;
+
+/// Padding so that the first and last characters of a name form trigrams of their own
+const PAD: u8 = b'\x01';
+
+/// Approximate-match index over a symbol table: trigram postings narrow the table down to a few candidates,
+/// which are then ranked by the same Jaro-Winkler/Levenshtein blend Hash#suggest_similar_key uses
+pub struct SymbolIndex {
+	names: Vec<Vec<u8>>,       // lowercased
+	gram_counts: Vec<u16>,     // distinct trigrams per name
+	postings: HashMap<u32, Vec<u32>>,
+}
+
+fn lowercase(s: &[u8]) -> Vec<u8> {
+	s.iter().map(|c| c.to_ascii_lowercase()).collect()
+}
+
+/// Distinct trigrams of a lowercased name
+fn trigrams(name: &[u8]) -> Vec<u32> {
+	let mut padded = Vec::with_capacity(name.len() + 3);
+	padded.extend_from_slice(&[PAD, PAD]);
+	padded.extend_from_slice(name);
+	padded.push(PAD);
+	let mut grams: Vec<u32> = padded.windows(3)
+		.map(|w| (w[0] as u32) << 16 | (w[1] as u32) << 8 | w[2] as u32)
+		.collect();
+	grams.sort_unstable();
+	grams.dedup();
+	grams
+}
+
+/// Port of DidYouMean::Jaro.distance
+fn jaro(a: &[u8], b: &[u8]) -> f64 {
+	let (a, b) = if a.len() > b.len() { (b, a) } else { (a, b) };
+	let range = (b.len() / 2).saturating_sub(1);
+	let mut flags_a = vec![false; a.len()];
+	let mut flags_b = vec![false; b.len()];
+
+	let mut m = 0.0;
+	for i in 0..a.len() {
+		let lo = i.saturating_sub(range);
+		let hi = (i + range + 1).min(b.len());
+		for j in lo..hi {
+			if !flags_b[j] && a[i] == b[j] {
+				flags_a[i] = true;
+				flags_b[j] = true;
+				m += 1.0;
+				break;
+			}
+		}
+	}
+	if m == 0.0 {
+		return 0.0;
+	}
+
+	let mut t = 0.0;
+	let mut k = 0;
+	for i in 0..a.len() {
+		if flags_a[i] {
+			while !flags_b[k] {
+				k += 1;
+			}
+			if a[i] != b[k] {
+				t += 1.0;
+			}
+			k += 1;
+		}
+	}
+	let t = (t / 2.0f64).floor();
+
+	(m / a.len() as f64 + m / b.len() as f64 + (m - t) / m) / 3.0
+}
+
+/// Port of DidYouMean::JaroWinkler.distance
+fn jaro_winkler(a: &[u8], b: &[u8]) -> f64 {
+	let dist = jaro(a, b);
+	if dist <= 0.7 {
+		return dist;
+	}
+	let prefix = a.iter().zip(b).take(4).take_while(|(x, y)| x == y).count();
+	dist + prefix as f64 * 0.1 * (1.0 - dist)
+}
+
+fn levenshtein(a: &[u8], b: &[u8]) -> usize {
+	if a.is_empty() {
+		return b.len();
+	}
+	let mut row: Vec<usize> = (0..=b.len()).collect();
+	for (i, &ca) in a.iter().enumerate() {
+		let mut diag = row[0];
+		row[0] = i + 1;
+		for (j, &cb) in b.iter().enumerate() {
+			let above = row[j + 1];
+			row[j + 1] = (above + 1).min(row[j] + 1).min(diag + (ca != cb) as usize);
+			diag = above;
+		}
+	}
+	row[b.len()]
+}
+
+impl SymbolIndex {
+	pub fn new<'a>(names: impl Iterator<Item = &'a [u8]>) -> Self {
+		let mut index = SymbolIndex { names: Vec::new(), gram_counts: Vec::new(), postings: HashMap::new() };
+		for (id, name) in names.enumerate() {
+			let name = lowercase(name);
+			let grams = trigrams(&name);
+			for &gram in &grams {
+				index.postings.entry(gram).or_default().push(id as u32);
+			}
+			index.gram_counts.push(grams.len().min(u16::MAX as usize) as u16);
+			index.names.push(name);
+		}
+		index
+	}
+
+	/// Blend of Jaro-Winkler similarity and normalized Levenshtein distance, as in Hash#suggest_similar_key
+	fn score(query: &[u8], name: &[u8], jaro_weight: f64) -> f64 {
+		let lev = 1.0 - (levenshtein(query, name) as f64 / query.len().max(1) as f64).min(1.0);
+		jaro_winkler(query, name) * jaro_weight + lev * (1.0 - jaro_weight)
+	}
+
+	/// Up to max (name index, score) pairs, best first
+	pub fn suggest(&self, query: &[u8], max: usize, jaro_weight: f64) -> Vec<(u32, f64)> {
+		let query = lowercase(query);
+		let grams = trigrams(&query);
+		let lists: Vec<&[u32]> = grams.iter().filter_map(|g| self.postings.get(g).map(|p| p.as_slice())).collect();
+		let stop_len = self.names.len() / STOP_GRAM_RATIO;
+		let selective: Vec<&[u32]> = lists.iter().copied().filter(|p| p.len() <= stop_len).collect();
+		let lists = if selective.is_empty() { lists } else { selective };
+
+		let mut shared = vec![0u16; self.names.len()];
+		let mut touched = Vec::new();
+		for list in lists {
+			for &id in list {
+				if shared[id as usize] == 0 {
+					touched.push(id);
+				}
+				shared[id as usize] += 1;
+			}
+		}
+
+		// Dice coefficient over trigram sets picks the candidates worth scoring properly
+		let dice = |id: u32| 2.0 * shared[id as usize] as f64 / (grams.len() + self.gram_counts[id as usize] as usize) as f64;
+		if touched.len() > CANDIDATE_COUNT {
+			touched.select_nth_unstable_by(CANDIDATE_COUNT, |&a, &b| dice(b).total_cmp(&dice(a)));
+			touched.truncate(CANDIDATE_COUNT);
+		}
+
+		let mut scored: Vec<(u32, f64)> = touched.into_iter()
+			.map(|id| (id, Self::score(&query, &self.names[id as usize], jaro_weight)))
+			.collect();
+		scored.sort_unstable_by(|a, b| b.1.total_cmp(&a.1).then(a.0.cmp(&b.0)));
+		scored.truncate(max);
+		scored
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn symbol_index_new(names: *const *const c_char, count: u32) -> *mut SymbolIndex {
+	assert!(!names.is_null() || count == 0);
+	let names = if count == 0 { &[][..] } else { unsafe { slice::from_raw_parts(names, count as usize) } };
+	let index = SymbolIndex::new(names.iter().map(|&n| unsafe { CStr::from_ptr(n) }.to_bytes()));
+	Box::into_raw(Box::new(index))
+}
+
+/// Writes up to max suggestions for query into out_ids/out_scores, best first, and returns how many were written
+#[no_mangle]
+pub extern "C" fn symbol_index_suggest(index: *const SymbolIndex, query: *const c_char, max: u32, jaro_weight: f64,
+	out_ids: *mut u32, out_scores: *mut f64) -> u32
+{
+	assert!(!index.is_null() && !query.is_null());
+	let query = unsafe { CStr::from_ptr(query) }.to_bytes();
+	let found = unsafe { (&*index).suggest(query, max as usize, jaro_weight) };
+	let out_ids = unsafe { slice::from_raw_parts_mut(out_ids, found.len()) };
+	let out_scores = unsafe { slice::from_raw_parts_mut(out_scores, found.len()) };
+	for (i, (id, score)) in found.iter().enumerate() {
+		out_ids[i] = *id;
+		out_scores[i] = *score;
+	}
+	found.len() as u32
+}
+
+#[no_mangle]
+pub extern "C" fn free_symbol_index(index: *mut SymbolIndex) {
+	if !index.is_null() {
+		unsafe { drop(Box::from_raw(index)); }
+	}
+}
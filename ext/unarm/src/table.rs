@@ -0,0 +1,285 @@
+use unarm::arm;
+use unarm::thumb;
+use unarm::args::*;
+use unarm::ParseFlags;
+
+use std::slice;
+
+use crate::{op, ARM7_PARSE_FLAGS, ARM9_PARSE_FLAGS, REG_PC, REG_SP};
+
+pub const INS_CONDITIONAL: u8 = 1 << 0;
+pub const INS_DATA_OP: u8 = 1 << 1;
+pub const INS_SETS_FLAGS: u8 = 1 << 2;
+pub const INS_FUNCTION_END: u8 = 1 << 3;
+pub const INS_BRANCH_TO_REG: u8 = 1 << 4;
+pub const INS_ILLEGAL: u8 = 1 << 5;
+pub const INS_HAS_BRANCH_DEST: u8 = 1 << 6;
+pub const INS_HAS_TARGET: u8 = 1 << 7;
+
+/// Index into UnarmBind::CONDITION of the always condition
+pub const COND_AL: u8 = 15;
+
+const PAGE_INS_COUNT: usize = 1024;
+
+/// The fields of one decoded instruction, as handed to Ruby
+#[derive(Default, Clone, Copy, PartialEq, Eq, Debug)]
+#[repr(C)]
+pub struct DecodedIns {
+	pub opcode: u16,
+	pub cond: u8,
+	pub flags: u8,
+	pub branch_dest: u32,
+	pub target_addr: u32, // address of the literal loaded by a pc-relative ldr
+}
+
+fn reg_of(arg: &Argument) -> Option<u8> {
+	match arg {
+		Argument::Reg(r) => Some(r.reg as u8),
+		_ => None,
+	}
+}
+
+fn reg_list_has_pc(arg: &Argument) -> bool {
+	match arg {
+		Argument::RegList(l) => l.regs & (1 << REG_PC) != 0,
+		_ => false,
+	}
+}
+
+fn arm_condition(code: u32) -> u8 {
+	let cond = (code >> 28) as u8;
+	if cond < 15 { cond + 1 } else { COND_AL }
+}
+
+fn thumb_condition(code: u32) -> u8 {
+	let cond = ((code >> 8) & 0xF) as u8;
+	if code & 0xF000 == 0xD000 && cond < 14 { cond + 1 } else { COND_AL }
+}
+
+/// Decodes the fields that instruction queries need, following the rules of Unarm::Ins in Ruby
+pub fn decode(opcode: u16, args: &[Argument], code: u32, addr: u32, thumb: bool, conditional: bool, data_op: bool, sets_flags: bool) -> DecodedIns {
+	let mut ins = DecodedIns {
+		opcode,
+		cond: if thumb { thumb_condition(code) } else { arm_condition(code) },
+		flags: 0,
+		branch_dest: 0,
+		target_addr: 0,
+	};
+
+	if conditional { ins.flags |= INS_CONDITIONAL; }
+	if data_op { ins.flags |= INS_DATA_OP; }
+	if sets_flags { ins.flags |= INS_SETS_FLAGS; }
+	if opcode == op::ILLEGAL { ins.flags |= INS_ILLEGAL; }
+
+	if let Some(Argument::BranchDest(dest)) = args.iter().find(|a| matches!(a, Argument::BranchDest(_))) {
+		ins.branch_dest = addr.wrapping_add(*dest as u32);
+		ins.flags |= INS_HAS_BRANCH_DEST;
+	}
+
+	if opcode == op::LDR && reg_of(&args[1]) == Some(REG_PC) {
+		if let Argument::OffsetImm(offset) = args[2] {
+			let pc = if thumb { (addr + 4) & !3 } else { addr + 8 };
+			ins.target_addr = pc.wrapping_add(offset.value as u32);
+			ins.flags |= INS_HAS_TARGET;
+		}
+	}
+
+	let branch_to_reg = opcode == op::BX
+		|| (op::is_mov(opcode) && reg_of(&args[0]) == Some(REG_PC))
+		|| (opcode == op::LDR && reg_of(&args[0]) == Some(REG_PC));
+	if branch_to_reg { ins.flags |= INS_BRANCH_TO_REG; }
+
+	if !conditional && (branch_to_reg
+		|| (op::is_pop(opcode) && reg_list_has_pc(&args[0]))
+		|| (op::is_ldm(opcode) && reg_of(&args[0]) == Some(REG_SP) && reg_list_has_pc(&args[1])))
+	{
+		ins.flags |= INS_FUNCTION_END;
+	}
+
+	ins
+}
+
+pub fn decode_arm(code: u32, addr: u32, flags: &ParseFlags) -> DecodedIns {
+	let ins = arm::Ins::new(code, flags);
+	let parsed = ins.parse(flags);
+	decode(ins.op as u16, &parsed.args, code, addr, false, ins.is_conditional(), ins.is_data_operation(), ins.updates_condition_flags())
+}
+
+pub fn decode_thumb(code: u32, addr: u32, flags: &ParseFlags) -> DecodedIns {
+	let ins = thumb::Ins::new(code, flags);
+	let parsed = ins.parse(flags);
+	decode(ins.op as u16, &parsed.args, code, addr, true, ins.is_conditional(), ins.is_data_operation(), ins.updates_condition_flags())
+}
+
+/// Decoded instructions of one code region stored as columns, filled a page at a time on first access. The region
+/// belongs to a code binary that may be patched between accesses, so it is only borrowed for the duration of each
+/// read, and its owner invalidates the table whenever it is written to
+pub struct DecodedTable {
+	data: *const u8,
+	size: usize,
+	addr: u32,
+	thumb: bool,
+	flags: ParseFlags,
+	pages: Vec<bool>,
+	opcode: Vec<u16>,
+	cond: Vec<u8>,
+	ins_flags: Vec<u8>,
+	branch_dest: Vec<u32>,
+	target_addr: Vec<u32>,
+}
+
+impl DecodedTable {
+	/// The region must outlive the table
+	pub unsafe fn new(data: *const u8, size: usize, addr: u32, thumb: bool, arm7: bool) -> Self {
+		let count = size / if thumb { 2 } else { 4 };
+		DecodedTable {
+			data,
+			size,
+			addr,
+			thumb,
+			flags: if arm7 { ARM7_PARSE_FLAGS } else { ARM9_PARSE_FLAGS },
+			pages: vec![false; count.div_ceil(PAGE_INS_COUNT)],
+			opcode: vec![0; count],
+			cond: vec![0; count],
+			ins_flags: vec![0; count],
+			branch_dest: vec![0; count],
+			target_addr: vec![0; count],
+		}
+	}
+
+	pub fn ins_size(&self) -> u32 {
+		if self.thumb { 2 } else { 4 }
+	}
+
+	pub fn len(&self) -> usize {
+		self.opcode.len()
+	}
+
+	pub fn index_of(&self, addr: u32) -> Option<usize> {
+		let offset = addr.checked_sub(self.addr)?;
+		if offset % self.ins_size() != 0 {
+			return None;
+		}
+		let index = (offset / self.ins_size()) as usize;
+		(index < self.len()).then_some(index)
+	}
+
+	pub fn addr_of(&self, index: usize) -> u32 {
+		self.addr + index as u32 * self.ins_size()
+	}
+
+	pub fn code_at(&self, index: usize) -> u32 {
+		let data = unsafe { slice::from_raw_parts(self.data, self.size) };
+		if self.thumb {
+			u16::from_le_bytes([data[index * 2], data[index * 2 + 1]]) as u32
+		} else {
+			let i = index * 4;
+			u32::from_le_bytes([data[i], data[i + 1], data[i + 2], data[i + 3]])
+		}
+	}
+
+	pub fn invalidate(&mut self) {
+		self.pages.iter_mut().for_each(|p| *p = false);
+	}
+
+	fn ensure_page(&mut self, page: usize) {
+		if self.pages[page] {
+			return;
+		}
+		let start = page * PAGE_INS_COUNT;
+		let end = (start + PAGE_INS_COUNT).min(self.len());
+		for i in start..end {
+			let code = self.code_at(i);
+			let addr = self.addr_of(i);
+			let ins = if self.thumb { decode_thumb(code, addr, &self.flags) } else { decode_arm(code, addr, &self.flags) };
+			self.opcode[i] = ins.opcode;
+			self.cond[i] = ins.cond;
+			self.ins_flags[i] = ins.flags;
+			self.branch_dest[i] = ins.branch_dest;
+			self.target_addr[i] = ins.target_addr;
+		}
+		self.pages[page] = true;
+	}
+
+	pub fn get(&mut self, index: usize) -> DecodedIns {
+		self.ensure_page(index / PAGE_INS_COUNT);
+		DecodedIns {
+			opcode: self.opcode[index],
+			cond: self.cond[index],
+			flags: self.ins_flags[index],
+			branch_dest: self.branch_dest[index],
+			target_addr: self.target_addr[index],
+		}
+	}
+
+	pub fn flags(&mut self, index: usize) -> u8 {
+		self.ensure_page(index / PAGE_INS_COUNT);
+		self.ins_flags[index]
+	}
+}
+
+#[no_mangle]
+pub extern "C" fn decoded_table_new(data: *const u8, data_size: u32, addr: u32, thumb: bool, arm7: bool) -> *mut DecodedTable {
+	assert!(!data.is_null());
+	Box::into_raw(Box::new(unsafe { DecodedTable::new(data, data_size as usize, addr, thumb, arm7) }))
+}
+
+#[no_mangle]
+pub extern "C" fn decoded_table_get(table: *mut DecodedTable, addr: u32, out: *mut DecodedIns) -> bool {
+	let table = unsafe { &mut *table };
+	match table.index_of(addr) {
+		Some(index) => {
+			unsafe { *out = table.get(index); }
+			true
+		}
+		None => false,
+	}
+}
+
+/// Finds the first branch in [start_addr, end_addr) to one of the given destinations
+#[no_mangle]
+pub extern "C" fn decoded_table_find_branch_to(table: *mut DecodedTable, start_addr: u32, end_addr: u32, dests: *const u32, dest_count: u32,
+	out_addr: *mut u32, passed_function_end: *mut bool) -> bool
+{
+	let table = unsafe { &mut *table };
+	let dests = if dests.is_null() { &[][..] } else { unsafe { slice::from_raw_parts(dests, dest_count as usize) } };
+	let Some(start) = table.index_of(start_addr) else {
+		return false;
+	};
+	let end = match table.index_of(end_addr) {
+		Some(end) => end,
+		None => table.len(),
+	};
+
+	let mut passed_end = false;
+	for i in start..end {
+		let flags = table.flags(i);
+		if flags & INS_FUNCTION_END != 0 {
+			passed_end = true;
+		}
+		if flags & INS_HAS_BRANCH_DEST != 0 && dests.contains(&table.branch_dest[i]) {
+			unsafe {
+				*out_addr = table.addr_of(i);
+				if !passed_function_end.is_null() {
+					*passed_function_end = passed_end;
+				}
+			}
+			return true;
+		}
+	}
+	false
+}
+
+#[no_mangle]
+pub extern "C" fn decoded_table_invalidate(table: *mut DecodedTable) {
+	unsafe { (&mut *table).invalidate(); }
+}
+
+#[no_mangle]
+pub extern "C" fn free_decoded_table(table: *mut DecodedTable) {
+	unsafe {
+		if !table.is_null() {
+			drop(Box::from_raw(table));
+		}
+	}
+}
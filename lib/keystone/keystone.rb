@@ -61,10 +61,37 @@ module Keystone
       encoded_bytes.pack('C*')
     end
 
+    # Assembles every instruction in one ks_asm call, returning each one's encoding. Returns nil unless each statement
+    # is certain to assemble to exactly one ins_size instruction (see single_instruction?), since otherwise the output
+    # can't be attributed to the statements it came from
+    def assemble_batch(instructions, addr: 0, ins_size: 4)
+      return [] if instructions.empty?
+      return nil unless instructions.all? { single_instruction?(it, ins_size) }
+      encoding_ptr = FFI::MemoryPointer.new(:pointer)
+      encoding_size = FFI::MemoryPointer.new(:size_t)
+      stat_count = FFI::MemoryPointer.new(:size_t)
+      safe_call(:ks_asm, @engine, instructions.join("\n"), addr, encoding_ptr, encoding_size, stat_count)
+      size = encoding_size.read(:size_t)
+      encoded = encoding_ptr.read_pointer.read_bytes(size)
+      ks_free(encoding_ptr.read_pointer)
+      return nil if size != instructions.length * ins_size || stat_count.read(:size_t) != instructions.length
+      Array.new(instructions.length) { |i| encoded.byteslice(i * ins_size, ins_size) }
+    end
+
     def set_option(ks_opt_type, value)
       safe_call(:ks_option, @engine, ks_opt_type, value)
     end
 
+    # Whether a statement is a lone instruction of a fixed width: no labels, directives, separators or comments that
+    # could make it emit nothing or several instructions, no literal pool loads, and in Thumb (ins_size 2) nothing
+    # that may take 4 bytes, like bl or a .w suffix
+    def single_instruction?(ins, ins_size)
+      ins = ins.to_s.strip
+      mnemonic = ins[/\A[a-z][a-z0-9.]*/i]
+      return false if mnemonic.nil? || ins.match?(%r{[;:=@\n]|//|/\*})
+      ins_size != 2 || !(mnemonic.downcase.start_with?('bl') || mnemonic.downcase.end_with?('.w'))
+    end
+
   private
     def safe_call(meth_sym, *args)
       err = send(meth_sym, *args)
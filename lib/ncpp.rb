@@ -2,7 +2,11 @@ require_relative 'nitro/nitro'
 require_relative 'unarm/unarm'
 require_relative 'unicorn/unicorn'
 require_relative 'keystone/keystone'
+require_relative 'ncpp/deferred'
 require_relative 'ncpp/interpreter'
+require_relative 'ncpp/target'
+require_relative 'ncpp/client'
+require_relative 'ncpp/server'
 
 require 'json'
 require 'optparse'
@@ -18,6 +22,7 @@ module NCPP
   alias $rom $clean_rom # In most cases the clean rom will be desired
 
   $emu = nil
+  $targets = nil # set in multi-target mode, with the first one active
   $arm_assembler = nil
   $thumb_assembler = nil
 
@@ -100,6 +105,7 @@ module NCPP
 
     cfg.each do |field, value|
       next unless REQUIRED_CONFIG_FIELDS.include? field.to_sym
+      next if field.to_s == 'clean_rom' && cfg['targets'] # each target has its own
       missing_fields << field if value.empty? || value.nil?
     end
 
@@ -113,7 +119,8 @@ module NCPP
     exit
   end
 
-  def self.init(cfg_path = CONFIG_FILE_PATH, verbose: true)
+  # targets: names of the targets to load in multi-target mode (all of them if nil)
+  def self.init(cfg_path = CONFIG_FILE_PATH, verbose: true, targets: nil)
 
     if !File.exist?(cfg_path)
       ncp_cfg = JSON.load_file(NCP_CONFIG_FILE_PATH)
@@ -142,16 +149,55 @@ module NCPP
     end
 
     $config = cfg
-    $clean_rom = Nitro::Rom.new(cfg['clean_rom'].gsub(/\$\{env:([^}]+)\}/) { ENV[$1] })
-    $target_rom = Nitro::Rom.new(cfg['target_rom'].gsub(/\$\{env:([^}]+)\}/) { ENV[$1]}) unless cfg['target_rom'].empty?
+    if cfg['targets'].nil?
+      $targets = nil
+      load_roms(cfg)
+      load_symbols(cfg)
+    else
+      load_targets(cfg, only: targets)
+    end
+
+    $arm_assembler = Deferred.new { Ks::Assembler.new }
+    $thumb_assembler = Deferred.new { Ks::Assembler.new(mode: Ks::KS_MODE_THUMB) }
+  end
+
+  # substitutes ${env:VAR} references in a config path
+  def self.expand_config_path(path)
+    path.gsub(/\$\{env:([^}]+)\}/) { ENV[$1] }
+  end
+
+  # The ROMs load on background threads (arm9 of the clean one included, which nearly every command reads) and are
+  # waited for on first use
+  def self.load_roms(cfg)
+    load_clean_rom(cfg)
+    load_target_rom(cfg)
+  end
 
-    Unarm.load_symbols9(cfg['symbols9'].gsub(/\$\{env:([^}]+)\}/) { ENV[$1] }) unless cfg['symbols9'].empty?
-    Unarm.load_symbols7(cfg['symbols7'].gsub(/\$\{env:([^}]+)\}/) { ENV[$1] }) unless cfg['symbols7'].empty?
+  def self.load_clean_rom(cfg)
+    clean_path = expand_config_path(cfg['clean_rom'])
+    $clean_rom = Deferred.new { Nitro::Rom.new(clean_path).tap(&:arm9) }
+    $emu = nil # created on first use by Utils.emu
+  end
+
+  def self.load_target_rom(cfg)
+    $target_rom = cfg['target_rom'].empty? ? nil : Deferred.new { Nitro::Rom.new(expand_config_path(cfg['target_rom'])) }
+  end
+
+  # Both symbol files are parsed and demangled on background threads, waited for on first use
+  def self.load_symbols(cfg)
+    symbols9, symbols7, _raw_syms = Unarm.symbol_state
+    load = ->(path) { Deferred.new { Unarm::Symbols.new(file_path: expand_config_path(path)) } }
+    symbols9 = load.(cfg['symbols9']) unless cfg['symbols9'].empty?
+    symbols7 = load.(cfg['symbols7']) unless cfg['symbols7'].empty?
+    Unarm.symbol_state = [symbols9, symbols7, {}]
+  end
 
-    $emu = Uc::Emu.new
-    $emu.load_arm9
-    $arm_assembler = Ks::Assembler.new
-    $thumb_assembler = Ks::Assembler.new(mode: Ks::KS_MODE_THUMB)
+  # Loads the ROMs and symbols of every target in one go and activates the first, whose config becomes $config
+  def self.load_targets(cfg, only: nil)
+    $emu = nil
+    $targets = Target.load_all(cfg, only: only)
+    raise 'No targets to preprocess' if $targets.empty?
+    $targets.first.activate
   end
 
   def self.uninstall(cfg_path = CONFIG_FILE_PATH)
@@ -205,111 +251,190 @@ module NCPP
     { commands: interpreter.get_new_commands, variables: interpreter.get_new_variables }
   end
 
-  def self.run(args)
-    ncpp_filename   = nil
-    config_filename = nil
-    interactive     = false
-    ncpp_script     = false
-    quiet           = false
-    debug           = false
-    show_rom_info   = false
-    safe_mode       = false
-    puritan_mode    = false
-    no_cache        = false
-    no_cache_pass   = false
-    clear_gen       = false
-
-    OptionParser.new do |opts|
-      opts.on('--run FILE', 'Specify an NCPP script file to run') do |f|
-        ncpp_filename = f
-        ncpp_script = true
+  def self.parse_options(args)
+    opts = {
+      ncpp_filename: nil, config_filename: nil, interactive: false, ncpp_script: false, quiet: false, debug: false,
+      show_rom_info: false, safe_mode: false, puritan_mode: false, no_cache: false, no_cache_pass: false,
+      clear_gen: false, server: false, stop_server: false, no_server: false, targets: nil
+    }
+
+    OptionParser.new do |o|
+      o.on('--run FILE', 'Specify an NCPP script file to run') do |f|
+        opts[:ncpp_filename] = f
+        opts[:ncpp_script] = true
       end
 
-      opts.on('--config FILE', 'Specify a config file (defaults to ncpp_config.json)') do |f|
-        config_filename = f
+      o.on('--config FILE', 'Specify a config file (defaults to ncpp_config.json)') do |f|
+        opts[:config_filename] = f
       end
 
-      opts.on('--interactive', '--repl', 'Run the Read-Eval-Print Loop interpreter') do
-        interactive = true
+      o.on('--interactive', '--repl', 'Run the Read-Eval-Print Loop interpreter') do
+        opts[:interactive] = true
       end
 
-      opts.on('-q', '--quiet', '--sybau', 'Don\'t print parsing info') do
-        quiet = true
+      o.on('-q', '--quiet', '--sybau', 'Don\'t print parsing info') do
+        opts[:quiet] = true
       end
 
-      opts.on('-d', '--debug', 'Enable debug info printing') do
-        debug = true
+      o.on('-d', '--debug', 'Enable debug info printing') do
+        opts[:debug] = true
       end
 
-      opts.on('--safe', 'Run interpreter in safe mode to disable the execution of inline Ruby code') do
-        safe_mode = true
+      o.on('--safe', 'Run interpreter in safe mode to disable the execution of inline Ruby code') do
+        opts[:safe_mode] = true
       end
 
-      opts.on('--puritanism', 'Run interpreter in puritan mode to disable the execution of impure expressions') do
-        puritan_mode = true
+      o.on('--puritanism', 'Run interpreter in puritan mode to disable the execution of impure expressions') do
+        opts[:puritan_mode] = true
       end
 
-      opts.on('--no-cache', 'Disable interpreter runtime command caching') do
-        no_cache = true
-        no_cache_pass = true
+      o.on('--no-cache', 'Disable interpreter runtime command caching, the emulation memo and the saved parse cache') do
+        opts[:no_cache] = true
+        opts[:no_cache_pass] = true
       end
 
-      opts.on('--no-cache-pass', 'Disable the passing of command cache between preprocessor interpreter instances') do
-        no_cache_pass = true
+      o.on('--no-cache-pass', 'Disable the passing of command cache between preprocessor interpreter instances') do
+        opts[:no_cache_pass] = true
       end
 
-      opts.on('--clear-gen', 'Force all preprocessed files in gen folder to be regenerated') do
-        clear_gen = true
+      o.on('--clear-gen', 'Force all preprocessed files in gen folder to be regenerated') do
+        opts[:clear_gen] = true
       end
 
-      opts.on('--show-rom-info', 'Show ROM info on startup') do
-        show_rom_info = true
+      o.on('--target NAMES', Array, 'Only preprocess these targets (comma-separated) of a multi-target config') do |t|
+        opts[:targets] = t
       end
 
-      opts.on('--remove', 'Removes NCPrePatcher from your project') do
+      o.on('--show-rom-info', 'Show ROM info on startup') do
+        opts[:show_rom_info] = true
+      end
+
+      o.on('--server', 'Keep ROMs, symbols and caches loaded, serving preprocessor runs of this project') do
+        opts[:server] = true
+      end
+
+      o.on('--stop-server', 'Stop the server of this project') do
+        opts[:stop_server] = true
+      end
+
+      o.on('--no-server', 'Preprocess in this process even if a server is running') do
+        opts[:no_server] = true
+      end
+
+      o.on('--remove', 'Removes NCPrePatcher from your project') do
         uninstall
         exit
       end
 
-      opts.on('-v', '--version', 'Show NCPrePatcher version') do
+      o.on('-v', '--version', 'Show NCPrePatcher version') do
         puts VERSION
         exit
       end
 
-      opts.on('-h', '--help', 'Show this help message') do
-        puts opts
+      o.on('-h', '--help', 'Show this help message') do
+        puts o
         exit
       end
     end.parse!(args)
 
+    opts
+  end
+
+  def self.run(args)
+    opts = parse_options(args)
+    Utils.emu_memo_enabled = !opts[:no_cache]
+
+    if opts[:stop_server]
+      puts(Client.stop ? 'Server stopped.'.green : 'No server is running.'.yellow)
+      exit
+    end
+
     ncp_project = File.exist? NCP_CONFIG_FILE_PATH
 
-    if !ncp_project && !interactive && !ncpp_script
+    if !ncp_project && !opts[:interactive] && !opts[:ncpp_script]
       puts "In preprocessor mode, NCPrePatcher must be run in a directory with an #{NCP_CONFIG_FILE_PATH.bold_red} "\
            "file."
       exit(1)
     end
 
-    if config_filename
-      init(config_filename)
+    Nitro::Rom.copy_files = opts[:server]
+
+    if opts[:config_filename]
+      init(opts[:config_filename], targets: opts[:targets])
     elsif ncp_project
-      init
+      init(targets: opts[:targets])
     end
 
-    show_rom_info($rom) if show_rom_info && !$rom.nil?
+    show_rom_info($rom) if opts[:show_rom_info] && !$rom.nil?
 
-    if ncpp_script
-      interpreter = NCPPFileInterpreter.new($config.nil? ? COMMAND_PREFIX : $config['command_prefix'], safe: safe_mode, 
-                                            no_cache: no_cache)
-      exit_code = interpreter.run(ncpp_filename, debug: debug)
+    if opts[:ncpp_script]
+      interpreter = NCPPFileInterpreter.new($config.nil? ? COMMAND_PREFIX : $config['command_prefix'],
+                                            safe: opts[:safe_mode], no_cache: opts[:no_cache])
+      exit_code = interpreter.run(opts[:ncpp_filename], debug: opts[:debug])
+      Utils.save_caches
       exit(exit_code)
     end
 
-    if interactive
-      REPL.new(safe: safe_mode, puritan: puritan_mode, no_cache: no_cache).run(debug: debug)
+    if opts[:interactive]
+      REPL.new(safe: opts[:safe_mode], puritan: opts[:puritan_mode], no_cache: opts[:no_cache]).run(debug: opts[:debug])
+      Utils.save_caches
+      exit
+    end
+
+    if opts[:server]
+      Server.new(opts[:config_filename] || CONFIG_FILE_PATH, targets: opts[:targets]).run
       exit
     end
 
+    success = preprocess_all(opts)
+    ARGV.clear
+
+    unless success
+      puts 'NCPrePatcher execution was not successful.'.bold_red
+      exit(1)
+    end
+  end
+
+  # Preprocesses the project for every loaded target (or the project alone without targets) and returns whether all
+  # runs succeeded. Every command is parsed once for all of them; each target keeps its own command caches, under its
+  # name in command_caches
+  def self.preprocess_all(opts, command_caches: {}, parse_cache: ParseCache.new)
+    if $targets.nil?
+      Utils.print_warning "--target is ignored as the config has no 'targets'" unless opts[:targets].nil?
+      return preprocess(opts, command_caches: command_caches, parse_cache: parse_cache)
+    end
+
+    root = Dir.pwd
+    targets = opts[:targets].nil? ? $targets : $targets.select { opts[:targets].include?(it.name) }
+    if targets.empty?
+      puts 'No targets to preprocess.'.bold_red
+      return false
+    end
+
+    results = targets.map do |target|
+      target.activate
+      puts "Target #{target.name} (#{target.config['gen_path']})".cyan unless opts[:quiet]
+      Dir.chdir(root) do
+        preprocess(opts, command_caches: command_caches[target.name] ||= {}, parse_cache: parse_cache)
+      end
+    end
+    results.all?
+  end
+
+  # Preprocesses every modified source file of the project and returns whether all of them were processed.
+  # command_caches maps each source entry to the command cache shared by its files; passing the same hash across
+  # runs keeps pure command results between them, as passing the same parse_cache does for parsed commands
+  def self.preprocess(opts, command_caches: {}, parse_cache: ParseCache.new)
+    quiet         = opts[:quiet]
+    debug         = opts[:debug]
+    safe_mode     = opts[:safe_mode]
+    puritan_mode  = opts[:puritan_mode]
+    no_cache      = opts[:no_cache]
+    no_cache_pass = opts[:no_cache_pass]
+    clear_gen     = opts[:clear_gen]
+
+    Utils.emu_memo_enabled = !no_cache
+
     ncp_cfg = JSON.load_file(NCP_CONFIG_FILE_PATH)
     root_dir = Pathname.new(File.dirname(NCP_CONFIG_FILE_PATH))
     code_root_dir = Pathname.new(File.dirname(ncp_cfg['arm9']['target']))
@@ -332,17 +457,22 @@ module NCPP
       timestamp_cache.delete('NCPP_VERSION')
     end
 
+    parse_cache_path = File.join($config['gen_path'], ParseCache::FILENAME)
+    parse_cache.load(parse_cache_path) unless no_cache
+
     exts = $config['source_file_types'].join(',')
   
     success           = true
     parsed_file_count = 0
     lines_parsed      = 0
+    output_count      = 0 # generated files, and of those, the ones whose contents changed
+    written_count     = 0
     start_time        = Time.now
 
     $config['sources'].each do |src|
       extra_commands  = {}
       extra_variables = {}
-      command_cache = {}
+      command_cache = command_caches[src] ||= {}
 
       defs_modified = false
 
@@ -379,6 +509,8 @@ module NCPP
 
       end
 
+      command_cache.clear if defs_modified
+
       if File.file?(src)
         files = [src]
       else
@@ -407,9 +539,9 @@ module NCPP
         timestamp_cache[file] = last_modified
         if file.end_with?('.s')
           if modified || modified.nil?
+            output_count += 1
             dest = File.join($config['gen_path'], file)
-            FileUtils.mkdir_p(File.dirname(dest))
-            FileUtils.cp(file, dest)
+            written_count += 1 if Utils.write_if_changed(dest, File.binread(file), binary: true)
           end
           true
         elsif !modified && !defs_modified
@@ -420,14 +552,17 @@ module NCPP
       end
 
       parsed_file_count += files.count
+      output_count += files.count
 
       files.each do |file|
         interpreter = CFileInterpreter.new(
           file, $config['gen_path'], $config['command_prefix'], extra_commands, extra_variables,
-          safe: safe_mode, puritan: puritan_mode, no_cache: no_cache, cmd_cache: no_cache_pass ? {} : command_cache
+          safe: safe_mode, puritan: puritan_mode, no_cache: no_cache, cmd_cache: no_cache_pass ? {} : command_cache,
+          parse_cache: parse_cache
         )
         interpreter.run(verbose: !quiet, debug: debug)
         lines_parsed += interpreter.lines_parsed
+        written_count += interpreter.written_file_count
 
         command_cache.merge!(interpreter.get_cacheable_cache) unless no_cache_pass
 
@@ -443,11 +578,14 @@ module NCPP
 
     FileUtils.mkdir_p(File.dirname(timestamp_cache_path))
     File.write(timestamp_cache_path, JSON.generate(timestamp_cache))
+    parse_cache.save(parse_cache_path) unless no_cache
+    Utils.save_caches
 
     unless quiet
       if lines_parsed > 0
         msg = "\nParsed #{lines_parsed} line#{'s' if lines_parsed != 1} across " \
               "#{parsed_file_count} file#{'s' if parsed_file_count != 1}."
+        msg += " Updated #{written_count} of #{output_count} generated file#{'s' if output_count != 1}."
         puts (success ? msg.green : msg.yellow)
         if success
           puts "Took ".green + String(Time.now - start_time).underline_green + " seconds.".green
@@ -460,13 +598,7 @@ module NCPP
     end
 
     puts
-    ARGV.clear
-
-    unless success
-      puts 'NCPrePatcher execution was not successful.'.bold_red
-      exit(1)
-    end
-
+    success
   end
 
 end
@@ -0,0 +1,73 @@
+require 'socket'
+require 'json'
+require 'tmpdir'
+require 'digest'
+
+module NCPP
+
+  # Thin client handing preprocessor runs to a server started with `ncpp --server` in the same project directory.
+  # Only needs the standard library, so it starts without loading any of the native libraries
+  module Client
+    EXIT_MARKER = "\0" # ends a run's output, followed by its exit code
+
+    # flags that only make sense in the process they're given to
+    LOCAL_FLAGS = %w[--server --stop-server --no-server --run --interactive --repl --remove -v --version -h --help].freeze
+
+    # Holds the sockets of every server the user runs; created by the server with no access for other users
+    def self.socket_dir
+      File.join(Dir.tmpdir, "ncpp-#{Process.uid}")
+    end
+
+    def self.socket_path(dir = Dir.pwd)
+      File.join(socket_dir, "#{Digest::SHA1.hexdigest(File.expand_path(dir))[0, 16]}.sock")
+    end
+
+    # Whether a server of this project could take a run with the given arguments
+    def self.forwardable?(args)
+      defined?(UNIXSocket) && File.socket?(socket_path) && args.none? { LOCAL_FLAGS.include?(it.split('=').first) }
+    end
+
+    def self.connect
+      UNIXSocket.new(socket_path).tap(&:binmode)
+    rescue SystemCallError
+      nil
+    end
+
+    # Runs the preprocessor on the server, echoing its output as it comes
+    # Returns the run's exit code, or nil if no server answered
+    def self.run(args)
+      sock = connect or return nil
+      begin
+        sock.puts(JSON.generate({ args: args }))
+        out = String.new(encoding: Encoding::BINARY)
+        while (chunk = read_chunk(sock))
+          out << chunk
+          marker = out.index(EXIT_MARKER)
+          $stdout.write(marker ? out.slice!(0...marker) : out.slice!(0..))
+        end
+        $stdout.flush
+        out.start_with?(EXIT_MARKER) ? (Integer(out[1..].strip, exception: false) || 1) : 1
+      ensure
+        sock.close
+      end
+    end
+
+    # Asks the server to shut down; returns whether one was running
+    def self.stop
+      sock = connect or return false
+      sock.puts(JSON.generate({ stop: true }))
+      nil while read_chunk(sock)
+      sock.close
+      true
+    end
+
+    def self.read_chunk(sock)
+      sock.readpartial(1 << 14)
+    rescue EOFError, SystemCallError
+      nil
+    end
+    private_class_method :read_chunk
+
+  end
+
+end
@@ -666,7 +666,8 @@ module NCPP
     sym_to_addr: ->(sym) { Utils.sym_to_addr(sym) }.returns(Integer),
     get_sym_ov: ->(sym) { Utils.get_sym_ov(sym) }.returns(Integer),
     sym_from_index: ->(idx) { Unarm.sym_map.to_a[idx][0] }.returns(String),
-    demangle: ->(sym) { Unarm.shitty_demangle(sym) }.returns(String),
+    demangle: ->(sym) { Unarm.demangle(sym) }.returns(String),
+    demangle_full: ->(sym) { Unarm.demangle(sym, full: true) }.returns(String),
 
     get_function: ->(addr,ov=nil) { Utils.get_reloc_func(addr, ov) }.returns(String),
     get_instruction: ->(addr,ov=nil) { Utils.get_instruction(addr, ov) }.returns(String),
@@ -684,12 +685,36 @@ module NCPP
     get_chars: ->(addr,ov, char_count) { Utils.get_array(addr,ov,Utils::DTYPE_IDS[:u8],char_count).map { it.chr } }
       .returns(Array),
 
-    get_c_array: ->(addr,ov,e_type_id,e_count=1) {
-      Utils.to_c_array(Utils.get_array(addr,ov,e_type_id,e_count))
-    }.returns(Array),
+    get_c_array: ->(addr,ov,e_type_id,e_count=1) { Utils.get_c_table(addr,ov,e_type_id,e_count) }.returns(String),
+
+    get_c_table: ->(addr,ov, type, count, format='dec', per_line=0) {
+      Utils.get_c_table(addr,ov, type, count, format, per_line)
+    }.returns(String)
+      .describe("Gets a table as a C initializer, formatted natively. The type is a type ID or name (e.g. 'u16'), or " \
+                "an array of them for a table of structs (aligned like C structs). The format can hold 'hex' or " \
+                "'dec' (the default) and 'packed' (struct fields without padding); per_line breaks the lines."),
 
     get_byte_str: ->(loc,ov,size) { Utils.get_byte_str(loc,ov,size) }.returns(String),
 
+    get_file_size: ->(file) { Utils.get_rom_file(file).size }.returns(Integer)
+      .describe("Gets the size of a file of the ROM's filesystem, given by ID or path. Paths can continue into NARC " \
+                "archives, naming their files by path or ID (e.g. 'a/0/1/6/3'), which are read uncompressed."),
+    get_file_dword: ->(file,offset) { Utils.get_rom_file(file).read64(offset) }.returns(Integer),
+    get_file_word:  ->(file,offset) { Utils.get_rom_file(file).read32(offset) }.returns(Integer),
+    get_file_hword: ->(file,offset) { Utils.get_rom_file(file).read16(offset) }.returns(Integer),
+    get_file_byte:  ->(file,offset) { Utils.get_rom_file(file).read8(offset) }.returns(Integer),
+    get_file_array: ->(file,offset,e_type_id,e_count=1) {
+      Utils.get_file_array(file,offset,e_type_id,e_count)
+    }.returns(Array),
+    get_file_c_array: ->(file,offset,e_type_id,e_count=1) {
+      Utils.get_file_c_table(file,offset,e_type_id,e_count)
+    }.returns(String),
+    get_file_c_table: ->(file,offset, type, count, format='dec', per_line=0) {
+      Utils.get_file_c_table(file,offset, type, count, format, per_line)
+    }.returns(String)
+      .describe("Gets a table in a file of the ROM's filesystem as a C initializer (see get_c_table)."),
+    get_narc_file_count: ->(file) { Utils.get_rom_file(file).narc.file_count }.returns(Integer),
+
     find_first_branch_to: ->(branch_dest, start_loc,start_ov=nil) {
       Utils.find_branch_to(branch_dest, start_loc,start_ov)
     }.returns(Integer),
@@ -712,10 +737,48 @@ module NCPP
 
     track_reg: ->(reg, from_addr,ov, to_addr) { Utils.track_reg(reg, from_addr,ov, to_addr) }.returns(String),
 
+    get_reg_value: ->(reg, loc,ov=nil) { Utils.get_reg_value(reg, loc,ov) }.returns(Integer)
+      .describe('Gets the constant value a register holds right before the instruction at the given address, ' \
+                'propagated through its function from immediates, literal pool loads and arithmetic.'),
+
+    get_call_args: ->(loc,ov=nil, count=4) { Utils.get_call_args(loc,ov, count) }.returns(Array)
+      .describe('Gets the values of r0-r3 (or the given number of registers) right before the instruction at the ' \
+                'given address, e.g. a call; registers not holding a known constant are nil.'),
+
     find_ins_in_func: ->(ins_pattern_str, func_loc,func_ov=nil) {
       Utils.find_ins_in_func(ins_pattern_str,func_loc,func_ov)
     }.returns(Integer),
 
+    find_ins: ->(ins_pattern_str, ov=nil) { Utils.find_ins(ins_pattern_str, ov) }.returns(Integer)
+      .describe("Finds the first instruction matching a structured pattern in arm9, arm7 (ov -2) or an overlay, " \
+                "e.g. 'ldr _ pc value=0x02001234' or 'mov r0 imm=5'. A pattern is an opcode or '*', the registers " \
+                "of the operands in order ('_' for any) and fields: imm, dest, target, value, cond, mode and reg. " \
+                "The address has its lowest bit set if the instruction is Thumb."),
+
+    find_all_ins: ->(ins_pattern_str, ov=nil) { Utils.find_ins(ins_pattern_str, ov, find_all: true) }.returns(Array)
+      .describe('Finds every instruction matching a structured pattern (see find_ins) in the given binary.'),
+
+    find_pointers_to: ->(loc, size=nil) { Utils.find_pointers([Utils.pointer_range(loc, size)])[0] }.returns(Array)
+      .describe('Finds every word in arm9, arm7 and the overlays pointing to the given address or symbol (with or ' \
+                'without the Thumb bit), or into the size bytes from it. Each hit is [address, overlay (-1 for ' \
+                'arm9, -2 for arm7), value, address of the function containing it or nil].'),
+
+    find_pointers_to_ranges: ->(ranges) {
+      Utils.find_pointers(ranges.map { |loc, size| Utils.pointer_range(loc, size) })[0]
+    }.returns(Array)
+      .describe('Finds every word in arm9, arm7 and the overlays pointing into any of the given [address, size] ' \
+                'ranges; see find_pointers_to.'),
+
+    find_file_pointers_to: ->(loc, size=nil) {
+      Utils.find_pointers([Utils.pointer_range(loc, size)], files: true)[1]
+    }.returns(Array)
+      .describe("Finds every word in the files of the ROM's filesystem (other than overlays) pointing to the given " \
+                'address or into the size bytes from it. Each hit is [file ID, offset, value].'),
+
+    find_all_ins_anywhere: ->(ins_pattern_str) { Utils.find_ins_anywhere(ins_pattern_str) }.returns(Array)
+      .describe('Finds every instruction matching a structured pattern (see find_ins) in arm9, arm7 and every ' \
+                'overlay, as an Array of [address, overlay] pairs, where the overlay is -1 for arm9 and -2 for arm7.'),
+
     get_ins_mnemonic: ->(loc,ov=nil) { Utils.get_ins_mnemonic(loc,ov) }.returns(String),
     get_ins_arg: ->(loc,ov,arg_index) { Utils.get_ins_arg(loc,ov,arg_index) }.returns(String),
     get_ins_branch_dest: ->(loc,ov=nil) { Utils.get_ins_branch_dest(loc,ov) }.returns(Integer),
@@ -737,6 +800,10 @@ module NCPP
     get_function_size: ->(loc,ov=nil) { Utils.get_function_size(loc,ov) }.returns(Integer)
       .describe('Gets the size of the function at the given location. Includes the literal pool.'),
 
+    get_containing_function: ->(loc,ov=nil) { Utils.get_containing_function(loc,ov) }.returns(Integer)
+      .describe('Gets the address of the function whose code or literal pool contains the given location. The ' \
+                'address has its lowest bit set if the function is Thumb.'),
+
     disasm_arm_ins: ->(data) { Utils.disasm_arm_ins(data) }.returns(String),
     disasm_thumb_ins: ->(data) { Utils.disasm_thumb_ins(data) }.returns(String),
 
@@ -831,12 +898,12 @@ module NCPP
     unpack_s8_array: ->(byte_str) { byte_str.unpack('c*') }.returns(Array),
 
     emulate_func: ->(loc,ov,*args) { Utils.emulate_func(loc,ov,*args) }.returns(Object).impure,
-    emu_get_reg: ->(reg_s) { $emu.read_reg(reg_s.to_sym) }.returns(Integer).impure,
-    emu_set_reg: ->(reg_s,val) { $emu.write_reg(reg_s.to_sym,val) }.impure,
+    emu_get_reg: ->(reg_s) { Utils.emu.read_reg(reg_s.to_sym) }.returns(Integer).impure,
+    emu_set_reg: ->(reg_s,val) { Utils.emu.write_reg(reg_s.to_sym,val) }.impure,
     emu_get_mem: ->(loc,size) { Utils.emu_get_mem(loc,size) }.returns(String).impure,
     emu_set_mem: ->(loc,byte_str) { Utils.emu_set_mem(loc,byte_str) }.impure,
-    emu_load_ov: ->(ov_id) { $emu.load_overlay(ov_id) }.impure,
-    emu_reset: -> { $emu = Uc::Emu.new(); $emu.load_arm9 }.impure,
+    emu_load_ov: ->(ov_id) { Utils.emu.load_overlay(ov_id) }.impure,
+    emu_reset: -> { $emu = nil }.impure,
 
     assemble_arm: ->(asm,addr=0) { Utils.assemble_arm(asm,addr:addr) }.returns(Integer),
     assemble_thumb: ->(asm,addr=0) { Utils.assemble_thumb(asm,addr:addr) }.returns(Integer),
@@ -917,6 +984,7 @@ module NCPP
     get_func_literal_pool_addrs:  :get_function_literal_pool_addresses,
     get_func_lit_pool_addrs:      :get_function_literal_pool_addresses,
     get_func_size:                :get_function_size,
+    get_containing_func:          :get_containing_function,
     get_ins_load_addr:            :get_ins_target_addr,
     is_addr_in_overlay:           :is_address_in_overlay,
     is_addr_in_ov:                :is_address_in_overlay,
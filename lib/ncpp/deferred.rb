@@ -0,0 +1,25 @@
+module NCPP
+
+  #
+  # A value computed on a background thread, standing in for it until it's first used: any call waits for the thread
+  # and is forwarded to the result, and an error raised while computing it is raised again there. Startup hands out
+  # these for the ROMs, symbols and assemblers so their loading overlaps instead of adding up
+  #
+  class Deferred < BasicObject
+
+    def initialize(&block)
+      @thread = ::Thread.new(&block)
+      @thread.report_on_exception = false
+    end
+
+    # Waits for the value; Thread#value keeps it, so this only blocks the first time
+    def __value__ = @thread.value
+
+    def ==(other) = __value__ == other
+    def !         = !__value__
+
+    def method_missing(name, ...) = __value__.__send__(name, ...)
+
+  end
+
+end
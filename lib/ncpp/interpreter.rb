@@ -179,7 +179,7 @@ module NCPP
       {
         SYMBOL_COUNT: Unarm.symbols.count,
         SYMBOL_NAMES: Unarm.symbols.map.keys, # TODO: how should I handle ARM7 ??
-        DEMANGLED_SYMBOL_NAMES: Unarm.symbols.demangled_map.keys,
+        DEMANGLED_SYMBOL_NAMES: Unarm.symbols.demangled.values.map(&:last).uniq,
         OVERLAY_COUNT: $rom.overlay_count,
         GAME_TITLE: $rom.header.game_title,
         NITRO_SDK_VERSION: $rom.nitro_sdk_version
@@ -188,10 +188,11 @@ module NCPP
     end
 
     def initialize(cmd_prefix = COMMAND_PREFIX, extra_cmds = {}, extra_vars = {}, safe: false, puritan: false, 
-                   no_cache: false, cmd_cache: {})
+                   no_cache: false, cmd_cache: {}, parse_cache: nil)
 
       @parser = Parser.new(cmd_prefix: cmd_prefix)
       @transformer = Transformer.new
+      @parse_cache = parse_cache
 
       @COMMAND_PREFIX = cmd_prefix
 
@@ -295,7 +296,10 @@ module NCPP
     # Evaluates the given AST
     def eval_expr(node, subs = nil)
       case node
-      when Numeric, String, Array, TrueClass, FalseClass, NilClass
+      when String
+        +node # literals from the parse cache are frozen and shared, so commands get a copy they can modify
+
+      when Numeric, Array, TrueClass, FalseClass, NilClass
         node
 
       when Hash
@@ -476,19 +480,21 @@ module NCPP
   # Scans C/C++ source files for commands and expands them in place
   #
   class CFileInterpreter < Interpreter
-    attr_reader :lines_parsed, :incomplete_files
+    attr_reader :lines_parsed, :incomplete_files, :written_file_count
 
     def initialize(file_list, out_path, cmd_prefix = COMMAND_PREFIX, extra_cmds = {}, extra_vars = {}, template_args=[],
-                    safe: false, puritan: false, no_cache: false, cmd_cache: {})
+                    safe: false, puritan: false, no_cache: false, cmd_cache: {}, parse_cache: nil)
 
       @EXTRA_CMDS, @EXTRA_VARS = extra_cmds, extra_vars
-      super(cmd_prefix, extra_cmds, extra_vars, safe: safe, puritan: puritan, no_cache: no_cache, cmd_cache: cmd_cache)
+      super(cmd_prefix, extra_cmds, extra_vars, safe: safe, puritan: puritan, no_cache: no_cache, cmd_cache: cmd_cache,
+            parse_cache: parse_cache)
 
       @file_list = file_list.is_a?(Array) ? file_list : [file_list]
       @current_file = nil
       @out_path = out_path
 
       @incomplete_files = []
+      @written_file_count = 0
 
       @lines_parsed = 0
 
@@ -545,7 +551,8 @@ module NCPP
           .describe('Reads the file specified and returns an Array containing each byte.'),
 
         import: ->(template_file, *arg_vals) {
-          t_interpreter = CFileInterpreter.new(nil,nil,@COMMAND_PREFIX,@EXTRA_CMDS,@EXTRA_VARS,[*arg_vals])
+          t_interpreter = CFileInterpreter.new(nil,nil,@COMMAND_PREFIX,@EXTRA_CMDS,@EXTRA_VARS,[*arg_vals],
+                                               parse_cache: @parse_cache)
           dir = File.dirname(@current_file || Dir.pwd)
           path = File.expand_path(template_file, dir)
           ret, _, t_args = t_interpreter.process_file(path)
@@ -617,9 +624,7 @@ module NCPP
 
         @incomplete_files << file unless success
 
-        new_file_path = @out_path + '/' + file
-        FileUtils.mkdir_p(File.dirname(new_file_path))
-        File.write(new_file_path, out)
+        @written_file_count += 1 if Utils.write_if_changed(@out_path + '/' + file, out)
       end
     end
 
@@ -674,17 +679,7 @@ module NCPP
               (cursor == 0 || !/[0-9A-Za-z_]/.match?(line[cursor-1]))
             expr_src = line[(cursor + @COMMAND_PREFIX.length)..]
             begin
-              tree    = @parser.parse(expr_src)
-              rtree_s = tree.to_s.reverse
-
-              # finds the end of the expression (hacky)
-              expr_end = /\d+/.match(rtree_s[..rtree_s.index('__last_char__: '.reverse)].reverse).to_s
-              if expr_end.empty?
-                raise 'Could not find an end to expression on line; multi-line expressions are not yet supported'
-              end
-              last_paren = Integer(expr_end) + 1
-
-              ast = @transformer.apply(tree)
+              ast, last_paren = parse_command(expr_src)
               value = eval_expr(ast)
               @out_stack << value.to_s unless value.nil?
               new_line << @out_stack.join("\n") unless @out_stack.empty?
@@ -721,6 +716,38 @@ module NCPP
       end
       [output, success, @template_args]
     end
+
+  private
+
+    # Parses the command at the start of src, through the parse cache if there is one; returns the AST and how many
+    # characters of src the command spans
+    def parse_command(src)
+      entry =
+        if @parse_cache.nil?
+          parse_command_uncached(src)
+        else
+          @parse_cache.fetch(@COMMAND_PREFIX, src) { parse_command_uncached(src) }
+        end
+      raise entry if entry.is_a?(Exception)
+      entry
+    end
+
+    # Parse failures are returned rather than raised, so they can be cached too
+    def parse_command_uncached(src)
+      tree    = @parser.parse(src)
+      rtree_s = tree.to_s.reverse
+
+      # finds the end of the expression (hacky)
+      expr_end = /\d+/.match(rtree_s[..rtree_s.index('__last_char__: '.reverse)].reverse).to_s
+      if expr_end.empty?
+        return RuntimeError.new('Could not find an end to expression on line; multi-line expressions are not yet '\
+                                'supported')
+      end
+
+      [@transformer.apply(tree), Integer(expr_end) + 1]
+    rescue Parslet::ParseFailed => e
+      e
+    end
   end
 
   class ASMFileInterpreter < Interpreter
@@ -787,7 +814,8 @@ module NCPP
           .describe('Reads the file specified and returns an Array containing each byte.'),
 
         import: ->(template_file, *arg_vals) {
-          t_interpreter = CFileInterpreter.new(nil,nil,@COMMAND_PREFIX,@EXTRA_CMDS,@EXTRA_VARS,[*arg_vals])
+          t_interpreter = CFileInterpreter.new(nil,nil,@COMMAND_PREFIX,@EXTRA_CMDS,@EXTRA_VARS,[*arg_vals],
+                                               parse_cache: @parse_cache)
           ret, _, t_args = t_interpreter.process_file(template_file)
           if t_args.length > 0
             puts "WARNING".underline_yellow + ': '.yellow + "#{t_args.length} template arg#{'s' if t_args.length != 1}"\
@@ -1,4 +1,5 @@
 require 'parslet'
+require 'digest'
 
 module NCPP
 
@@ -246,4 +247,86 @@ module NCPP
 
   end
 
+  #
+  # Commands parsed from source lines, shared by the interpreters of a run (and kept by a server between runs) so that
+  # a command is only parsed once however many files or targets evaluate it. Entries are frozen since they're shared.
+  # Successful parses are also saved next to the timestamp cache, so later runs only parse the commands they haven't
+  # seen before
+  #
+  class ParseCache
+    MAX_ENTRIES = 1 << 16
+    FILENAME = 'parse_cache.bin'
+
+    # Saved entries are only reused by the same grammar and transformer (this file) and the same command parsing,
+    # which works out the source length stored with each AST (interpreter.rb)
+    def self.version
+      @version ||= begin
+        sources = [__FILE__, File.join(__dir__, 'interpreter.rb')].map { File.binread(it) }
+        Digest::SHA1.hexdigest([NCPP::VERSION, *sources].join(':'))
+      end
+    end
+
+    def initialize
+      @entries = {}
+      @revision = 0         # bumped on every new entry
+      @saved_revisions = {} # path => revision it was last loaded from or saved at
+    end
+
+    # The [ast, source length] or parse error cached for the command at the start of src, computing it with the
+    # block if missing
+    def fetch(cmd_prefix, src)
+      key = [cmd_prefix, src]
+      @entries.fetch(key) do
+        @entries.clear if @entries.length >= MAX_ENTRIES
+        @revision += 1
+        @entries[key] = deep_freeze(plain(yield))
+      end
+    end
+
+    def clear = @entries.clear
+
+    # Adds the entries saved at path by a run of the same parser, once per path
+    def load(path)
+      return if @saved_revisions.key?(path)
+      saved = File.exist?(path) ? (Marshal.load(File.binread(path)) rescue nil) : nil
+      if saved.is_a?(Hash) && saved[:version] == ParseCache.version
+        saved[:entries].each do |key, entry|
+          break if @entries.length >= MAX_ENTRIES
+          @entries[key] ||= deep_freeze(entry)
+        end
+      end
+      @saved_revisions[path] = @revision
+    end
+
+    # Writes the successful parses to path if any were added since it was loaded or last saved
+    def save(path)
+      return if @saved_revisions[path] == @revision
+      entries = @entries.reject { |_key, entry| entry.is_a?(Exception) }
+      FileUtils.mkdir_p(File.dirname(path))
+      File.binwrite(path, Marshal.dump({ version: ParseCache.version, entries: entries }))
+      @saved_revisions[path] = @revision
+    end
+
+  private
+
+    # Parslet slices left in an AST keep the whole source they were cut from; strings are all that's needed of them
+    def plain(obj)
+      case obj
+      when Parslet::Slice then obj.to_s
+      when Hash then obj.transform_values { plain(it) }
+      when Array then obj.map { plain(it) }
+      else obj
+      end
+    end
+
+    def deep_freeze(obj)
+      case obj
+      when Exception then return obj # raised again on each hit, which sets its backtrace
+      when Hash then obj.each_value { deep_freeze(it) }
+      when Array then obj.each { deep_freeze(it) }
+      end
+      obj.frozen? ? obj : obj.freeze
+    end
+  end
+
 end
@@ -0,0 +1,179 @@
+require 'socket'
+require_relative 'client'
+
+module NCPP
+
+  # Serves preprocessor runs of one project over a Unix socket, keeping the ROMs, symbols and every cache built on them
+  # (decoded instructions, function maps, suggestion indices, command results) loaded between runs. Those are only
+  # reloaded once the contents of the config, ROM or symbol files change
+  class Server
+
+    # Expects the project to have been loaded by NCPP.init with the same config and targets
+    def initialize(cfg_path = CONFIG_FILE_PATH, targets: nil)
+      @cfg_path = cfg_path
+      @targets = targets
+      @root = Dir.pwd
+      @socket_path = Client.socket_path(@root)
+      @file_states = {} # path => { stat: [mtime, size], hash: XXH64 of contents }
+      @command_caches = {}
+      @parse_cache = ParseCache.new
+    end
+
+    def run
+      raise 'Unix domain sockets are not supported on this platform.' unless defined?(UNIXServer)
+
+      prepare_socket_dir
+      if File.socket?(@socket_path)
+        if (sock = Client.connect)
+          sock.close
+          puts 'A server is already running for this project.'.yellow
+          return
+        end
+        File.delete(@socket_path) # left behind by a server that didn't shut down cleanly
+      end
+
+      tracked_files.each_value { |paths| paths.each { changed?(it) } }
+
+      # created without any permissions for others, rather than opened up until a chmod after binding
+      umask = File.umask(0o077)
+      begin
+        server = UNIXServer.new(@socket_path)
+      ensure
+        File.umask(umask)
+      end
+      puts "Serving #{@root} (stop with 'ncpp --stop-server' or Ctrl+C)".green
+
+      loop do
+        break unless handle(server.accept)
+      end
+    rescue Interrupt
+      puts
+    ensure
+      if server
+        server.close
+        File.delete(@socket_path) if File.socket?(@socket_path)
+        Utils.save_caches
+      end
+    end
+
+  private
+
+    # The socket's directory is per user and closed to everyone else, so no one else can connect to the server or
+    # put a socket of their own in its place
+    def prepare_socket_dir
+      dir = Client.socket_dir
+      Dir.mkdir(dir, 0o700) unless File.exist?(dir)
+      stat = File.lstat(dir)
+      unless stat.directory? && stat.owned? && stat.mode & 0o077 == 0
+        raise "#{dir} must be a directory owned by you and inaccessible to other users."
+      end
+    end
+
+    # Handles one connection; returns false once asked to stop
+    def handle(client)
+      request = JSON.parse(client.gets || '{}')
+      return false if request['stop']
+
+      status = serve_run(client, Array(request['args']))
+      client.write("#{Client::EXIT_MARKER}#{status}\n")
+      true
+    rescue JSON::ParserError, SystemCallError, IOError
+      true # malformed request or the client went away
+    ensure
+      client.close
+    end
+
+    def serve_run(client, args)
+      stdout, stderr = $stdout, $stderr
+      $stdout = $stderr = client
+
+      opts = NCPP.parse_options(args)
+      if (mismatch = unserved_selection(opts))
+        puts "#{mismatch} Run with --no-server, or restart the server with them.".bold_red
+        return 1
+      end
+
+      refresh
+      # emulated memory is left however the previous run's calls wrote it, so every run starts from a fresh image
+      $targets.nil? ? $emu = nil : $targets.each(&:reset_emu)
+      success = Dir.chdir(@root) do
+        NCPP.preprocess_all(opts, command_caches: opts[:no_cache_pass] ? {} : @command_caches,
+                                  parse_cache: @parse_cache)
+      end
+      Utils.save_caches
+
+      puts 'NCPrePatcher execution was not successful.'.bold_red unless success
+      success ? 0 : 1
+    rescue SystemExit => e
+      e.status
+    rescue StandardError, ScriptError => e
+      puts e.full_message
+      1
+    ensure
+      $stdout, $stderr = stdout, stderr
+    end
+
+    # Why the server can't take a run with the config or targets given to it, as it only has the ones it was started
+    # with loaded; nil if it can
+    def unserved_selection(opts)
+      cfg_path = opts[:config_filename] || CONFIG_FILE_PATH
+      if File.expand_path(cfg_path, @root) != File.expand_path(@cfg_path, @root)
+        return "The server was started with the config #{@cfg_path}, not #{cfg_path}."
+      end
+      return nil if opts[:targets].nil? || $targets.nil?
+
+      unloaded = opts[:targets] - $targets.map(&:name)
+      "The server wasn't started with the target#{'s' if unloaded.length > 1} #{unloaded.join(', ')}." unless unloaded.empty?
+    end
+
+    # Files whose contents the loaded state comes from, across every target in multi-target mode
+    def tracked_files
+      configs = $targets.nil? ? [$config] : $targets.map(&:config)
+      paths = lambda do |*fields|
+        configs.flat_map { it.values_at(*fields) }.compact.reject(&:empty?).map { NCPP.expand_config_path(it) }.uniq
+      end
+      { config: [@cfg_path], clean_roms: paths.('clean_rom'), target_roms: paths.('target_rom'),
+        symbols: paths.('symbols9', 'symbols7') }
+    end
+
+    # Whether the contents of a file differ from when it was last checked. Files are only hashed when their
+    # modification time or size changed, so touching a file without changing it doesn't cause a reload
+    def changed?(path)
+      stat = File.stat(path) rescue nil
+      stat_key = stat && [stat.mtime, stat.size]
+      state = @file_states[path]
+      return false if state && state[:stat] == stat_key
+
+      hash = stat && Nitro.hash_file(path)
+      @file_states[path] = { stat: stat_key, hash: hash }
+      state.nil? || state[:hash] != hash
+    end
+
+    # Reloads whatever changed since the last run. Cached command results only depend on the config, clean ROMs and
+    # symbols, so they're kept when just a target ROM changed, which NCPatcher rewrites after every build
+    def refresh
+      changed = tracked_files.transform_values { |paths| paths.select { changed?(it) } }
+      return if changed.values.all?(&:empty?)
+
+      inputs_changed = !(changed[:config] + changed[:clean_roms] + changed[:symbols]).empty?
+      if !changed[:config].empty? || (!$targets.nil? && inputs_changed)
+        # targets share binaries and names, so they're reloaded together
+        NCPP.init(@cfg_path, verbose: false, targets: @targets)
+        tracked_files.each_value { |paths| paths.each { changed?(it) } } # config may point to new files
+      elsif $targets.nil?
+        NCPP.load_clean_rom($config) unless changed[:clean_roms].empty?
+        NCPP.load_target_rom($config) unless changed[:target_roms].empty?
+        NCPP.load_symbols($config) unless changed[:symbols].empty?
+      else
+        $targets.each do |target|
+          target.reload_target_rom if changed[:target_roms].include?(NCPP.expand_config_path(target.config['target_rom'].to_s))
+        end
+      end
+      @command_caches.clear if inputs_changed
+
+      puts "Reloaded #{changed.filter_map { |group, paths| group.to_s.tr('_', ' ') unless paths.empty? }.join(', ')}.".cyan
+    end
+
+  end
+
+end
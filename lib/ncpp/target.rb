@@ -0,0 +1,106 @@
+module NCPP
+
+  #
+  # One ROM region (e.g. US, EU or JP) of a project preprocessed in multi-target mode: the base config with the
+  # target's own ROMs, symbols and gen path, plus the emulator and symbol caches built on them. Only one target is
+  # active at a time; activating it binds the globals the commands work on
+  #
+  class Target
+    FIELDS = %w[clean_rom target_rom symbols9 symbols7 gen_path].freeze
+
+    attr_reader :name, :config, :clean_rom, :target_rom
+
+    class << self
+      attr_accessor :active
+    end
+
+    # Loads the targets of a config (or those named in only), reusing ROMs and symbols that are the same file,
+    # demangling each distinct symbol name once, and sharing the binaries that are identical between ROMs
+    def self.load_all(cfg, only: nil)
+      entries = cfg['targets']
+      unless entries.is_a?(Array) && entries.all? { it.is_a?(Hash) && it['name'] }
+        raise "'targets' must be an array of objects with a 'name'"
+      end
+
+      unless only.nil?
+        unknown = only - entries.map { it['name'] }
+        raise "Unknown target#{'s' if unknown.length > 1}: #{unknown.join(', ')}" unless unknown.empty?
+        entries = entries.select { only.include?(it['name']) }
+      end
+
+      roms = {}      # expanded path => Nitro::Rom, loading on a background thread until first used
+      symbols = {}   # expanded path => Unarm::Symbols
+      demangled = {} # mangled name => [full, short], across every symbol file
+
+      load_rom = lambda do |path|
+        path = NCPP.expand_config_path(path.to_s)
+        path.empty? ? nil : roms[path] ||= Deferred.new { Nitro::Rom.new(path) }
+      end
+      load_syms = lambda do |path|
+        path = NCPP.expand_config_path(path.to_s)
+        next nil if path.empty?
+        symbols[path] ||= Unarm::Symbols.new(file_path: path, demangled: demangled).tap { demangled.merge!(it.demangled) }
+      end
+
+      targets = entries.map do |entry|
+        target_cfg = cfg.except('targets').merge(entry.slice(*FIELDS))
+        target_cfg['gen_path'] = entry['gen_path'] || "#{cfg['gen_path']}_#{entry['name']}"
+        raise "Target '#{entry['name']}' has no clean_rom" if target_cfg['clean_rom'].to_s.empty?
+
+        Target.new(entry['name'], target_cfg, load_rom.(target_cfg['clean_rom']), load_rom.(target_cfg['target_rom']),
+                   load_syms.(target_cfg['symbols9']), load_syms.(target_cfg['symbols7']))
+      end
+
+      rom_list = roms.values
+      rom_list.each_with_index { |rom, i| rom_list[0...i].each { rom.share_identical(it) } }
+
+      targets
+    end
+
+    def initialize(name, config, clean_rom, target_rom, symbols9, symbols7)
+      @name = name
+      @config = config
+      @clean_rom = clean_rom
+      @target_rom = target_rom
+      @symbol_state = [symbols9, symbols7, {}]
+      @emu = nil
+    end
+
+    # Binds the globals to this target, keeping the emulator and symbol caches of the previously active one
+    def activate
+      previous = Target.active
+      return self if previous.equal?(self)
+      previous&.suspend
+
+      $config = @config
+      $clean_rom = @clean_rom
+      $target_rom = @target_rom
+      $emu = @emu
+      Unarm.symbol_state = @symbol_state
+      Target.active = self
+      self
+    end
+
+    # Reloads the target ROM, which unlike the clean ROM and symbols is rewritten by every NCPatcher build
+    def reload_target_rom
+      path = NCPP.expand_config_path(@config['target_rom'].to_s)
+      @target_rom = path.empty? ? nil : Deferred.new { Nitro::Rom.new(path) }
+      $target_rom = @target_rom if Target.active.equal?(self)
+    end
+
+    # Drops the emulator, so the next one starts from a fresh memory image
+    def reset_emu
+      @emu = nil
+      $emu = nil if Target.active.equal?(self)
+    end
+
+  protected
+
+    def suspend
+      @emu = $emu
+      @symbol_state = Unarm.symbol_state
+    end
+
+  end
+
+end
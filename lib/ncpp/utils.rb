@@ -2,6 +2,8 @@ require_relative '../nitro/nitro'
 require_relative '../unarm/unarm'
 require_relative '../unicorn/unicorn'
 
+require 'digest'
+require 'fileutils'
 require 'did_you_mean/jaro_winkler'
 require 'did_you_mean/levenshtein'
 
@@ -73,7 +75,9 @@ module NCPP
     end
 
     def self.invalid_sym_error(sym, demangled: false)
-      alt = demangled ? Unarm.symbols.demangled_map.suggest_similar_key(sym) : Unarm.sym_map.suggest_similar_key(sym)
+      alt, score = Unarm.symbols.suggestion_index(demangled: demangled)
+                                .suggest(sym, jaro_weight: Hash::KEY_SUGGEST_JARO_WEIGHT).first
+      alt = nil if alt && score < Hash::KEY_SUGGEST_THRESH
       raise "'#{sym}' is not a valid symbol#{"\nDid you mean '#{alt}'?" unless alt.nil?}"
     end
 
@@ -86,14 +90,15 @@ module NCPP
           addr
         end
       else
-        # pp Unarm.symbols.ambig_demangled
-        overloads = Unarm.symbols.ambig_demangled.filter { it[0] == sym }.map { it[1].to_hex }
-        if !overloads.empty?
-          print_warning "Demangled symbol name '#{sym}' is ambiguous.\n" \
-                        "Overload#{'s' if overloads.length != 1 } found at: #{overloads.join(', ')}"
-        end
         mangled = Unarm.symbols.demangled_map[sym]
         invalid_sym_error(sym, demangled: true) if mangled.nil?
+        overloads = Unarm.symbols.ambig_demangled.filter { it[0] == sym }
+        if !overloads.empty?
+          chosen = Unarm.symbols.demangled[mangled][0]
+          print_warning "Demangled symbol name '#{sym}' is ambiguous, using '#{chosen}'.\n" \
+                        "Overload#{'s' if overloads.length != 1 } (pass the full signature to pick one):\n" +
+                        overloads.map { "  #{it[2]} at #{it[1].to_hex}" }.join("\n")
+        end
         Unarm.sym_map[mangled]
       end
     end
@@ -256,21 +261,91 @@ module NCPP
       element_signed = DTYPES[element_type_id][:signed]
       raise ArgumentError, 'element size must be 1, 2, 4, or 8 (bytes)' unless [1,2,4,8].include?(element_size)
       addr, ov, code_bin = resolve_code_loc(addr, ov)
-        (0...element_count).map do |i|
-        offset = addr + i * element_size
-        if element_signed
-          code_bin.send(:"read#{element_size * 8}", offset).signed(element_size*8)
-        else
-          code_bin.send(:"read#{element_size * 8}", offset)
-        end
+      type = :"#{element_signed ? 'int' : 'uint'}#{element_size * 8}"
+      ptr = code_bin.get_range_ptr(addr, element_size * element_count)
+      return ptr.send(:"get_array_of_#{type}", 0, element_count) unless ptr.nil?
+
+      # spans sections, so each element is read from wherever it lies
+      (0...element_count).map do |i|
+        value = code_bin.send(:"read#{element_size * 8}", addr + i * element_size)
+        element_signed ? value.signed(element_size * 8) : value
+      end
+    end
+
+    # Field types of a table element: a DTYPE ID or name (e.g. 'u16'), or an array of them for a struct
+    def self.table_field_types(type)
+      Array(type).map do |field|
+        id = field.is_a?(Integer) ? field : DTYPE_IDS[field.to_s.to_sym]
+        raise "Invalid table field type '#{field}'" if id.nil? || DTYPES[id].nil?
+        id
       end
     end
 
+    # Options of a table format string: 'hex' or 'dec' (the default), and 'packed' for structs without padding
+    def self.table_format_opts(format)
+      words = format.to_s.downcase.split(/[\s,]+/)
+      unknown = words - %w[hex dec packed]
+      raise "Unknown table format option#{'s' if unknown.length > 1}: #{unknown.join(', ')}" unless unknown.empty?
+      { hex: words.include?('hex'), packed: words.include?('packed') }
+    end
+
+    # C initializer of a table in arm9 or an overlay, formatted natively (see Nitro.format_table)
+    def self.get_c_table(loc, ov, type, count, format = 'dec', per_line = 0)
+      types, opts = table_field_types(type), table_format_opts(format)
+      size = Nitro.table_stride(types, packed: opts[:packed]) * count
+      addr, _ov, code_bin = resolve_code_loc(loc, ov)
+      return '{}' if count == 0
+      ptr = code_bin.get_range_ptr(addr, size)
+      raise "Table of #{size.to_hex} bytes at #{addr.to_hex} doesn't lie within one section" if ptr.nil?
+      Nitro.format_table(ptr, size, types, count, **opts, per_line: per_line)
+    end
+
+    # C initializer of a table in a file of the ROM's filesystem (see get_rom_file), starting at offset
+    def self.get_file_c_table(file, offset, type, count, format = 'dec', per_line = 0)
+      types, opts = table_field_types(type), table_format_opts(format)
+      view = get_rom_file(file)
+      raise "Offset #{offset.to_hex} is out of bounds of a #{view.size.to_hex} byte file" unless offset.between?(0, view.size)
+      Nitro.format_table(view.ptr + offset, view.size - offset, types, count, **opts, per_line: per_line)
+    end
+
     def self.get_byte_str(loc, ov, size)
       addr, _ov, code_bin = resolve_code_loc(loc, ov)
       code_bin.get_sect_ptr(addr,size).read_array_of_uint8(size).pack('C*')
     end
 
+    # A file of the ROM's filesystem by ID or path, read in place. A path can go on into NARC archives, naming
+    # their files by path or ID (e.g. 'a/0/1/6/3' or 'data/item.narc/item_0.bin'), which are given uncompressed
+    def self.get_rom_file(file)
+      return $rom.file(file) if file.is_a? Integer
+
+      parts = file.delete_prefix('/').split('/')
+      container = $rom
+
+      loop do
+        # The longest leading part of the path that names a file of the ROM or archive
+        count = parts.length.downto(1).find { container.find_file(parts.first(it).join('/')) }
+        if count.nil?
+          raise "File '#{file}' not found" unless container.is_a?(Nitro::Narc) && parts.first.match?(/\A\d+\z/)
+          id, count = parts.first.to_i, 1
+        else
+          id = container.find_file(parts.first(count).join('/'))
+        end
+
+        parts = parts.drop(count)
+        if parts.empty?
+          return container.is_a?(Nitro::Narc) ? container.file(id, decompress: true) : container.file(id)
+        end
+        container = container.narc(id)
+      end
+    end
+
+    def self.get_file_array(file, offset, element_type_id, element_count)
+      element_size = DTYPES[element_type_id][:size]
+      element_signed = DTYPES[element_type_id][:signed]
+      type = :"#{element_signed ? 'int' : 'uint'}#{element_size * 8}"
+      get_rom_file(file).read_array(offset, type, element_count)
+    end
+
     def self.find_branch_to(branch_dest, start_loc, start_ov=nil, from_func: false, find_all: false)
       start_addr, _ov, code_bin = resolve_code_loc(start_loc, start_ov)
       if branch_dest.is_a? Array
@@ -292,6 +367,13 @@ module NCPP
         else
           return addrs[0] unless addrs.empty?
         end
+      elsif (table = code_bin.decoded_table(start_addr))
+        addr, passed_end = table.find_branch_to(branch_dests, start_addr)
+        if addr
+          print_warning "Function end may have been passed in search for branch to " \
+                        "#{branch_dests.map(&:to_hex).join(', ')}" if passed_end
+          return addr
+        end
       else
         code_bin.each_ins(start_addr..) do |ins|
           print_warning "Function end may have been passed in search for branch to " \
@@ -319,6 +401,68 @@ module NCPP
       reg = reg.to_s unless reg.nil?
     end
 
+    # Constant value of a register right before the instruction at loc, as propagated through its function from
+    # immediates, literal pool loads and arithmetic; raises if it depends on the path taken or on memory
+    def self.get_reg_value(reg, loc, ov = nil)
+      addr, ov = resolve_loc(loc, ov)
+      value = with_code_bin(ov) { it.dataflow(addr)&.reg_at(reg, addr & ~1) }
+      raise "#{reg} does not hold a known constant at #{addr.to_hex}" if value.nil?
+      value
+    end
+
+    # Values of r0-r3 (or count registers) right before the instruction at loc, nil where they are not constant
+    def self.get_call_args(loc, ov = nil, count = 4)
+      addr, ov = resolve_loc(loc, ov)
+      regs = with_code_bin(ov) { it.dataflow(addr)&.regs_at(addr & ~1) }
+      raise "No function containing #{addr.to_hex} is known" if regs.nil?
+      regs.first(count)
+    end
+
+    # Addresses a pointer to loc can hold: the size bytes from it, or, without a size, loc itself with or without the
+    # Thumb bit
+    def self.pointer_range(loc, size = nil)
+      addr, _ov = resolve_loc(loc, nil)
+      addr &= ~1 if size.nil?
+      addr...(addr + (size || 2))
+    end
+
+    # Every aligned word of arm9, arm7 and the overlays (and, with files, of the other files of the ROM's filesystem)
+    # whose value is in one of the ranges, found natively with every binary scanned in parallel. Returns the hits in
+    # binaries as [addr, ov, value, address of the containing function or nil] and those in files as
+    # [file ID, offset, value]
+    def self.find_pointers(ranges, files: false)
+      sources = [] # [pointer, size, address]
+      origins = [] # ov, or [:file, id]
+      [-1, -2, *0...$rom.overlay_count].each do |ov|
+        with_code_bin(ov) do |code_bin|
+          code_bin.code_regions.each do |region|
+            sources << [code_bin.get_sect_ptr(region.begin, region.size), region.size, region.begin]
+            origins << ov
+          end
+        end
+      end
+      if files
+        overlay_files = (0...$rom.overlay_count).map { $rom.overlay_table.get_entry(it)[:file_id] }
+        (0...$rom.file_count).each do |id|
+          next if overlay_files.include?(id) || (view = $rom.file(id)).size < 4
+          sources << [view.ptr, view.size, 0]
+          origins << [:file, id]
+        end
+      end
+
+      code_hits, file_hits = [], []
+      Nitro.find_words(sources, ranges).each do |source, addr, value|
+        origin = origins[source]
+        if origin.is_a?(Array)
+          file_hits << [origin[1], addr, value]
+        else
+          func = with_code_bin(origin) { it.function_map(addr)&.containing(addr)&.addr }
+          code_hits << [addr, origin, value, func]
+        end
+      end
+      [code_hits, file_hits]
+    end
+
     def self.find_ins_in_func(ins_pattern_str, func_loc, func_ov = nil, find_all: false)
       start_addr, _ov, code_bin = resolve_code_loc(func_loc, func_ov)
       func = code_bin.get_function(start_addr)
@@ -337,6 +481,36 @@ module NCPP
       raise "Could not find instruction pattern in function at #{func_loc}"
     end
 
+    # Finds the instructions matching a structured pattern (see Unarm::InsPattern) in arm9 (ov nil or -1), arm7 (ov
+    # -2) or an overlay, through an index of their decoded fields
+    def self.find_ins(ins_pattern_str, ov = nil, find_all: false)
+      addrs = with_code_bin(ov) { it.find_instructions(ins_pattern_str) }
+      return addrs if find_all
+      raise "Could not find instruction pattern '#{ins_pattern_str}'" if addrs.empty?
+      addrs[0]
+    end
+
+    # [address, ov] of every instruction matching a structured pattern in arm9 (-1), arm7 (-2) and every overlay
+    def self.find_ins_anywhere(ins_pattern_str)
+      [-1, -2, *0...$rom.overlay_count].flat_map do |ov|
+        with_code_bin(ov) { |code_bin| code_bin.find_instructions(ins_pattern_str).map { [it, ov] } }
+      end
+    end
+
+    # Yields the code binary of arm9 (ov nil or -1), arm7 (ov -2) or an overlay, with Unarm set to its CPU
+    def self.with_code_bin(ov)
+      return yield($rom.arm9) if ov.nil? || ov == -1
+      return yield($rom.get_overlay(ov)) unless ov == -2
+
+      cpu = Unarm.cpu
+      Unarm.use_arm7
+      begin
+        yield $rom.arm7
+      ensure
+        Unarm.use_arm9 if cpu == Unarm::CPU::ARM9
+      end
+    end
+
     def self.next_addr(current_loc, ov = nil)
       addr, ov, code_bin = resolve_code_loc(current_loc,ov)
       raise 'Next address is out of range' if addr >= code_bin.end_addr - 4
@@ -347,7 +521,7 @@ module NCPP
 
     def self.get_ins_mnemonic(loc, ov = nil)
       addr, ov, code_bin = resolve_code_loc(loc,ov)
-      code_bin.read_ins(addr).mnemonic
+      code_bin.decoded_ins(addr).mnemonic
     end
 
     def self.get_ins_arg(loc, ov, arg_index)
@@ -357,12 +531,12 @@ module NCPP
 
     def self.get_ins_branch_dest(loc, ov=nil)
       addr, ov, code_bin = resolve_code_loc(loc,ov)
-      code_bin.read_ins(addr).branch_dest
+      code_bin.decoded_ins(addr).branch_dest
     end
 
     def self.get_ins_target_addr(loc, ov=nil)
       addr, ov, code_bin = resolve_code_loc(loc,ov)
-      code_bin.read_ins(addr).target_addr
+      code_bin.decoded_ins(addr).target_addr
     end
 
     def self.to_c_array(arr)
@@ -390,10 +564,13 @@ module NCPP
 
     def self.get_function_size(loc, ov=nil)
       addr, ov, code_bin = resolve_code_loc(loc,ov)
+      if (info = code_bin.function_map(addr)&.[](addr)) && info.thumb? == (addr & 1 != 0)
+        return info.extent_end - info.start_addr
+      end
       func = code_bin.get_function(addr)
       if func[:literal_pool].empty?
         last = func[:instructions].last
-        last.address + last.size - func[:instructions].first
+        last.address + last.size - func[:instructions].first.address
       else
         last = func[:literal_pool][func[:literal_pool].keys.max]
         last.address + last.size - func[:instructions].first.address
@@ -401,6 +578,13 @@ module NCPP
 
     end
 
+    def self.get_containing_function(loc, ov=nil)
+      addr, ov, code_bin = resolve_code_loc(loc,ov)
+      func = code_bin.containing_function(addr)
+      raise "No known function contains #{addr.to_hex}." if func.nil?
+      func.addr
+    end
+
     def self.addr_in_overlay?(addr, ov)
       if ov == -1
         $rom.arm9.bounds.include? addr
@@ -429,38 +613,199 @@ module NCPP
       gen_repl_array(addr, ov, DTYPE_IDS[:u8], [new_hex_str].pack('H*').unpack('C*'))
     end
 
+    # The emulator is only created, and arm9 only loaded into it, once something needs it
+    def self.emu
+      $emu ||= Uc::Emu.new(regions: []).tap(&:load_arm9)
+    end
+
     def self.emulate_func(func_loc, ov, *args)
       addr, ov, code_bin = resolve_code_loc(func_loc,ov)
-      $emu.load_overlay(ov) if !ov.nil? && ov >= 0
-      $emu.call_func(addr, *args)
+      emu.load_overlay(ov) if !ov.nil? && ov >= 0
+      emu_memo_enabled? ? memo_call_func(addr, *args) : emu.call_func(addr, *args)
+    end
+
+    EMU_MEMO_FILENAME = 'emu_memo.bin'
+    EMU_MEMO_MAX_ENTRIES = 1 << 12
+    EMU_MEMO_MAX_VARIANTS = 4 # memory states remembered per call
+
+    # Registers a call is assumed to depend on besides memory: the arguments, stack and return address (AAPCS)
+    EMU_MEMO_ENTRY_REGS = %i[r0 r1 r2 r3 sp lr cpsr].freeze
+    EMU_MEMO_EXIT_REGS = %i[r0 r1 r2 r3 r4 r5 r6 r7 r8 r9 r10 r11 r12 sp lr pc cpsr].freeze
+
+    class << self
+      attr_writer :emu_memo_enabled
+    end
+
+    def self.emu_memo_enabled? = @emu_memo_enabled != false
+
+    # Calls an emulated function through the memo. A previous call with the same entry registers, whose input pages
+    # (the code it ran and the memory it read) are unchanged, has its writes and final registers replayed instead
+    # of running again; otherwise the call is traced and recorded if it stayed within the memory image
+    def self.memo_call_func(addr, *args)
+      raise "Calling functions with more than 4 args isn't supported yet" if args.length > 4
+      args.each_with_index { |arg, i| emu.write_register(:"r#{i}", arg) }
+      entry_regs = emu.read_registers(EMU_MEMO_ENTRY_REGS)
+      key = Digest::SHA1.digest(Marshal.dump([addr, entry_regs.values]))
+
+      variants = emu_memo.delete(key) || []
+      emu_memo[key] = variants # most recently used last
+
+      if (hit = variants.find { emu.memory_image.pages_match?(it[:inputs]) })
+        hit[:writes].each { |write_addr, bytes| emu.write_mem(write_addr, bytes) }
+        emu.write_registers(hit[:registers])
+        return hit[:result]
+      end
+
+      result, trace = emu.traced_call_func(addr, *args)
+      returned = (emu.read_pc ^ entry_regs[:lr]) & 0xFFFFFFFE == 0 # rather than stopped by the timeout
+      if returned && trace.complete?
+        variants.unshift({ inputs: trace.inputs, writes: trace.writes, registers: emu.read_registers(EMU_MEMO_EXIT_REGS),
+                           result: result })
+        variants.pop while variants.length > EMU_MEMO_MAX_VARIANTS
+        (@dirty_emu_memos ||= {})[emu_memo_path] = true
+      end
+      result
+    end
+
+    # One memo per gen path, so each target of a multi-target project loads and saves its own
+    def self.emu_memo
+      (@emu_memos ||= {})[emu_memo_path] ||= begin
+        path = emu_memo_path
+        memo = nil
+        if path && File.exist?(path)
+          memo = Marshal.load(File.binread(path)) rescue nil
+        end
+        memo.is_a?(Hash) && memo[:version] == NCPP::VERSION ? memo[:entries] : {}
+      end
+    end
+
+    def self.emu_memo_path
+      $config.nil? || $config['gen_path'].to_s.empty? ? nil : File.join($config['gen_path'], EMU_MEMO_FILENAME)
+    end
+
+    def self.save_emu_memo
+      @dirty_emu_memos&.each_key do |path|
+        next if path.nil?
+        entries = @emu_memos[path]
+        entries.shift while entries.length > EMU_MEMO_MAX_ENTRIES
+        FileUtils.mkdir_p(File.dirname(path))
+        File.binwrite(path, Marshal.dump({ version: NCPP::VERSION, entries: entries }))
+      end
+      @dirty_emu_memos = {}
     end
 
     def self.emu_get_mem(loc, size)
       addr, ov = resolve_loc(loc)
-      $emu.load_overlay(ov) if !ov.nil? && ov >= 0
-      $emu.read_mem(addr, size)
+      emu.load_overlay(ov) if !ov.nil? && ov >= 0
+      emu.read_mem(addr, size)
     end
 
     def self.emu_set_mem(loc, byte_str)
       addr, ov = resolve_loc(loc)
-      $emu.load_overlay(ov) if !ov.nil? && ov >= 0
-      $emu.write_mem(addr, byte_str)
+      emu.load_overlay(ov) if !ov.nil? && ov >= 0
+      emu.write_mem(addr, byte_str)
     end
 
     def self.assemble_arm(asm, addr: 0)
-      if asm.is_a? Array
-        asm.map.with_index {|ins,idx| $arm_assembler.assemble(ins,addr+4*idx).unpack('L')[0] }
-      else
-        $arm_assembler.assemble(asm).unpack('L')[0]
-      end
+      assemble(asm, addr, thumb: false)
     end
 
     def self.assemble_thumb(asm, addr: 0)
-      if asm.is_a? Array
-        asm.map.with_index {|ins,idx| $thumb_assembler.assemble(ins,addr+2*idx).unpack('S')[0] }
-      else
-        $thumb_assembler.assemble(asm).unpack('S')[0]
+      assemble(asm, addr, thumb: true)
+    end
+
+    # Assembles a single instruction or an array of consecutive ones, going through the assembly cache and
+    # assembling whatever is missing in a single Keystone call
+    def self.assemble(asm, addr, thumb:)
+      assembler, ins_size, fmt = thumb ? [$thumb_assembler, 2, 'S'] : [$arm_assembler, 4, 'L']
+      instructions = asm.is_a?(Array) ? asm : [asm]
+      keys = instructions.map.with_index { |ins, idx| asm_cache_key(ins, addr + ins_size*idx, thumb) }
+      encodings = keys.map { |key| asm_cache_get(key) }
+
+      if encodings.include?(nil)
+        batch = assembler.assemble_batch(instructions, addr: addr, ins_size: ins_size)
+        batch ||= instructions.map.with_index { |ins, idx| assembler.assemble(ins, addr: addr + ins_size*idx) }
+        keys.each_with_index { |key, idx| asm_cache_set(key, batch[idx]) }
+        encodings = batch
       end
+
+      values = encodings.map { |enc| enc.unpack1(fmt) }
+      asm.is_a?(Array) ? values : values[0]
+    end
+
+    ASM_CACHE_FILENAME = 'asm_cache.bin'
+    ASM_CACHE_MAX_ENTRIES = 1 << 16
+
+    # Encodings keyed by a digest of the mode, address and source of each instruction; entries are kept in least
+    # recently used order so the oldest can be dropped when saving. There's one per gen path, like the emulator memo
+    def self.asm_cache
+      (@asm_caches ||= {})[asm_cache_path] ||= begin
+        path = asm_cache_path
+        cache = nil
+        if path && File.exist?(path)
+          cache = Marshal.load(File.binread(path)) rescue nil
+        end
+        cache.is_a?(Hash) && cache[:version] == asm_cache_version ? cache[:entries] : {}
+      end
+    end
+
+    def self.asm_cache_path
+      $config.nil? || $config['gen_path'].to_s.empty? ? nil : File.join($config['gen_path'], ASM_CACHE_FILENAME)
+    end
+
+    def self.asm_cache_version
+      [NCPP::VERSION, Ks::KS_VERSION_MAJOR, Ks::KS_VERSION_MINOR, Ks::KS_VERSION_EXTRA]
+    end
+
+    def self.asm_cache_key(ins, addr, thumb)
+      Digest::SHA1.digest("#{thumb ? 't' : 'a'}:#{addr}:#{ins}")
+    end
+
+    def self.asm_cache_get(key)
+      enc = asm_cache.delete(key)
+      asm_cache[key] = enc unless enc.nil?
+      enc
+    end
+
+    def self.asm_cache_set(key, enc)
+      asm_cache[key] = enc
+      (@dirty_asm_caches ||= {})[asm_cache_path] = true
+    end
+
+    def self.save_asm_cache
+      @dirty_asm_caches&.each_key do |path|
+        next if path.nil?
+        entries = @asm_caches[path]
+        entries.shift while entries.length > ASM_CACHE_MAX_ENTRIES
+        FileUtils.mkdir_p(File.dirname(path))
+        File.binwrite(path, Marshal.dump({ version: asm_cache_version, entries: entries }))
+      end
+      @dirty_asm_caches = {}
+    end
+
+    # Writes data to path unless the file already holds exactly the bytes that writing it would, so unchanged outputs
+    # keep their mtime and aren't rebuilt downstream. Data is written in text mode (LF becoming CRLF on Windows) unless
+    # binary. Changed files are replaced atomically through a temporary file. Returns whether it wrote
+    def self.write_if_changed(path, data, binary: false)
+      bytes = data.b
+      bytes = bytes.gsub("\n", "\r\n") if !binary && (/cygwin|mswin|mingw|bccwin|wince|emx/ =~ RUBY_PLATFORM) != nil
+      return false if File.file?(path) && File.size(path) == bytes.bytesize && File.binread(path) == bytes
+
+      FileUtils.mkdir_p(File.dirname(path))
+      tmp_path = "#{path}.#{Process.pid}.tmp"
+      begin
+        binary ? File.binwrite(tmp_path, data) : File.write(tmp_path, data)
+        File.rename(tmp_path, path)
+      ensure
+        File.delete(tmp_path) if File.exist?(tmp_path)
+      end
+      true
+    end
+
+    # Writes out the caches kept across runs
+    def self.save_caches
+      save_asm_cache
+      save_emu_memo
     end
 
     class << self
@@ -595,6 +940,104 @@ class Nitro::CodeBin
   end
   alias_method :get_loc, :get_location
 
+  # Lazily decoded instruction fields of the code region containing addr, shared by every instruction query on
+  # this binary and dropped whenever the binary is written to
+  def decoded_table(addr, thumb: false)
+    if @decoded_revision != revision
+      @decoded_tables&.each_value(&:invalidate)
+      @decoded_revision = revision
+    end
+    region = code_regions.find { |r| r.include?(addr) }
+    return nil if region.nil?
+    @decoded_tables ||= {}
+    @decoded_tables[[region.begin, thumb, Unarm.cpu]] ||= Unarm::DecodedTable.new(
+      get_sect_ptr(region.begin, region.size), region.size, region.begin,
+      thumb: thumb, arm7: Unarm.cpu == Unarm::CPU::ARM7, owner: self
+    )
+  end
+
+  # Decoded fields of the instruction at addr in the given mode, falling back to a full disassembly
+  def decoded_instruction(addr, thumb: false)
+    decoded_table(addr, thumb: thumb)&.[](addr) || (thumb ? read_thumb_ins(addr) : read_arm_ins(addr))
+  end
+  alias_method :decoded_ins, :decoded_instruction
+
+  # Every function reachable from the entry point, symbols and static initializers of the code region containing
+  # addr, found in one sweep and rebuilt whenever the binary is written to
+  def function_map(addr = start_addr)
+    if @function_map_revision != revision
+      @function_maps = {}
+      @function_map_revision = revision
+    end
+    region = code_regions.find { |r| r.include?(addr) }
+    return nil if region.nil?
+    @function_maps[[region.begin, Unarm.cpu]] ||= Unarm::FunctionMap.new(
+      get_sect_ptr(region.begin, region.size), region.size, region.begin,
+      function_seeds.select { |seed| region.include?(seed & ~1) }, arm7: Unarm.cpu == Unarm::CPU::ARM7
+    )
+  end
+  alias_method :func_map, :function_map
+
+  # Indexes of the decoded instructions of each code region, for structured instruction searches; built on the
+  # function maps and rebuilt whenever the binary is written to
+  def instruction_indexes
+    if @ins_index_revision != revision
+      @ins_indexes = {}
+      @ins_index_revision = revision
+    end
+    code_regions.map do |region|
+      @ins_indexes[[region.begin, Unarm.cpu]] ||= Unarm::InsIndex.new(
+        get_sect_ptr(region.begin, region.size), region.size, region.begin,
+        function_map: function_map(region.begin), arm7: Unarm.cpu == Unarm::CPU::ARM7
+      )
+    end
+  end
+  alias_method :ins_indexes, :instruction_indexes
+
+  # Register dataflow of the known function containing addr, analyzed once per function and dropped whenever the
+  # binary is written to
+  def dataflow(addr)
+    if @dataflow_revision != revision
+      @dataflows = {}
+      @dataflow_revision = revision
+    end
+    addr &= ~1
+    region = code_regions.find { |r| r.include?(addr) }
+    func = region && function_map(addr)&.containing(addr)
+    return nil if func.nil?
+    @dataflows[[func.start_addr, Unarm.cpu]] ||= Unarm::Dataflow.new(
+      get_sect_ptr(region.begin, region.size), region.size, region.begin, func, arm7: Unarm.cpu == Unarm::CPU::ARM7
+    )
+  end
+
+  # Addresses of every instruction matching an Unarm::InsPattern query, with bit 0 set for Thumb
+  def find_instructions(pattern)
+    pattern = Unarm::InsPattern.new(pattern, resolve: ->(sym) { NCPP::Utils.sym_to_addr(sym) }) if pattern.is_a? String
+    instruction_indexes.flat_map { it.query(pattern) }
+  end
+  alias_method :find_ins, :find_instructions
+
+  # Known function addresses (with the thumb bit) to start discovery from. Only symbols demangling to a signature
+  # are taken, as nothing tells C functions from C globals or mangled data (e.g. Foo::bar); those functions are
+  # still found as the targets of calls from the others
+  def function_seeds
+    seeds = static_initializers.dup
+    seeds << entry_addr if respond_to?(:entry_addr)
+    syms = Unarm.symbols
+    syms&.locs&.[](get_loc)&.each do |name|
+      next unless name.start_with?('_Z') && !name.start_with?('_ZGV') # guard variables are data
+      full, _short = syms.demangled[name]
+      seeds << syms.map[name] if full&.match?(/\)(?: const| volatile|&&?)*\z/)
+    end
+    seeds.uniq
+  end
+
+  # The function whose code or literal pool contains addr, or nil if none of the known functions do
+  def containing_function(addr)
+    function_map(addr)&.containing(addr)
+  end
+  alias_method :containing_func, :containing_function
+
   def read_arm_instruction(addr)
       Unarm::ArmIns.disasm(read32(addr), addr, get_loc)
   end
@@ -630,7 +1073,10 @@ class Nitro::CodeBin
     labels = {}       # key: addr, val: [xrefs]
     pool = {}         # key: addr, val: Unarm::Data
 
-    send(:"each_#{is_thumb ? 'thumb' : 'arm'}_ins", addr..) do |ins|
+    known = function_map(addr)&.[](addr)
+    range = known && known.thumb? == is_thumb ? addr...known.end_addr : addr..
+
+    send(:"each_#{is_thumb ? 'thumb' : 'arm'}_ins", range) do |ins|
       next if pool.keys.include? ins.addr
       raise "Illegal instruction found at #{ins.addr.to_hex}; this is likely not a function." if ins.illegal?
 
@@ -739,33 +1185,47 @@ class Nitro::CodeBin
 
 end
 
+class Nitro::Rom
+
+  # Treats every word (or halfword if thumb) of each binary as an instruction, like example/disasm.rb used to
+  def export_disassembly(path = nil, format: :text, thumb: false, arm7: true, overlays: true, thread_count: 0)
+    targets = [disasm_target(arm9, 'arm9', thumb)]
+    targets << disasm_target(self.arm7, 'arm7', thumb, arm7: true) if arm7
+    each_overlay { |ov, id| targets << disasm_target(ov, "ov#{id}", thumb) } if overlays
+    Unarm.export_disassembly(targets, path: path, format: format, thread_count: thread_count)
+  end
+  alias_method :export_disasm, :export_disassembly
+
+private
+  def disasm_target(bin, loc, thumb, arm7: false)
+    {
+      ptr: bin.get_sect_ptr(bin.start_addr, bin.size), size: bin.size, addr: bin.start_addr,
+      name: loc, loc: loc, arm7: arm7, thumb: thumb
+    }
+  end
+
+end
+
 #
 # Various utility methods tying Unicorn to the Unarm and Nitro modules
 #
 class Unicorn::Emulator
 
+  attr_reader :memory_image
+
+  # Maps a fresh ARM9 memory image straight into the emulator, which then owns it; the remaining NDS regions
+  # (I/O, VRAM, BIOS) are left to Unicorn
   def load_arm9
-    arm = $rom.arm9
-    main_added = false
-    arm.autoload_entries.sort_by {|e| e[:address] }.each do |e|
-      if e[:address] > arm.end_addr # DTCM found
-        add_region(Uc::Region.new(e[:address], 16*1024))
-        next
-      end
-      if !main_added && e[:address] > arm.start_addr # Main section found
-        size = e[:address] - arm.start_addr
-        add_section(Uc::Sect.new(arm.start_addr, arm.get_sect_ptr(arm.start_addr,size), size))
-        main_added = true
-      end
-      next if e[:address]+e[:size] <= e[:address]
-      ptr = arm.get_sect_ptr(e[:address],e[:size])
-      add_section(Uc::Sect.new(e[:address], ptr, e[:size]))
-    end
+    @memory_image = $rom.memory_image
+    image_regions = @memory_image.regions.map { Uc::Region.new(it.addr, it.size, ptr: it.ptr) }
+    image_regions.each { add_region(it) }
+    Uc::NDS_REGIONS.each { |r| add_region(r) unless image_regions.any? { it.overlaps?(r) } }
   end
 
   def load_overlay(ov_id)
-    ov = $rom.get_overlay(ov_id)
-    add_section(Uc::Sect.new(ov.start_addr, ov.get_sect_ptr(ov.start_addr, ov.size), ov.size))
+    raise "Failed to place overlay #{ov_id} in memory." unless @memory_image.place_overlay(ov_id)
+    ovte = $rom.overlay_table.get_entry(ov_id)
+    remove_code_cache(ovte.ram_addr, ovte[:ram_size] + ovte[:bss_size])
   end
   alias_method :load_ov, :load_overlay
 
@@ -778,4 +1238,19 @@ class Unicorn::Emulator
     read_r0
   end
 
+  # Calls a function while recording which pages of the memory image it depends on and what it writes; returns
+  # the result and the trace, which is reused by the next traced call
+  def traced_call_func(addr, *args)
+    if @access_trace.nil?
+      @access_trace = @memory_image.access_trace
+      add_hook(UC_HOOK_BLOCK, Nitro::AccessTrace::BLOCK_HOOK, @access_trace.ptr)
+      add_hook(UC_HOOK_MEM_READ | UC_HOOK_MEM_WRITE, Nitro::AccessTrace::MEM_HOOK, @access_trace.ptr)
+      # Code translated before the hooks were added wouldn't call them
+      @memory_image.regions.each { remove_code_cache(it.addr, it.size) }
+    end
+    result = nil
+    @access_trace.record { result = call_func(addr, *args) }
+    [result, @access_trace]
+  end
+
 end
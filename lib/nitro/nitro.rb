@@ -14,19 +14,87 @@ module NitroBind
   typedef :pointer, :ovte_handle
   typedef :pointer, :module_params_handle
   typedef :pointer, :autoload_entry_handle
+  typedef :pointer, :manifest_handle
+  typedef :pointer, :memory_image_handle
+  typedef :pointer, :access_trace_handle
+  typedef :pointer, :narc_handle
+
+  attach_function :nitro_hashFile, [:string, :pointer], :bool, blocking: true
 
   attach_function :nitroRom_alloc, [], :rom_handle
   attach_function :nitroRom_release, [:rom_handle], :void
-  attach_function :nitroRom_load, [:rom_handle, :string], :bool
+  attach_function :nitroRom_load, [:rom_handle, :string, :bool], :bool, blocking: true
   attach_function :nitroRom_getSize, [:rom_handle], :size_t
   attach_function :nitroRom_getHeader, [:rom_handle], :header_handle
   attach_function :nitroRom_getFile, [:rom_handle, :uint32], :pointer
   attach_function :nitroRom_getFileSize, [:rom_handle, :uint32], :uint32
-  attach_function :nitroRom_loadArm9, [:rom_handle], :codebin_handle
-  attach_function :nitroRom_loadArm7, [:rom_handle], :codebin_handle
-  attach_function :nitroRom_loadOverlay, [:rom_handle, :uint32], :codebin_handle
+  attach_function :nitroRom_loadArm9, [:rom_handle], :codebin_handle, blocking: true
+  attach_function :nitroRom_loadArm7, [:rom_handle], :codebin_handle, blocking: true
+  attach_function :nitroRom_loadOverlay, [:rom_handle, :uint32], :codebin_handle, blocking: true
   attach_function :nitroRom_getOverlayCount, [:rom_handle], :uint32
   attach_function :nitroRom_getArm9OvT, [:rom_handle], :ovte_handle
+  attach_function :nitroRom_getFileCount, [:rom_handle], :uint32
+  attach_function :nitroRom_findFile, [:rom_handle, :string], :int32
+  attach_function :nitroRom_getFilePath, [:rom_handle, :uint32], :string
+  attach_function :nitroRom_buildManifest, [:rom_handle, :uint32], :manifest_handle, blocking: true
+
+  attach_function :romManifest_release, [:manifest_handle], :void
+  attach_function :romManifest_getRomKey, [:manifest_handle], :uint64
+  attach_function :romManifest_getHeader, [:manifest_handle], :pointer
+  attach_function :romManifest_getArm9, [:manifest_handle], :pointer
+  attach_function :romManifest_getArm7, [:manifest_handle], :pointer
+  attach_function :romManifest_getOverlays, [:manifest_handle], :pointer
+  attach_function :romManifest_getOverlayCount, [:manifest_handle], :uint32
+  attach_function :romManifest_getFiles, [:manifest_handle], :pointer
+  attach_function :romManifest_getFileCount, [:manifest_handle], :uint32
+  attach_function :romManifest_getChecksums, [:manifest_handle], :pointer
+  attach_function :romManifest_checksumsValid, [:manifest_handle], :bool
+
+  attach_function :memoryImage_build, [:rom_handle], :memory_image_handle
+  attach_function :memoryImage_release, [:memory_image_handle], :void
+  attach_function :memoryImage_placeOverlay, [:memory_image_handle, :rom_handle, :uint32], :bool
+  attach_function :memoryImage_getRegionCount, [:memory_image_handle], :uint32
+  attach_function :memoryImage_getRegion, [:memory_image_handle, :uint32], :pointer
+  attach_function :memoryImage_pagesMatch, [:memory_image_handle, :pointer, :pointer, :uint32], :bool
+
+  attach_function :accessTrace_alloc, [:memory_image_handle], :access_trace_handle
+  attach_function :accessTrace_release, [:access_trace_handle], :void
+  attach_function :accessTrace_start, [:access_trace_handle], :void
+  attach_function :accessTrace_finish, [:access_trace_handle], :void
+  attach_function :accessTrace_isComplete, [:access_trace_handle], :bool
+  attach_function :accessTrace_getInputCount, [:access_trace_handle], :uint32
+  attach_function :accessTrace_getInputs, [:access_trace_handle], :pointer
+  attach_function :accessTrace_getWriteCount, [:access_trace_handle], :uint32
+  attach_function :accessTrace_getWrites, [:access_trace_handle], :pointer
+  attach_function :accessTrace_getWriteData, [:access_trace_handle], :pointer
+
+  attach_function :narc_alloc, [], :narc_handle
+  attach_function :narc_release, [:narc_handle], :void
+  attach_function :narc_load, [:narc_handle, :pointer, :size_t], :bool
+  attach_function :narc_getFileCount, [:narc_handle], :uint32
+  attach_function :narc_getFile, [:narc_handle, :uint32, :pointer], :pointer
+  attach_function :narc_getUncompressedFile, [:narc_handle, :uint32, :pointer], :pointer
+  attach_function :narc_findFile, [:narc_handle, :string], :int32
+  attach_function :narc_getFilePath, [:narc_handle, :uint32], :string
+
+  attach_function :table_format, [:pointer, :size_t, :pointer, :uint32, :uint32, :uint32, :uint32], :pointer
+  attach_function :table_getStride, [:pointer, :uint32, :bool], :size_t
+  attach_function :text_getData, [:pointer], :pointer
+  attach_function :text_getSize, [:pointer], :size_t
+  attach_function :text_release, [:pointer], :void
+
+  attach_function :scan_findWords, [:pointer, :uint32, :pointer, :uint32, :uint32], :pointer, blocking: true
+  attach_function :scanResult_getCount, [:pointer], :size_t
+  attach_function :scanResult_getHits, [:pointer], :pointer
+  attach_function :scanResult_release, [:pointer], :void
+
+  attach_function :blz_compress, [:pointer, :size_t], :pointer, blocking: true
+  attach_function :blz_recompress,
+    [:pointer, :size_t, :pointer, :size_t, :pointer, :size_t, :size_t, :size_t, :size_t, :pointer], :pointer,
+    blocking: true
+  attach_function :bytes_getData, [:pointer], :pointer
+  attach_function :bytes_getSize, [:pointer], :size_t
+  attach_function :bytes_release, [:pointer], :void
 
   attach_function :headerBin_alloc, [], :header_handle
   attach_function :headerBin_release, [:header_handle], :void
@@ -50,6 +118,8 @@ module NitroBind
   attach_function :codeBin_getSize, [:codebin_handle], :uint32
   attach_function :codeBin_getStartAddress, [:codebin_handle], :uint32
   attach_function :codeBin_getSectPtr, [:codebin_handle, :uint32, :size_t], :pointer
+  attach_function :codeBin_getRangePtr, [:codebin_handle, :uint32, :uint32], :pointer
+  attach_function :codeBin_getRevision, [:codebin_handle], :uint32
 
   attach_function :armBin_alloc, [], :codebin_handle
   attach_function :armBin_release, [:codebin_handle], :void
@@ -70,6 +140,109 @@ end
 module Nitro
   extend NitroBind
 
+  # XXH64 of a file's contents, or nil if it cannot be read
+  def self.hash_file(path)
+    hash_ptr = FFI::MemoryPointer.new(:uint64)
+    nitro_hashFile(path, hash_ptr) ? hash_ptr.read_uint64 : nil
+  end
+
+  TABLE_HEX    = 1 << 0
+  TABLE_PACKED = 1 << 1
+
+  class ScanSource < FFI::Struct
+    layout :data,    :pointer,
+           :size,    :uint32,
+           :address, :uint32
+  end
+
+  class ScanHit < FFI::Struct
+    layout :source,  :uint32,
+           :address, :uint32,
+           :value,   :uint32
+  end
+
+  # [source index, address, value] of every aligned word whose value is in one of the ranges (Ranges of addresses),
+  # in the sources given as [pointer, size, address] (0 for file offsets). Sources are scanned in parallel, comparing
+  # several words at once; hits are ordered by source then address
+  def self.find_words(sources, ranges, thread_count: 0)
+    return [] if sources.empty? || ranges.empty?
+
+    sources_ptr = FFI::MemoryPointer.new(ScanSource, sources.length)
+    sources.each_with_index do |(ptr, size, addr), i|
+      source = ScanSource.new(sources_ptr + i * ScanSource.size)
+      source[:data], source[:size], source[:address] = ptr, size, addr
+    end
+    ranges_ptr = FFI::MemoryPointer.new(:uint32, ranges.length * 2)
+    ranges_ptr.write_array_of_uint32(ranges.flat_map { [it.begin, it.exclude_end? ? it.end : it.end + 1] })
+
+    result = scan_findWords(sources_ptr, sources.length, ranges_ptr, ranges.length, thread_count)
+    raise 'Word scan failed' if result.null?
+    begin
+      hits_ptr = scanResult_getHits(result)
+      Array.new(scanResult_getCount(result)) do |i|
+        hit = ScanHit.new(hits_ptr + i * ScanHit.size)
+        [hit[:source], hit[:address], hit[:value]]
+      end
+    ensure
+      scanResult_release(result)
+    end
+  end
+
+  # BLZ-compressed data (as arm9 and overlays are stored), or nil if compressing wouldn't make it smaller
+  def self.blz_compress(data)
+    data_ptr = FFI::MemoryPointer.from_string(data)
+    take_bytes(blz_compress(data_ptr, data.bytesize))
+  end
+
+  # BLZ-compresses data again after a patch of dirty (a Range of offsets), re-encoding only the data up to the last
+  # changed byte and keeping the rest of old_compressed. old_data, if given, narrows the range to the bytes that
+  # actually changed. Returns the compressed data, nil if it wouldn't be smaller, or false if neither it nor the data
+  # fits in max_size (0 for no limit), which is found out as soon as the encoder passes it
+  def self.blz_recompress(old_compressed, old_data, data, dirty, max_size: 0)
+    ptrs = [old_compressed, old_data || '', data].map { FFI::MemoryPointer.from_string(it) }
+    fits_ptr = FFI::MemoryPointer.new(:bool)
+    dirty_end = dirty.exclude_end? ? dirty.end : dirty.end + 1
+    result = blz_recompress(ptrs[0], old_compressed.bytesize, ptrs[1], old_data.to_s.bytesize, ptrs[2], data.bytesize,
+                            dirty.begin, dirty_end, max_size, fits_ptr)
+    compressed = take_bytes(result)
+    fits_ptr.read(:bool) ? compressed : false
+  end
+
+  # Reads and frees a byte vector returned by the library; nil if it's empty
+  def self.take_bytes(bytes)
+    raise 'Out of memory' if bytes.null?
+    begin
+      size = bytes_getSize(bytes)
+      size == 0 ? nil : bytes_getData(bytes).read_bytes(size)
+    ensure
+      bytes_release(bytes)
+    end
+  end
+  private_class_method :take_bytes
+
+  # Size of one element of a table whose fields have the given types (IDs of NCPP::Utils::DTYPES), aligned like a C
+  # struct unless packed
+  def self.table_stride(types, packed: false)
+    types_ptr = FFI::MemoryPointer.new(:uint8, [types.length, 1].max)
+    types_ptr.write_array_of_uint8(types)
+    table_getStride(types_ptr, types.length, packed)
+  end
+
+  # C initializer of count elements read from ptr (size bytes long), each one value or, with several types, a struct
+  # of one field per type; formatted natively into a single string
+  def self.format_table(ptr, size, types, count, hex: false, packed: false, per_line: 0)
+    types_ptr = FFI::MemoryPointer.new(:uint8, [types.length, 1].max)
+    types_ptr.write_array_of_uint8(types)
+    flags = (hex ? TABLE_HEX : 0) | (packed ? TABLE_PACKED : 0)
+    text = table_format(ptr, size, types_ptr, types.length, count, flags, per_line)
+    raise "Could not format #{count} table elements from #{size} bytes" if text.null?
+    begin
+      text_getData(text).read_string(text_getSize(text))
+    ensure
+      text_release(text)
+    end
+  end
+
   class OvtEntry < FFI::Struct
     layout :overlay_id,   :uint32,
            :ram_address,  :uint32,
@@ -176,11 +349,27 @@ module Nitro
       start_addr..end_addr
     end
 
+    # Contiguous address ranges backed by the data of this binary
+    def code_regions
+      [start_addr...end_addr]
+    end
+
+    # Changes whenever the binary is written to
+    def revision
+      codeBin_getRevision(@ptr)
+    end
+
+    # Addresses of the functions run by the static initializer table
+    def static_initializers
+      []
+    end
+    alias_method :sinits, :static_initializers
+
     def read(range = bounds, step = 4)
       raise ArgumentError, 'step must be 1, 2, 4, or 8 (bytes)' unless [1,2,4,8].include? step
       raise ArgumentError, 'range must be a Range' unless range.is_a? Range
 
-      clamped = Range.new(range.begin || start_addr, [range.end || end_addr, end_addr].min)
+      clamped = Range.new(range.begin || start_addr, [range.end || end_addr, end_addr].min, range.exclude_end?)
 
       clamped.step(step).map { |addr| [send(:"read#{step * 8}", addr), addr] }
     end
@@ -228,6 +417,13 @@ module Nitro
     end
     alias_method :get_sect_ptr, :get_section_ptr
 
+    # Pointer to the data of [addr, addr + size), or nil unless it all lies in one section (e.g. not spanning the
+    # static binary and an autoload block)
+    def get_range_ptr(addr, size)
+      ptr = codeBin_getRangePtr(@ptr, addr, size)
+      ptr.null? ? nil : ptr
+    end
+
   end
 
   class ArmBin < CodeBin
@@ -264,8 +460,9 @@ module Nitro
         armBin_load(@ptr, args[:file_path], args[:entry_addr], args[:ram_addr], args[:auto_load_hook_offset],
                     args[:is_arm9] || true)
 
-      elsif args.has_key?(:ptr) && args[:ptr].is_a?(FFI::AutoPointer)
+      elsif args.has_key?(:ptr) && args[:ptr].is_a?(FFI::Pointer)
         @ptr = args[:ptr]
+        @owner = args[:owner] # keeps the ROM that owns the binary alive
 
       else
         raise ArgumentError, 'ArmBin must be initialized with a file or a pointer'
@@ -283,6 +480,13 @@ module Nitro
     alias_method :entry_addr, :entry_point_address
     alias_method :entry_point_addr, :entry_point_address
 
+    def code_regions
+      autoload_start = @module_params[:autoload_start]
+      [start_addr...autoload_start] + @autoload_entries.filter { |e| e[:size] > 0 && e[:address] < start_addr }.map do |e|
+        e[:address]...(e[:address] + e[:size])
+      end
+    end
+
     def sane_address?(addr)
       armBin_sanityCheckAddress(@ptr, addr)
     end
@@ -293,10 +497,11 @@ module Nitro
   class OverlayBin < CodeBin
     include NitroBind
 
-    attr_reader :id
+    attr_reader :id, :ovt_entry
 
     def initialize(id, args = {})
       @id = id
+      @ovt_entry = args[:ovt_entry]
       if [:file_path, :ram_addr, :is_compressed].all? { |k| args.key?(k) }
         @ptr = FFI::AutoPointer.new(overlayBin_alloc, method(:overlayBin_release))
         if !File.exist? args[:file_path]
@@ -305,14 +510,23 @@ module Nitro
         end
         overlayBin_load(@ptr, args[:file_path], args[:ram_addr], args[:is_compressed], @id)
 
-      elsif args.has_key?(:ptr) && args[:ptr].is_a?(FFI::AutoPointer)
+      elsif args.has_key?(:ptr) && args[:ptr].is_a?(FFI::Pointer)
         @ptr = args[:ptr]
+        @owner = args[:owner] # keeps the ROM that owns the overlay alive
 
       else
         raise ArgumentError, 'OverlayBin must be initialized with a file or a pointer'
       end
     end
 
+    def static_initializers
+      return [] if @ovt_entry.nil?
+      sinit = @ovt_entry.sinit_bounds
+      return [] unless bounds.include?(sinit.begin) && bounds.include?(sinit.end)
+      read(sinit.begin...sinit.end).map(&:first).reject(&:zero?)
+    end
+    alias_method :sinits, :static_initializers
+
   end
 
   class HeaderBin
@@ -379,16 +593,315 @@ module Nitro
 
   end
 
+  class RomManifest
+    include NitroBind
+
+    class Entry < FFI::Struct
+      layout :hash,       :uint64,
+             :rom_offset, :uint32,
+             :size,       :uint32
+    end
+
+    class Checksums < FFI::Struct
+      layout :header_stored,        :uint16,
+             :header_computed,      :uint16,
+             :secure_area_stored,   :uint16,
+             :secure_area_computed, :uint16,
+             :logo_stored,          :uint16,
+             :logo_computed,        :uint16,
+             :banner_stored,        :uint16,
+             :banner_computed,      :uint16
+    end
+
+    attr_reader :header, :arm9, :arm7, :overlays, :files, :checksums
+
+    def initialize(ptr)
+      @ptr = ptr
+      @header = Entry.new(romManifest_getHeader(@ptr))
+      @arm9 = Entry.new(romManifest_getArm9(@ptr))
+      @arm7 = Entry.new(romManifest_getArm7(@ptr))
+      @overlays = read_entries(romManifest_getOverlays(@ptr), romManifest_getOverlayCount(@ptr))
+      @files = read_entries(romManifest_getFiles(@ptr), romManifest_getFileCount(@ptr))
+      @checksums = Checksums.new(romManifest_getChecksums(@ptr))
+    end
+
+    # Hash of every entry hash; changes whenever any part of the ROM does
+    def rom_key
+      romManifest_getRomKey(@ptr)
+    end
+
+    def overlay_hashes
+      @overlays.map { |e| e[:hash] }
+    end
+    alias_method :ov_hashes, :overlay_hashes
+
+    def file_hashes
+      @files.map { |e| e[:hash] }
+    end
+
+    def checksums_valid?
+      romManifest_checksumsValid(@ptr)
+    end
+
+    def to_h
+      {
+        rom_key: rom_key,
+        header: @header[:hash], arm9: @arm9[:hash], arm7: @arm7[:hash],
+        overlays: overlay_hashes, files: file_hashes
+      }
+    end
+
+private
+    def read_entries(ptr, count)
+      Array.new(count) { |i| Entry.new(ptr + i*Entry.size) }
+    end
+
+  end
+
+  # ARM9 memory with the static binary, its autoloads and any placed overlays laid out as at runtime, BSS zeroed.
+  # Regions are page-aligned buffers owned by the image, meant to be mapped into an emulator as they are
+  class MemoryImage
+    include NitroBind
+
+    class Region < FFI::Struct
+      layout :address, :uint32,
+             :size,    :uint32,
+             :data,    :pointer
+
+      def addr = self[:address]
+      def size = self[:size]
+      def ptr = self[:data]
+    end
+
+    attr_reader :regions
+
+    def initialize(rom_ptr)
+      @rom_ptr = rom_ptr
+      image_ptr = memoryImage_build(rom_ptr)
+      raise 'Failed to build ARM9 memory image.' if image_ptr.null?
+      @ptr = FFI::AutoPointer.new(image_ptr, method(:memoryImage_release))
+      @regions = Array.new(memoryImage_getRegionCount(@ptr)) { |i| Region.new(memoryImage_getRegion(@ptr, i)) }
+    end
+
+    # Copies an overlay in and zeroes its BSS
+    def place_overlay(id)
+      memoryImage_placeOverlay(@ptr, @rom_ptr, id)
+    end
+    alias_method :place_ov, :place_overlay
+
+    # Whether each [page address, hash] pair still holds
+    def pages_match?(inputs)
+      return true if inputs.empty?
+      addrs = FFI::MemoryPointer.new(:uint32, inputs.length).write_array_of_uint32(inputs.map(&:first))
+      hashes = FFI::MemoryPointer.new(:uint64, inputs.length).write_array_of_uint64(inputs.map(&:last))
+      memoryImage_pagesMatch(@ptr, addrs, hashes, inputs.length)
+    end
+
+    def access_trace
+      AccessTrace.new(@ptr)
+    end
+
+  end
+
+  #
+  # Records the pages of a memory image an emulated call depends on and the bytes it writes, through Unicorn hooks
+  # that call straight into the library
+  #
+  class AccessTrace
+    include NitroBind
+
+    class PageInput < FFI::Struct
+      layout :address, :uint32,
+             :hash,    :uint64
+    end
+
+    class Write < FFI::Struct
+      layout :address,     :uint32,
+             :size,        :uint32,
+             :data_offset, :uint32
+    end
+
+    # Pass as the callbacks of UC_HOOK_BLOCK and UC_HOOK_MEM_READ/UC_HOOK_MEM_WRITE, with ptr as user data
+    BLOCK_HOOK = NitroBind.ffi_libraries.first.find_function('accessTrace_blockHook')
+    MEM_HOOK = NitroBind.ffi_libraries.first.find_function('accessTrace_memHook')
+
+    attr_reader :ptr
+
+    def initialize(image_ptr)
+      trace_ptr = accessTrace_alloc(image_ptr)
+      raise 'Failed to allocate access trace.' if trace_ptr.null?
+      @ptr = FFI::AutoPointer.new(trace_ptr, method(:accessTrace_release))
+    end
+
+    # Records whatever runs in the block, which is left to the caller to run through the hooked emulator
+    def record
+      accessTrace_start(@ptr)
+      yield
+    ensure
+      accessTrace_finish(@ptr)
+    end
+
+    # Whether every access was within the memory image
+    def complete?
+      accessTrace_isComplete(@ptr)
+    end
+
+    # [page address, hash] of every page read before the call wrote to it
+    def inputs
+      base = accessTrace_getInputs(@ptr)
+      Array.new(accessTrace_getInputCount(@ptr)) do |i|
+        input = PageInput.new(base + i * PageInput.size)
+        [input[:address], input[:hash]]
+      end
+    end
+
+    # [address, bytes] of every run of written bytes, with their final values
+    def writes
+      base = accessTrace_getWrites(@ptr)
+      data = accessTrace_getWriteData(@ptr)
+      Array.new(accessTrace_getWriteCount(@ptr)) do |i|
+        write = Write.new(base + i * Write.size)
+        [write[:address], data.get_bytes(write[:data_offset], write[:size])]
+      end
+    end
+
+  end
+
+  #
+  # A file of a ROM or archive read in place, without copying it out; the view keeps whatever owns the memory alive
+  #
+  class FileView
+    attr_reader :ptr, :size
+
+    def initialize(ptr, size, owner)
+      @ptr = ptr
+      @size = size
+      @owner = owner
+    end
+
+    def read(offset = 0, length = @size - offset)
+      check_bounds(offset, length)
+      @ptr.get_bytes(offset, length)
+    end
+    alias_method :bytes, :read
+
+    def read64(offset)
+      check_bounds(offset, 8)
+      @ptr.get_uint64(offset)
+    end
+
+    def read32(offset)
+      check_bounds(offset, 4)
+      @ptr.get_uint32(offset)
+    end
+
+    def read16(offset)
+      check_bounds(offset, 2)
+      @ptr.get_uint16(offset)
+    end
+
+    def read8(offset)
+      check_bounds(offset, 1)
+      @ptr.get_uint8(offset)
+    end
+
+    alias_method :read_dword, :read64
+    alias_method :read_word, :read32
+    alias_method :read_hword, :read16
+    alias_method :read_byte, :read8
+
+    # Reads count elements of an FFI integer type (e.g. :uint16) from offset
+    def read_array(offset, type, count)
+      check_bounds(offset, FFI.type_size(type) * count)
+      @ptr.send(:"get_array_of_#{type}", offset, count)
+    end
+
+    # Opens this file as a NARC archive, whose files are views into this one
+    def narc
+      Narc.new(self)
+    end
+
+private
+    def check_bounds(offset, length)
+      if offset.negative? || length.negative? || offset + length > @size
+        raise IndexError, "#{length} bytes at 0x#{offset.to_s(16)} is out of bounds of a file of #{@size} bytes"
+      end
+    end
+
+  end
+
+  #
+  # NARC archive parsed natively; its files are views into the archive, except compressed ones asked for uncompressed,
+  # which are uncompressed once into memory owned by the archive
+  #
+  class Narc
+    include NitroBind
+
+    def initialize(view)
+      @view = view # keeps the memory the archive is read from alive
+      @ptr = FFI::AutoPointer.new(narc_alloc, method(:narc_release))
+      raise 'Invalid NARC archive.' unless narc_load(@ptr, view.ptr, view.size)
+      @narcs = {}
+    end
+
+    def file_count
+      narc_getFileCount(@ptr)
+    end
+    alias_method :count, :file_count
+
+    # The ID of the file at a path, or nil if there is none
+    def find_file(path)
+      id = narc_findFile(@ptr, path)
+      id.negative? ? nil : id
+    end
+
+    # The path of a file, or nil if the archive doesn't name it
+    def file_path(id)
+      path = narc_getFilePath(@ptr, id)
+      path.empty? ? nil : path
+    end
+
+    def file(id_or_path, decompress: false)
+      id = resolve_id(id_or_path)
+      size = FFI::MemoryPointer.new(:uint32)
+      ptr = decompress ? narc_getUncompressedFile(@ptr, id, size) : narc_getFile(@ptr, id, size)
+      FileView.new(ptr, size.read_uint32, self)
+    end
+
+    # A nested archive, parsed once
+    def narc(id_or_path, decompress: true)
+      @narcs[[resolve_id(id_or_path), decompress]] ||= file(id_or_path, decompress:).narc
+    end
+
+    def each_file(decompress: false)
+      file_count.times { |id| yield file(id, decompress:), id }
+    end
+
+private
+    def resolve_id(id_or_path)
+      id = id_or_path.is_a?(String) ? find_file(id_or_path) : id_or_path
+      raise IndexError, "No file '#{id_or_path}' in NARC archive" if id.nil? || id.negative? || id >= file_count
+      id
+    end
+
+  end
+
   class Rom
     include NitroBind
 
-    attr_reader :header, :arm9, :arm7, :overlays, :overlay_count, :overlay_table
+    attr_reader :header, :overlays, :overlay_count, :overlay_table
 
     alias_method :ov_count, :overlay_count
     alias_method :ov_table, :overlay_table
     alias_method :ovt, :overlay_table
 
-    def initialize(file_path)
+    class << self
+      # Whether ROMs are read into memory rather than mapped, set by a resident server so that a ROM rewritten while
+      # it's loaded (e.g. the target ROM by NCPatcher) can't fault or mix old and new contents
+      attr_accessor :copy_files
+    end
+
+    def initialize(file_path, copy: Rom.copy_files)
       @ptr = FFI::AutoPointer.new(nitroRom_alloc, method(:nitroRom_release))
 
       # Check whether file exists here because if C++ throws an exception we get a segfault
@@ -397,42 +910,124 @@ module Nitro
         raise "Rom initialization failed"
       end
 
-      nitroRom_load(@ptr, file_path)
+      # Only the header and tables are read here; binaries are decompressed when first accessed
+      raise "Rom initialization failed: #{file_path} is not a valid NDS ROM" unless nitroRom_load(@ptr, file_path, !!copy)
       @header = HeaderBin.new(nitroRom_getHeader(@ptr))
-      @arm9 = ArmBin.new(ptr: FFI::AutoPointer.new(nitroRom_loadArm9(@ptr), method(:armBin_release)))
-      @arm7 = ArmBin.new(ptr: FFI::AutoPointer.new(nitroRom_loadArm7(@ptr), method(:armBin_release)))
       @overlay_count = nitroRom_getOverlayCount(@ptr)
       @overlays = Array.new(@overlay_count)
       @overlay_table = OvtBin.new(ptr: nitroRom_getArm9OvT(@ptr), size: @header.arm9_ovt_size)
       define_ov_accessors
     end
 
+    # Binaries are decompressed into memory owned by the ROM, so they are not released individually
+    def arm9
+      @arm9 ||= @identical_arm9&.arm9 || begin
+        arm9_ptr = nitroRom_loadArm9(@ptr)
+        raise 'Failed to load arm9.' if arm9_ptr.null?
+        ArmBin.new(ptr: arm9_ptr, owner: @ptr)
+      end
+    end
+
+    def arm7
+      @arm7 ||= begin
+        arm7_ptr = nitroRom_loadArm7(@ptr)
+        raise 'Failed to load arm7.' if arm7_ptr.null?
+        ArmBin.new(ptr: arm7_ptr, owner: @ptr)
+      end
+    end
+
     def size
       nitroRom_getSize(@ptr)
     end
 
     def get_file(id)
-      nitroRom_getFile(id)
+      nitroRom_getFile(@ptr, id)
     end
 
     def get_file_size(id)
-      nitroRom_getFileSize(id)
+      nitroRom_getFileSize(@ptr, id)
+    end
+
+    # The ID of the file at a path of the ROM's filesystem, or nil if there is none
+    def find_file(path)
+      id = nitroRom_findFile(@ptr, path)
+      id.negative? ? nil : id
+    end
+
+    # The path of a file, or nil if it has none (e.g. overlays)
+    def file_path(id)
+      path = nitroRom_getFilePath(@ptr, id)
+      path.empty? ? nil : path
+    end
+
+    # A file of the ROM's filesystem by ID or path, read in place
+    def file(id_or_path)
+      id = id_or_path.is_a?(String) ? find_file(id_or_path) : id_or_path
+      raise IndexError, "No file '#{id_or_path}' in ROM" if id.nil? || id.negative? || id >= file_count
+      ptr = nitroRom_getFile(@ptr, id)
+      raise "File #{id} lies outside the ROM" if ptr.null?
+      FileView.new(ptr, nitroRom_getFileSize(@ptr, id), @ptr)
+    end
+
+    # A NARC archive of the ROM's filesystem, parsed once
+    def narc(id_or_path)
+      (@narcs ||= {})[id_or_path] ||= file(id_or_path).narc
+    end
+
+    def file_count
+      nitroRom_getFileCount(@ptr)
+    end
+
+    # Content hashes of every part of the ROM, plus its stored and computed checksums
+    def manifest(thread_count: 0)
+      @manifest ||= begin
+        manifest_ptr = nitroRom_buildManifest(@ptr, thread_count)
+        raise 'Failed to build ROM manifest.' if manifest_ptr.null?
+        RomManifest.new(FFI::AutoPointer.new(manifest_ptr, method(:romManifest_release)))
+      end
+    end
+
+    # Takes the binaries of another ROM wherever both are byte-identical and loaded the same way (e.g. overlays left
+    # alone between regions of a game), so each is only decompressed once and everything cached on it is shared.
+    # Binaries already loaded, or already shared with another ROM, are kept
+    def share_identical(other)
+      ours, theirs = manifest, other.manifest
+      same_entry = ->(a, b) { a[:hash] == b[:hash] && a[:size] == b[:size] }
+
+      arm9_fields = %i[arm9_ram_address arm9_entry_address arm9_auto_load_hook_offset]
+      if same_entry.(ours.arm9, theirs.arm9) && arm9_fields.all? { header.send(it) == other.header.send(it) }
+        @identical_arm9 ||= other
+      end
+
+      @identical_overlays ||= {}
+      [@overlay_count, other.overlay_count].min.times do |id|
+        next unless same_entry.(ours.overlays[id], theirs.overlays[id])
+        ovte, other_ovte = @overlay_table.get_entry(id), other.overlay_table.get_entry(id)
+        next unless ovte.pointer.get_bytes(0, OvtEntry.size) == other_ovte.pointer.get_bytes(0, OvtEntry.size)
+        @identical_overlays[id] ||= other
+      end
+    end
+
+    # A fresh image of ARM9 memory; each one is independent, so one can be handed to an emulator to write to
+    def memory_image
+      MemoryImage.new(@ptr)
     end
 
     def nitro_sdk_version
-      @arm9.module_params[:sdk_version_id]
+      arm9.module_params[:sdk_version_id]
     end
 
     def load_overlay(id)
       raise IndexError if id > @overlay_count-1
       ov_ptr = nitroRom_loadOverlay(@ptr, id)
-      raise "Failed to load overlay #{id}." if !ov_ptr
-      @overlays[id] = OverlayBin.new(id, ptr: FFI::AutoPointer.new(ov_ptr, method(:overlayBin_release)))
+      raise "Failed to load overlay #{id}." if ov_ptr.null?
+      @overlays[id] = OverlayBin.new(id, ptr: ov_ptr, owner: @ptr, ovt_entry: @overlay_table.get_entry(id))
     end
     alias_method :load_ov, :load_overlay
 
     def get_overlay(id)
       raise IndexError if id > @overlay_count-1
+      @overlays[id] ||= @identical_overlays&.[](id)&.get_overlay(id)
       load_overlay(id) if @overlays[id].nil?
       @overlays[id]
     end
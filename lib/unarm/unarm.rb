@@ -13,14 +13,19 @@ module UnarmBind
   typedef :pointer, :parser_handle
   typedef :pointer, :symbols_handle
   typedef :pointer, :ins_args_handle
+  typedef :pointer, :decoded_table_handle
+  typedef :pointer, :function_map_handle
+  typedef :pointer, :symbol_index_handle
+  typedef :pointer, :ins_index_handle
+  typedef :pointer, :dataflow_handle
 
   attach_function :arm9_new_arm_ins, [:uint32], :ins_handle
   attach_function :arm9_new_thumb_ins, [:uint32], :ins_handle
   attach_function :arm7_new_arm_ins, [:uint32], :ins_handle
   attach_function :arm7_new_thumb_ins, [:uint32], :ins_handle
 
-  attach_function :arm9_new_parser, [:uint32], :parser_handle
-  attach_function :arm7_new_parser, [:uint32], :parser_handle
+  attach_function :arm9_new_parser, [:uint32, :uint32, :pointer, :uint32], :parser_handle
+  attach_function :arm7_new_parser, [:uint32, :uint32, :pointer, :uint32], :parser_handle
   
   attach_function :arm9_arm_ins_to_str, [:ins_handle], :cstr_handle
   attach_function :arm7_arm_ins_to_str, [:ins_handle], :cstr_handle
@@ -64,6 +69,44 @@ module UnarmBind
   attach_function :arm7_free_parser, [:parser_handle], :void
   attach_function :free_c_str, [:cstr_handle], :void
 
+  attach_function :disasm_export_to_file, [:pointer, :uint32, :uint32, :uint32, :string], :bool, blocking: true
+  attach_function :disasm_export_to_buffer, [:pointer, :uint32, :uint32, :uint32, :pointer], :pointer, blocking: true
+  attach_function :free_disasm_buffer, [:pointer, :size_t], :void
+
+  attach_function :decoded_table_new, [:pointer, :uint32, :uint32, :bool, :bool], :decoded_table_handle
+  attach_function :decoded_table_get, [:decoded_table_handle, :uint32, :pointer], :bool
+  attach_function :decoded_table_find_branch_to,
+    [:decoded_table_handle, :uint32, :uint32, :pointer, :uint32, :pointer, :pointer], :bool
+  attach_function :decoded_table_invalidate, [:decoded_table_handle], :void
+  attach_function :free_decoded_table, [:decoded_table_handle], :void
+
+  attach_function :function_map_build, [:pointer, :uint32, :uint32, :bool, :pointer, :uint32], :function_map_handle,
+                  blocking: true
+  attach_function :function_map_count, [:function_map_handle], :uint32
+  attach_function :function_map_get, [:function_map_handle, :uint32, :pointer], :bool
+  attach_function :function_map_find, [:function_map_handle, :uint32, :pointer], :bool
+  attach_function :function_map_find_containing, [:function_map_handle, :uint32, :pointer], :bool
+  attach_function :function_map_classify, [:function_map_handle, :uint32], :uint8
+  attach_function :free_function_map, [:function_map_handle], :void
+
+  attach_function :ins_index_build, [:pointer, :uint32, :uint32, :bool, :function_map_handle], :ins_index_handle,
+                  blocking: true
+  attach_function :ins_index_count, [:ins_index_handle], :uint32
+  attach_function :ins_index_query, [:ins_index_handle, :pointer, :pointer], :pointer
+  attach_function :free_ins_index_results, [:pointer, :uint32], :void
+  attach_function :free_ins_index, [:ins_index_handle], :void
+
+  attach_function :dataflow_analyze, [:pointer, :uint32, :uint32, :pointer, :bool], :dataflow_handle, blocking: true
+  attach_function :dataflow_get_regs, [:dataflow_handle, :uint32, :pointer], :bool
+  attach_function :free_dataflow, [:dataflow_handle], :void
+
+  attach_function :demangle_symbols, [:pointer, :uint32, :uint32, :pointer, :pointer], :pointer, blocking: true
+  attach_function :free_demangle_arena, [:pointer, :size_t], :void
+
+  attach_function :symbol_index_new, [:pointer, :uint32], :symbol_index_handle
+  attach_function :symbol_index_suggest, [:symbol_index_handle, :string, :uint32, :double, :pointer, :pointer], :uint32
+  attach_function :free_symbol_index, [:symbol_index_handle], :void
+
   # NOTE: some of the following instructions are not valid in ARMv5TE/v4T
   OPCODE = [
     :illegal, :adc, :add, :and, :asr, :b, :bl, :bic, :bkpt, :blxi,
@@ -418,69 +461,48 @@ module Unarm
 
   def self.raw_syms = @raw_syms
 
-  def self.shitty_demangle(sym)
-    return sym unless sym.start_with?('_Z')
-
-    sym = sym[2..]
-
-    is_vtable = false
-
-    if sym.start_with? 'NK'
-      sym = sym[2..]
-
-    elsif sym.start_with? 'N'
-      sym = sym[1..]
-
-    elsif sym.start_with? 'TV'
-      sym = sym[(sym[2] == 'N' ? 3 : 2)..]
-      is_vtable = true
-
-    end
-
-    names = []
-    loop do
-      break if sym.nil? || sym.empty? || !sym[0].match?(/\d/)
-      len_end = sym.index(/\D/)
-      n_len   = Integer(sym[...len_end], exception: false)
-      n       = sym[len_end, n_len]
-      names   << n
-      sym     = sym[len_end + n_len..]
-    end
+  # The loaded symbols and everything derived from them, so several symbol sets can be swapped in and out
+  def self.symbol_state = [@symbols9, @symbols7, @raw_syms]
 
-    unless sym.nil?
-      if sym.start_with? 'nw'
-        names << 'new'
-
-      elsif sym.start_with? 'na'
-        names << 'new[]'
-
-      elsif sym.start_with? 'dl'
-        names << 'delete'
-
-      elsif sym.start_with? 'da'
-        names << 'delete[]'
-
-      elsif sym.start_with? 'eq'
-        names << '=='
-
-      elsif sym.start_with? 'ne'
-        names << '!='
+  def self.symbol_state=(state)
+    @symbols9, @symbols7, @raw_syms = state
+  end
 
-      elsif sym.match? /[DC]\d/
-        names << sym[..1]
+  # Demangles every name in one native call (spread across thread_count threads, 0 meaning all cores)
+  # Returns an array of [full, short] pairs; full is the complete signature (telling overloads apart), and
+  # short is the qualified name alone (e.g. 'Foo::bar', 'Foo::C1', 'Foo::vtable'). Unmangled names are kept as is
+  def self.demangle_all(names, thread_count: 0)
+    return [] if names.empty?
+
+    name_ptrs = names.map { FFI::MemoryPointer.from_string(it) }
+    names_ptr = FFI::MemoryPointer.new(:pointer, names.length)
+    names_ptr.write_array_of_pointer(name_ptrs)
+    offsets_ptr = FFI::MemoryPointer.new(:uint32, names.length * 2)
+    size_ptr = FFI::MemoryPointer.new(:size_t)
+
+    arena = demangle_symbols(names_ptr, names.length, thread_count, offsets_ptr, size_ptr)
+    begin
+      offsets_ptr.read_array_of_uint32(names.length * 2).each_slice(2).map do |full, short|
+        [arena.get_string(full).force_encoding('UTF-8'), arena.get_string(short).force_encoding('UTF-8')]
       end
+    ensure
+      free_demangle_arena(arena, size_ptr.read(:size_t))
     end
+  end
 
-    names.join('::') + (is_vtable ? '::vtable' : '')
+  def self.demangle(sym, full: false)
+    demangle_all([sym], thread_count: 1)[0][full ? 0 : 1]
   end
 
+  def self.shitty_demangle(sym) = demangle(sym) # kept for existing callers
+
   class Symbol < FFI::Struct
     layout :name, :pointer,
            :addr, :uint32
   end
 
   class Symbols
-    attr_reader :map, :locs, :count, :demangled_map, :ambig_demangled
+    attr_reader :map, :locs, :count, :demangled, :demangled_map, :ambig_demangled
 
     def self.load(file_path)
       syms = {} # maps symbol names to their addresses
@@ -539,19 +561,68 @@ module Unarm
 
       @count = @map.length
 
+      # maps mangled names to their [full, short] demangled names; a subset reuses its parent's, and names found in
+      # args[:demangled] (e.g. those of another region's symbols) aren't demangled again
+      if args.has_key?(:syms) && args[:syms].demangled
+        @demangled = args[:syms].demangled
+      elsif args.has_key?(:demangled)
+        known = args[:demangled]
+        missing = @map.keys.reject { known.key?(it) }
+        fresh = missing.zip(Unarm.demangle_all(missing)).to_h
+        @demangled = @map.keys.to_h { [it, known[it] || fresh[it]] }
+      else
+        names = @map.keys
+        @demangled = names.zip(Unarm.demangle_all(names)).to_h
+      end
+
       @demangled_map = {}
-      @ambig_demangled = []
+      @ambig_demangled = [] # [short, addr, full] of each overload shadowed by an earlier one
 
       @map.each do |sym, addr|
-        demangled = Unarm.shitty_demangle(sym)
-        if @demangled_map[demangled].nil?
-          @demangled_map[demangled] = sym
-        else
-          @ambig_demangled << [demangled, addr]
+        full, short = @demangled[sym]
+        @demangled_map[full] ||= sym
+        next if short == full # unmangled, or a name without a signature
+
+        owner = @demangled_map[short]
+        if owner.nil?
+          @demangled_map[short] = sym
+        elsif owner != sym
+          @ambig_demangled << [short, addr, full]
         end
       end
     end
 
+    # Approximate-match index over the mangled (or demangled) names, built on first use
+    def suggestion_index(demangled: false)
+      @suggestion_indices ||= {}
+      @suggestion_indices[demangled] ||= SymbolIndex.new(demangled ? @demangled_map.keys : @map.keys)
+    end
+
+  end
+
+  class SymbolIndex
+    include UnarmBind
+
+    attr_reader :names
+
+    def initialize(names)
+      @names = names
+      name_ptrs = names.map { FFI::MemoryPointer.from_string(it) }
+      names_ptr = FFI::MemoryPointer.new(:pointer, [names.length, 1].max)
+      names_ptr.write_array_of_pointer(name_ptrs)
+      @ptr = FFI::AutoPointer.new(symbol_index_new(names_ptr, names.length), method(:free_symbol_index))
+    end
+
+    # Up to max [name, score] pairs most similar to query, best first. Scores blend Jaro-Winkler similarity
+    # (weighted by jaro_weight) with normalized Levenshtein distance, ranging from 0 to 1
+    def suggest(query, max: 1, jaro_weight: 0.7)
+      ids_ptr = FFI::MemoryPointer.new(:uint32, max)
+      scores_ptr = FFI::MemoryPointer.new(:double, max)
+      found = symbol_index_suggest(@ptr, query.to_s, max, jaro_weight, ids_ptr, scores_ptr)
+      ids_ptr.read_array_of_uint32(found).zip(scores_ptr.read_array_of_double(found)).map do |id, score|
+        [@names[id], score]
+      end
+    end
   end
 
   class RawSymbols # symbols that can be passed to Rust
@@ -574,12 +645,63 @@ module Unarm
 
   end
 
+  class DisasmTarget < FFI::Struct
+    layout :data,         :pointer,
+           :data_size,    :uint32,
+           :addr,         :uint32,
+           :name,         :pointer,
+           :symbols,      :pointer,
+           :symbol_count, :uint32,
+           :arm7,         :bool,
+           :thumb,        :bool
+  end
+
+  EXPORT_FORMAT = { text: 0, binary: 1 }.freeze
+
+  # Disassembles every target natively across all cores, writing to the given path or returning the listing.
+  # Each target is a hash with :ptr, :size, :addr and optionally :name, :loc (for symbols), :arm7 and :thumb
+  def self.export_disassembly(targets, path: nil, format: :text, thread_count: 0)
+    raise ArgumentError, "format must be one of #{EXPORT_FORMAT.keys.join(', ')}" unless EXPORT_FORMAT.key? format
+
+    keep_alive = []
+    c_targets = FFI::MemoryPointer.new(DisasmTarget, targets.length)
+    targets.each_with_index do |t, i|
+      c_target = DisasmTarget.new(c_targets + i*DisasmTarget.size)
+      c_target[:data] = t[:ptr]
+      c_target[:data_size] = t[:size]
+      c_target[:addr] = t[:addr]
+      if t[:name]
+        keep_alive << (name_ptr = FFI::MemoryPointer.from_string(t[:name]))
+        c_target[:name] = name_ptr
+      end
+      syms = t[:loc] && (t[:arm7] ? @symbols7 : @symbols9) ? get_raw_symbols(t[:loc]) : nil
+      c_target[:symbols] = syms ? syms.ptr : FFI::Pointer::NULL
+      c_target[:symbol_count] = syms ? syms.count : 0
+      c_target[:arm7] = t[:arm7] || false
+      c_target[:thumb] = t[:thumb] || false
+    end
+
+    if path
+      return disasm_export_to_file(c_targets, targets.length, EXPORT_FORMAT[format], thread_count, path)
+    end
+
+    size_ptr = FFI::MemoryPointer.new(:size_t)
+    buf = disasm_export_to_buffer(c_targets, targets.length, EXPORT_FORMAT[format], thread_count, size_ptr)
+    raise 'Failed to export disassembly.' if buf.null?
+    size = size_ptr.read(:size_t)
+    out = buf.read_bytes(size)
+    free_disasm_buffer(buf, size)
+    format == :text ? out.force_encoding('UTF-8') : out
+  end
+
   def self.load_symbols9(file_path)
     @symbols9 = Symbols.new(file_path: file_path)
+    @raw_syms = {}
   end
 
   def self.load_symbols7(file_path)
     @symbols7 = Symbols.new(file_path: file_path)
+    @raw_syms = {}
   end
 
   def self.symbol_map
@@ -755,6 +877,373 @@ module Unarm
 
   end
 
+  # Fields of an instruction read from a DecodedTable; no Rust instruction or string is allocated for it
+  class DecodedIns < FFI::Struct
+    layout :opcode,      :uint16,
+           :cond,        :uint8,
+           :flags,       :uint8,
+           :branch_dest, :uint32,
+           :target_addr, :uint32
+
+    CONDITIONAL     = 1 << 0
+    DATA_OP         = 1 << 1
+    SETS_FLAGS      = 1 << 2
+    FUNCTION_END    = 1 << 3
+    BRANCH_TO_REG   = 1 << 4
+    ILLEGAL         = 1 << 5
+    HAS_BRANCH_DEST = 1 << 6
+    HAS_TARGET      = 1 << 7
+
+    def opcode
+      UnarmBind::OPCODE[self[:opcode]]
+    end
+
+    def mnemonic
+      UnarmBind::OPCODE_MNEMONIC[self[:opcode]]
+    end
+
+    def condition
+      UnarmBind::CONDITION[self[:cond]]
+    end
+    alias_method :cond, :condition
+
+    def flag?(flag)
+      self[:flags] & flag != 0
+    end
+
+    def is_conditional?   = flag?(CONDITIONAL)
+    def is_data_operation? = flag?(DATA_OP)
+    def sets_flags?       = flag?(SETS_FLAGS)
+    def function_end?     = flag?(FUNCTION_END)
+    def branch_to_register? = flag?(BRANCH_TO_REG)
+    def is_illegal?       = flag?(ILLEGAL)
+
+    alias_method :conditional?, :is_conditional?
+    alias_method :is_data_op?, :is_data_operation?
+    alias_method :branch_to_reg?, :branch_to_register?
+    alias_method :illegal?, :is_illegal?
+
+    def branch_destination
+      flag?(HAS_BRANCH_DEST) ? self[:branch_dest] : nil
+    end
+    alias_method :branch_dest, :branch_destination
+
+    def target_address
+      flag?(HAS_TARGET) ? self[:target_addr] : nil
+    end
+    alias_method :target_addr, :target_address
+  end
+
+  # Instruction fields of a code region, decoded natively a page at a time on first access
+  class DecodedTable
+    include UnarmBind
+
+    attr_reader :start_addr, :size, :thumb
+
+    # owner is whatever keeps the memory at data_ptr alive (e.g. the code binary it's in); it must invalidate the
+    # table whenever that memory is written to
+    def initialize(data_ptr, size, addr, thumb: false, arm7: false, owner: nil)
+      @data_ptr = data_ptr
+      @owner = owner
+      @start_addr = addr
+      @size = size
+      @thumb = thumb
+      @ptr = FFI::AutoPointer.new(decoded_table_new(data_ptr, size, addr, thumb, arm7), method(:free_decoded_table))
+    end
+
+    def include?(addr)
+      addr >= @start_addr && addr < @start_addr + @size
+    end
+
+    def [](addr)
+      ins = DecodedIns.new
+      decoded_table_get(@ptr, addr, ins) ? ins : nil
+    end
+
+    # Returns the address of the first branch in start_addr...end_addr to one of dests, and whether a function end
+    # was passed on the way
+    def find_branch_to(dests, start_addr, end_addr = @start_addr + @size)
+      dests_ptr = FFI::MemoryPointer.new(:uint32, dests.length)
+      dests_ptr.write_array_of_uint32(dests)
+      addr_ptr = FFI::MemoryPointer.new(:uint32)
+      passed_end_ptr = FFI::MemoryPointer.new(:bool)
+      return nil unless decoded_table_find_branch_to(@ptr, start_addr, end_addr, dests_ptr, dests.length,
+                                                     addr_ptr, passed_end_ptr)
+      [addr_ptr.read_uint32, passed_end_ptr.read(:bool)]
+    end
+
+    def invalidate
+      decoded_table_invalidate(@ptr)
+    end
+  end
+
+  class FunctionInfo < FFI::Struct
+    layout :start,      :uint32,
+           :end,        :uint32,
+           :pool_start, :uint32,
+           :pool_end,   :uint32,
+           :thumb,      :bool
+
+    def start_addr = self[:start]
+    def end_addr   = self[:end]
+    def thumb?     = self[:thumb]
+
+    # Address as it would be called, i.e. with bit 0 set for Thumb
+    def addr = thumb? ? start_addr | 1 : start_addr
+
+    # Size of the code, not including the literal pool
+    def size = end_addr - start_addr
+
+    def pool = self[:pool_start]...self[:pool_end]
+    def extent_end = [end_addr, self[:pool_end]].max
+    def include?(addr) = addr >= start_addr && addr < extent_end
+
+    def to_h
+      { start: start_addr, end: end_addr, pool_start: self[:pool_start], pool_end: self[:pool_end], thumb: thumb? }
+    end
+  end
+
+  # Every function reachable from a set of seeds (entry point, symbols, static initializers) through bl/blx,
+  # swept once for the whole code region
+  class FunctionMap
+    include UnarmBind
+    include Enumerable
+
+    CLASSIFICATION = [:unknown, :arm, :thumb, :literal_pool].freeze
+
+    attr_reader :ptr, :start_addr, :size
+
+    def initialize(data_ptr, size, addr, seeds, arm7: false)
+      @data_ptr = data_ptr
+      @start_addr = addr
+      @size = size
+      seeds_ptr = FFI::MemoryPointer.new(:uint32, [seeds.length, 1].max)
+      seeds_ptr.write_array_of_uint32(seeds)
+      @ptr = FFI::AutoPointer.new(function_map_build(data_ptr, size, addr, arm7, seeds_ptr, seeds.length),
+                                  method(:free_function_map))
+    end
+
+    def count = function_map_count(@ptr)
+    alias_method :length, :count
+
+    def each
+      return to_enum(:each) unless block_given?
+      count.times do |i|
+        info = FunctionInfo.new
+        yield info if function_map_get(@ptr, i, info)
+      end
+    end
+
+    def include?(addr)
+      addr >= @start_addr && addr < @start_addr + @size
+    end
+
+    # Function starting at addr (the Thumb bit is ignored)
+    def [](addr)
+      info = FunctionInfo.new
+      function_map_find(@ptr, addr, info) ? info : nil
+    end
+
+    # Function whose code or literal pool contains addr
+    def containing(addr)
+      info = FunctionInfo.new
+      function_map_find_containing(@ptr, addr, info) ? info : nil
+    end
+
+    # Whether addr is ARM code, Thumb code, literal pool data, or not covered by any known function
+    def classify(addr)
+      CLASSIFICATION[function_map_classify(@ptr, addr)]
+    end
+  end
+
+  #
+  # Structured instruction pattern, matched natively against the decoded fields of an InsIndex. A query is an
+  # opcode followed by the registers of its operands in order and field constraints, separated by spaces or commas:
+  #
+  #   ldr _ pc value=0x02001234   any ldr from a literal pool holding 0x02001234
+  #   mov r0 imm=5                any mov into r0 of the immediate 5
+  #   bl dest=0x02004000          calls to 0x02004000
+  #   reg=r4 mode=thumb           any Thumb instruction using r4
+  #
+  # The opcode is a mnemonic (covering every encoding of it, e.g. 'mov') or an opcode name (e.g. 'movimm'), and can
+  # be left out or given as '*'; registers can be '_' to match any. The fields are imm (the first immediate or
+  # offset), dest (branch destination), target (address of the literal loaded by a pc-relative ldr), value (the
+  # literal itself), cond, mode (arm or thumb) and reg (a register in any position)
+  #
+  class InsPattern
+    include UnarmBind
+
+    class Layout < FFI::Struct
+      layout :opcodes,      :pointer,
+             :opcode_count, :uint32,
+             :cond,         :uint8,
+             :mode,         :uint8,
+             :regs,         [:uint8, 4],
+             :any_reg,      :uint8,
+             :fields,       :uint32,
+             :imm,          :uint32,
+             :branch_dest,  :uint32,
+             :target_addr,  :uint32,
+             :value,        :uint32
+    end
+
+    ANY = 255
+
+    FIELD_IMM         = 1 << 0
+    FIELD_BRANCH_DEST = 1 << 1
+    FIELD_TARGET      = 1 << 2
+    FIELD_VALUE       = 1 << 3
+    FIELD_ANY_REG     = 1 << 4
+
+    VALUE_FIELDS = {
+      'imm' => [:imm, FIELD_IMM], 'dest' => [:branch_dest, FIELD_BRANCH_DEST],
+      'target' => [:target_addr, FIELD_TARGET], 'value' => [:value, FIELD_VALUE]
+    }.freeze
+
+    MODES = { 'arm' => 1, 'thumb' => 2 }.freeze
+
+    REGISTER_ALIASES = { sb: 9, sl: 10, fp: 11, ip: 12, r13: 13, r14: 14, r15: 15 }.freeze
+
+    attr_reader :query, :layout
+
+    # Values that aren't numbers (e.g. symbol names) are passed to resolve
+    def initialize(query, resolve: nil)
+      @query = query
+      @layout = Layout.new
+      @layout[:cond] = ANY
+      4.times { @layout[:regs][it] = ANY }
+
+      tokens = query.strip.split(/[\s,]+/)
+      opcodes = opcode_ids(tokens.first) unless tokens.empty? || tokens.first.include?('=') || register_id(tokens.first)
+      tokens.shift unless opcodes.nil?
+
+      reg_pos = 0
+      tokens.each do |token|
+        key, val = token.split('=', 2)
+        if val.nil?
+          raise ArgumentError, "Too many registers in instruction pattern '#{query}'" if reg_pos >= 4
+          @layout[:regs][reg_pos] = key == '_' ? ANY : register_id!(key)
+          reg_pos += 1
+        elsif (field = VALUE_FIELDS[key])
+          @layout[field[0]] = parse_value(val, resolve) & 0xFFFFFFFF
+          @layout[:fields] |= field[1]
+        elsif key == 'cond'
+          cond = CONDITION_MAP[val.to_sym] or raise ArgumentError, "Unknown condition '#{val}'"
+          @layout[:cond] = cond
+        elsif key == 'mode'
+          mode = MODES[val] or raise ArgumentError, "Unknown mode '#{val}' (expected arm or thumb)"
+          @layout[:mode] = mode
+        elsif key == 'reg'
+          @layout[:any_reg] = register_id!(val)
+          @layout[:fields] |= FIELD_ANY_REG
+        else
+          raise ArgumentError, "Unknown field '#{key}' in instruction pattern '#{query}'"
+        end
+      end
+
+      opcodes ||= []
+      @opcodes_ptr = FFI::MemoryPointer.new(:uint16, [opcodes.length, 1].max).write_array_of_uint16(opcodes)
+      @layout[:opcodes] = @opcodes_ptr
+      @layout[:opcode_count] = opcodes.length
+    end
+
+private
+    def opcode_ids(token)
+      return [] if token == '*'
+      ids = OPCODE_MNEMONIC.each_index.select { OPCODE_MNEMONIC[it] == token }
+      ids << OPCODE.index(token.to_sym) if ids.empty? && OPCODE.include?(token.to_sym)
+      raise ArgumentError, "Unknown opcode '#{token}' in instruction pattern '#{@query}'" if ids.empty?
+      ids
+    end
+
+    def register_id(token)
+      REGISTER_MAP[token.to_sym] || REGISTER_ALIASES[token.to_sym]
+    end
+
+    def register_id!(token)
+      register_id(token) or raise ArgumentError, "Unknown register '#{token}' in instruction pattern '#{@query}'"
+    end
+
+    def parse_value(val, resolve)
+      Integer(val)
+    rescue ArgumentError
+      raise ArgumentError, "Invalid value '#{val}' in instruction pattern '#{@query}'" if resolve.nil?
+      resolve.(val)
+    end
+  end
+
+  # Decoded fields of every instruction in a code region, built in one pass and grouped by opcode so that queries
+  # only look at the instructions of the opcodes they name
+  class InsIndex
+    include UnarmBind
+
+    attr_reader :start_addr, :size
+
+    # With a FunctionMap, functions are indexed in their own mode and literal pools are left out; otherwise the
+    # region is indexed as ARM
+    def initialize(data_ptr, size, addr, function_map: nil, arm7: false)
+      @data_ptr = data_ptr
+      @function_map = function_map
+      @start_addr = addr
+      @size = size
+      @ptr = FFI::AutoPointer.new(ins_index_build(data_ptr, size, addr, arm7, function_map&.ptr),
+                                  method(:free_ins_index))
+    end
+
+    def count = ins_index_count(@ptr)
+    alias_method :length, :count
+
+    # Addresses of the matching instructions (with bit 0 set for Thumb), in order
+    def query(pattern)
+      pattern = InsPattern.new(pattern) if pattern.is_a? String
+      count_ptr = FFI::MemoryPointer.new(:uint32)
+      results = ins_index_query(@ptr, pattern.layout, count_ptr)
+      count = count_ptr.read_uint32
+      return [] if count == 0
+      addrs = results.read_array_of_uint32(count)
+      free_ins_index_results(results, count)
+      addrs
+    end
+  end
+
+  class RegValue < FFI::Struct
+    layout :state, :uint8,
+           :value, :uint32
+  end
+
+  # Register values reaching each instruction of one function, found by propagating constants (immediates,
+  # literal pool loads and arithmetic on them) along its control flow; calls clobber r0-r3, r12 and lr
+  class Dataflow
+    include UnarmBind
+
+    STATES = [:unreached, :const, :unknown].freeze
+
+    attr_reader :function
+
+    def initialize(data_ptr, size, addr, function, arm7: false)
+      @data_ptr = data_ptr
+      @function = function
+      @ptr = FFI::AutoPointer.new(dataflow_analyze(data_ptr, size, addr, function, arm7), method(:free_dataflow))
+    end
+
+    # Values of r0-pc before the instruction at addr, each an Integer when it is the same on every path leading
+    # there, or nil; nil altogether if addr is not an instruction of the function or is never reached
+    def regs_at(addr)
+      values = FFI::MemoryPointer.new(RegValue, 16)
+      return nil unless dataflow_get_regs(@ptr, addr, values)
+      regs = Array.new(16) { RegValue.new(values + it * RegValue.size) }
+      return nil if regs.all? { STATES[it[:state]] == :unreached }
+      regs.map { STATES[it[:state]] == :const ? it[:value] : nil }
+    end
+
+    # Value of one register (an index or a name like 'r0' or 'sp') before the instruction at addr
+    def reg_at(reg, addr)
+      reg = REGISTER_MAP[reg.to_sym] || InsPattern::REGISTER_ALIASES[reg.to_sym] unless reg.is_a? Integer
+      raise ArgumentError, "Invalid register: #{reg}" unless reg.is_a?(Integer) && reg.between?(0, 15)
+      regs_at(addr)&.[](reg)
+    end
+  end
+
   class Parser
     include UnarmBind
 
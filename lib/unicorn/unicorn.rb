@@ -46,6 +46,8 @@ module UnicornBind
   attach_function :uc_mem_map_ptr, [:uc_engine, :addr, :uint64, :uint32, :pointer], :uc_err
   attach_function :uc_mem_unmap, [:uc_engine, :addr, :uint64], :uc_err
   attach_function :uc_mem_protect, [:uc_engine, :addr, :uint64, :uint32], :uc_err
+  attach_function :uc_hook_add, [:uc_engine, :pointer, :int, :pointer, :pointer, :uint64, :uint64, :varargs], :uc_err
+  attach_function :uc_hook_del, [:uc_engine, :size_t], :uc_err
 
   REG_ID = {
     r0:   UC_ARM_REG_R0,
@@ -73,13 +75,19 @@ module Unicorn
   extend UnicornBind
 
   class Region
-    attr_reader :addr, :size, :prot, :end_addr
-    def initialize(addr, size, prot = UC_PROT_ALL)
+    attr_reader :addr, :size, :prot, :end_addr, :ptr
+    # ptr: page-aligned host memory backing the region, which must outlive the emulator (allocated by Unicorn if nil)
+    def initialize(addr, size, prot = UC_PROT_ALL, ptr: nil)
       @addr = addr
       @size = size
       @prot = prot
+      @ptr = ptr
       @end_addr = addr + size
     end
+
+    def overlaps?(other)
+      @addr < other.end_addr && other.addr < @end_addr
+    end
   end
 
   NDS_REGIONS = [
@@ -124,7 +132,32 @@ module Unicorn
     end
 
     def add_region(region)
-      safe_call(:uc_mem_map, @engine, region.addr, region.size, region.prot)
+      if region.ptr.nil?
+        safe_call(:uc_mem_map, @engine, region.addr, region.size, region.prot)
+      else
+        safe_call(:uc_mem_map_ptr, @engine, region.addr, region.size, region.prot, region.ptr)
+      end
+    end
+
+    # Drops translated code in a range, needed after writing to it through host memory rather than write_mem
+    def remove_code_cache(addr, size)
+      cmd = UC_CTL_TB_REMOVE_CACHE | (2 << 26) | (UC_CTL_IO_WRITE << 30) # UC_CTL_WRITE(UC_CTL_TB_REMOVE_CACHE, 2)
+      safe_call(:uc_ctl, @engine, cmd, :uint64, addr, :uint64, addr + size)
+    end
+
+    # Hooks a native callback, over every address unless a range is given; returns the handle to remove it with
+    def add_hook(type, callback, user_data = nil, range: nil)
+      handle = nil
+      FFI::MemoryPointer.new(:size_t, 1) do |ptr|
+        first, last = range.nil? ? [1, 0] : [range.begin, range.end]
+        safe_call(:uc_hook_add, @engine, ptr, type, callback, user_data, first, last)
+        handle = ptr.read(:size_t)
+      end
+      handle
+    end
+
+    def remove_hook(handle)
+      safe_call(:uc_hook_del, @engine, handle)
     end
 
     def add_section(sect)